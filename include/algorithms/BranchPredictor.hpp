@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+
+// Two-bit saturating counter, the textbook dynamic branch predictor: it
+// predicts taken in its upper two states, so one surprise in a long run of
+// the same outcome costs a single misprediction. A real core keeps one per
+// branch and mixes in history; the sorts share one across all their
+// compares, which for the tight loops they spend their time in is close
+// enough to show a data-dependent branch that goes either way at random.
+struct BranchPredictor {
+    uint8_t counter = 1;    // weakly not taken
+
+    // Feeds an outcome through the counter; true if it was mispredicted
+    bool mispredicts(bool taken) {
+        const bool predicted = counter >= 2;
+        if (taken) {
+            counter += counter < 3;
+        } else {
+            counter -= counter > 0;
+        }
+        return predicted != taken;
+    }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+// Stackless resumable functions for the step implementations.
+//
+// An algorithm is written as an ordinary loop between CO_BEGIN and CO_END and
+// returns to its caller at every CO_YIELD. The next call jumps straight back
+// to the statement after that yield, so resuming costs one switch on an int
+// and never allocates. Like any stackless coroutine, locals declared after
+// CO_BEGIN do not survive a yield: keep loop variables in the owning object.
+// Only one CO_YIELD may appear per source line.
+struct Coroutine {
+    int resumePoint = 0;
+
+    void reset() { resumePoint = 0; }
+    bool isDone() const { return resumePoint == -1; }
+};
+
+#define CO_BEGIN(co) switch ((co).resumePoint) { case 0:
+
+#define CO_YIELD(co, ...)              \
+    do {                               \
+        (co).resumePoint = __LINE__;   \
+        return __VA_ARGS__;            \
+        case __LINE__:;                \
+    } while (false)
+
+#define CO_END(co) default: break; } (co).resumePoint = -1
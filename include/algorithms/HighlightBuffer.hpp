@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include "algorithms/SortTypes.hpp"
+
+// What a highlighted element is doing in the current step
+enum class HighlightRole : uint8_t {
+    NONE,
+    PIVOT,
+    COMPARE,
+    WRITE,
+    BOUNDARY
+};
+
+// The few elements a step touches, stored inline so that updating them on
+// every step never allocates. When an index appears more than once, the
+// earlier entry takes precedence.
+class HighlightBuffer {
+public:
+    struct Entry {
+        SortIndex index;
+        HighlightRole role;
+    };
+
+    static constexpr size_t kCapacity = 8;
+
+    void clear() { m_size = 0; }
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+
+    void add(SortIndex index, HighlightRole role) {
+        assert(m_size < kCapacity);
+        m_entries[m_size++] = Entry{index, role};
+    }
+
+    void assign(std::initializer_list<Entry> entries) {
+        assert(entries.size() <= kCapacity);
+        m_size = 0;
+        for (const Entry& entry : entries) {
+            m_entries[m_size++] = entry;
+        }
+    }
+
+    const Entry& operator[](size_t i) const { return m_entries[i]; }
+    const Entry* begin() const { return m_entries.data(); }
+    const Entry* end() const { return m_entries.data() + m_size; }
+
+private:
+    std::array<Entry, kCapacity> m_entries;
+    size_t m_size = 0;
+};
@@ -0,0 +1,280 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "algorithms/BranchPredictor.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "trace/OperationTrace.hpp"
+
+// Instrumentation policies for the sorting kernels.
+//
+// Kernels only touch their array through an ArrayView, which reports every
+// compare, swap, read and write to its policy. The policy is a template
+// parameter, so with NoInstrument every hook is an empty inline call and the
+// kernel compiles down to the hand-written loop, while the same source run
+// with CountOps or RecordTrace gets exact accounting. The aux hooks are for
+// kernels that move elements through a separate buffer. onBranch follows
+// every compare whose result the kernel branches on, which is all of them
+// but the ones a branch-free partition turns into arithmetic. onScan marks a
+// partitioning scan moving on to its next element, which counts the passes
+// over memory that compares and swaps do not show.
+
+struct NoInstrument {
+    void onCompare(SortIndex, SortIndex, bool) {}
+    void onBranch(bool) {}
+    void onSwap(SortIndex, SortIndex) {}
+    void onRead(SortIndex) {}
+    template <typename Key>
+    void onWrite(SortIndex, const Key&) {}
+    void onAuxRead(SortIndex) {}
+    template <typename Key>
+    void onAuxWrite(SortIndex, const Key&) {}
+    void onScan(SortIndex) {}
+};
+
+struct CountOps {
+    OpCount comparisons = 0;
+    OpCount swaps = 0;
+    OpCount reads = 0;
+    OpCount writes = 0;
+    OpCount auxReads = 0;
+    OpCount auxWrites = 0;
+    OpCount scans = 0;
+
+    void onCompare(SortIndex, SortIndex, bool) { comparisons++; }
+    void onBranch(bool) {}
+    void onSwap(SortIndex, SortIndex) { swaps++; }
+    void onRead(SortIndex) { reads++; }
+    template <typename Key>
+    void onWrite(SortIndex, const Key&) { writes++; }
+    void onAuxRead(SortIndex) { auxReads++; }
+    template <typename Key>
+    void onAuxWrite(SortIndex, const Key&) { auxWrites++; }
+    void onScan(SortIndex) { scans++; }
+};
+
+// Counts and appends every operation to a trace sink for later playback:
+// an in-memory OperationTrace, or a TraceFileWriter for runs too large for
+// RAM. Values are logged as integers, so this is for integer keys.
+template <typename Sink>
+struct RecordTraceTo : CountOps {
+    Sink trace;
+
+    RecordTraceTo() = default;
+    explicit RecordTraceTo(Sink sink) : trace(std::move(sink)) {}
+
+    void onCompare(SortIndex i, SortIndex j, bool result) {
+        CountOps::onCompare(i, j, result);
+        trace.append(trace::Operation{trace::OpCode::COMPARE, result, i, j});
+    }
+    void onSwap(SortIndex i, SortIndex j) {
+        CountOps::onSwap(i, j);
+        trace.append(trace::Operation{trace::OpCode::SWAP, false, i, j});
+    }
+    void onRead(SortIndex i) {
+        CountOps::onRead(i);
+        trace.append(trace::Operation{trace::OpCode::READ, false, i, 0});
+    }
+    template <typename Key>
+    void onWrite(SortIndex i, const Key& value) {
+        CountOps::onWrite(i, value);
+        trace.append(trace::Operation{trace::OpCode::WRITE, false, i, static_cast<int64_t>(value)});
+    }
+    void onAuxRead(SortIndex i) {
+        CountOps::onAuxRead(i);
+        trace.append(trace::Operation{trace::OpCode::AUX_READ, false, i, 0});
+    }
+    template <typename Key>
+    void onAuxWrite(SortIndex i, const Key& value) {
+        CountOps::onAuxWrite(i, value);
+        trace.append(trace::Operation{trace::OpCode::AUX_WRITE, false, i, static_cast<int64_t>(value)});
+    }
+};
+
+using RecordTrace = RecordTraceTo<trace::OperationTrace>;
+
+// Counts and runs every branch on a compare through a two-bit predictor, for
+// the cost of unpredictable branches that comparison counts do not show
+struct SimulateBranches : CountOps {
+    BranchPredictor predictor;
+    OpCount mispredictions = 0;
+
+    void onBranch(bool taken) { mispredictions += predictor.mispredicts(taken); }
+};
+
+// Counts and runs every element access through a set-associative LRU cache
+// model, for access-pattern effects that comparison counts do not show.
+// elementBytes should be sizeof the sorted key.
+class SimulateCache : public CountOps {
+public:
+    explicit SimulateCache(size_t elementBytes = sizeof(int), size_t cacheBytes = 32 * 1024,
+                           size_t lineBytes = 64, size_t ways = 8)
+        : m_elementBytes(elementBytes)
+        , m_lineBytes(lineBytes)
+        , m_ways(ways)
+        , m_sets(cacheBytes >= lineBytes * ways ? cacheBytes / (lineBytes * ways) : 1)
+        , m_lines(m_sets * m_ways, 0)
+    {}
+
+    OpCount hits = 0;
+    OpCount misses = 0;
+
+    void onCompare(SortIndex i, SortIndex j, bool result) {
+        CountOps::onCompare(i, j, result);
+        if (i >= 0) access(i);
+        if (j >= 0) access(j);
+    }
+    void onSwap(SortIndex i, SortIndex j) {
+        CountOps::onSwap(i, j);
+        access(i);
+        access(j);
+    }
+    void onRead(SortIndex i) {
+        CountOps::onRead(i);
+        access(i);
+    }
+    template <typename Key>
+    void onWrite(SortIndex i, const Key& value) {
+        CountOps::onWrite(i, value);
+        access(i);
+    }
+
+    // Aux buffer accesses are counted but not run through the cache model
+    void onAuxRead(SortIndex i) { CountOps::onAuxRead(i); }
+    template <typename Key>
+    void onAuxWrite(SortIndex i, const Key& value) { CountOps::onAuxWrite(i, value); }
+
+private:
+    // Each set keeps its lines most recently used first; 0 marks an empty way
+    void access(SortIndex index) {
+        const uint64_t line = static_cast<uint64_t>(index) * m_elementBytes / m_lineBytes + 1;
+        uint64_t* set = &m_lines[(line % m_sets) * m_ways];
+        size_t way = 0;
+        while (way < m_ways && set[way] != line) ++way;
+        if (way < m_ways) {
+            hits++;
+        } else {
+            misses++;
+            way = m_ways - 1;
+        }
+        for (; way > 0; --way) set[way] = set[way - 1];
+        set[0] = line;
+    }
+
+    size_t m_elementBytes;
+    size_t m_lineBytes;
+    size_t m_ways;
+    size_t m_sets;
+    std::vector<uint64_t> m_lines;
+};
+
+// The kernels' only way into an array: element access and comparisons that
+// report to the policy before they happen. Kernels that merge through an aux
+// buffer get one of the same size alongside the array.
+template <typename Key, typename Compare, typename Policy>
+class ArrayView {
+public:
+    using KeyType = Key;
+    using PolicyType = Policy;
+
+    ArrayView(Key* data, SortIndex size, const Compare& compare, Policy& policy, Key* aux = nullptr)
+        : m_data(data), m_aux(aux), m_size(size), m_compare(compare), m_policy(policy) {}
+
+    SortIndex size() const { return m_size; }
+    Policy& policy() { return m_policy; }
+
+    bool less(SortIndex i, SortIndex j) {
+        const bool result = m_compare(m_data[i], m_data[j]);
+        m_policy.onCompare(i, j, result);
+        m_policy.onBranch(result);
+        return result;
+    }
+
+    // A compare whose result only feeds arithmetic, never a branch
+    SORT_ALWAYS_INLINE bool lessBranchFree(SortIndex i, SortIndex j) {
+        const bool result = m_compare(m_data[i], m_data[j]);
+        m_policy.onCompare(i, j, result);
+        return result;
+    }
+
+    void swap(SortIndex i, SortIndex j) {
+        m_policy.onSwap(i, j);
+        using std::swap;
+        swap(m_data[i], m_data[j]);
+    }
+
+    // A swap that happens only if condition holds, done by selecting rather
+    // than branching; it is reported as a swap only then. Integer keys
+    // select through a mask, since compilers turn a select back into a
+    // branch once they run short of registers.
+    SORT_ALWAYS_INLINE void swapIf(bool condition, SortIndex i, SortIndex j) {
+        if (condition) m_policy.onSwap(i, j);
+        const Key first = m_data[i];
+        const Key second = m_data[j];
+        if constexpr (std::is_integral_v<Key>) {
+            const Key difference = (first ^ second) & static_cast<Key>(-static_cast<Key>(condition));
+            m_data[i] = first ^ difference;
+            m_data[j] = second ^ difference;
+        } else {
+            m_data[i] = condition ? second : first;
+            m_data[j] = condition ? first : second;
+        }
+    }
+
+    // A scanning index arriving at i
+    void scan(SortIndex i) { m_policy.onScan(i); }
+
+    const Key& read(SortIndex i) {
+        m_policy.onRead(i);
+        return m_data[i];
+    }
+
+    void write(SortIndex i, const Key& value) {
+        m_policy.onWrite(i, value);
+        m_data[i] = value;
+    }
+
+    // Aux elements are not in the array, so their compares report the
+    // positions of temporaries
+    bool auxLess(SortIndex i, SortIndex j) {
+        const bool result = m_compare(m_aux[i], m_aux[j]);
+        m_policy.onCompare(-1, -1, result);
+        m_policy.onBranch(result);
+        return result;
+    }
+
+    // Compares of an aux element with an array element, for merges that
+    // move only one run out of the way
+    bool auxLessArray(SortIndex i, SortIndex j) {
+        const bool result = m_compare(m_aux[i], m_data[j]);
+        m_policy.onCompare(-1, j, result);
+        m_policy.onBranch(result);
+        return result;
+    }
+
+    bool arrayLessAux(SortIndex i, SortIndex j) {
+        const bool result = m_compare(m_data[i], m_aux[j]);
+        m_policy.onCompare(i, -1, result);
+        m_policy.onBranch(result);
+        return result;
+    }
+
+    const Key& auxRead(SortIndex i) {
+        m_policy.onAuxRead(i);
+        return m_aux[i];
+    }
+
+    void auxWrite(SortIndex i, const Key& value) {
+        m_policy.onAuxWrite(i, value);
+        m_aux[i] = value;
+    }
+
+private:
+    Key* m_data;
+    Key* m_aux;
+    SortIndex m_size;
+    Compare m_compare;
+    Policy& m_policy;
+};
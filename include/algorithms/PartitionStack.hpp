@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include "algorithms/SortTypes.hpp"
+
+// Pending [left, right] ranges of an iterative quicksort.
+//
+// pushChildren() pushes the larger half first so the smaller one is partitioned
+// next. Every range below the top is then at least twice the size of the one
+// above it, so no more than log2(n) + 1 ranges are ever pending and a fixed
+// inline array covers any array size without allocating.
+class PartitionStack {
+public:
+    struct Range {
+        SortIndex left;
+        SortIndex right;
+        int budget = 0;     // bad partitions or levels left before the range is heap sorted
+    };
+
+    static constexpr size_t kCapacity = 64;
+
+    void clear() { m_size = 0; }
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+
+    void push(SortIndex left, SortIndex right, int budget = 0) {
+        assert(m_size < kCapacity);
+        m_ranges[m_size++] = Range{left, right, budget};
+    }
+
+    Range pop() {
+        assert(m_size > 0);
+        return m_ranges[--m_size];
+    }
+
+    // Pushes the two sides of a range partitioned at pivot, skipping sides
+    // with fewer than two elements. Both keep the range's budget.
+    void pushChildren(const Range& range, SortIndex pivot) {
+        const Range lower{range.left, pivot - 1, range.budget};
+        const Range upper{pivot + 1, range.right, range.budget};
+        const bool lowerIsSmaller = lower.right - lower.left < upper.right - upper.left;
+        const Range& larger = lowerIsSmaller ? upper : lower;
+        const Range& smaller = lowerIsSmaller ? lower : upper;
+        if (larger.right > larger.left) push(larger.left, larger.right, larger.budget);
+        if (smaller.right > smaller.left) push(smaller.left, smaller.right, smaller.budget);
+    }
+
+    // Pushes the three sides of a range partitioned at two pivots, largest
+    // first. Going into the smallest side pushes two ranges for a third of
+    // the size at most, so about 1.3 log2(n) ranges are ever pending.
+    void pushChildren(const Range& range, SortIndex lowPivot, SortIndex highPivot) {
+        Range sides[3] = {
+            {range.left, lowPivot - 1, range.budget},
+            {lowPivot + 1, highPivot - 1, range.budget},
+            {highPivot + 1, range.right, range.budget}
+        };
+        const auto larger = [](const Range& x, const Range& y) { return x.right - x.left > y.right - y.left; };
+        if (larger(sides[1], sides[0])) std::swap(sides[0], sides[1]);
+        if (larger(sides[2], sides[1])) std::swap(sides[1], sides[2]);
+        if (larger(sides[1], sides[0])) std::swap(sides[0], sides[1]);
+        for (const Range& side : sides) {
+            if (side.right > side.left) push(side.left, side.right, side.budget);
+        }
+    }
+
+private:
+    std::array<Range, kCapacity> m_ranges;
+    size_t m_size = 0;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include "algorithms/SortTypes.hpp"
+
+// Lane helpers shared by the instruction set source files, which include
+// this after switching their target on. They are in an unnamed namespace so
+// that each file keeps its own copy, compiled for its own target, rather
+// than the linker picking one of them for both.
+
+namespace {
+
+inline SortIndex popCount(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return static_cast<SortIndex>(__popcnt(mask));
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+// Blend immediate taking lanes with bit set from the second operand, for
+// lanes of width mask bits each
+constexpr int laneMask(int lanes, int bit, int width) {
+    int mask = 0;
+    for (int k = 0; k < lanes; ++k) {
+        if (k & bit) mask |= ((1 << width) - 1) << (k * width);
+    }
+    return mask;
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "algorithms/SortTypes.hpp"
+
+// The bitonic network of kernels::SortingNetwork::bitonicSort on keys held
+// in Regs vector registers, a whole layer per min and max. Besides the
+// traits SimdPartition.hpp describes it needs:
+//
+//   Vec min(Vec, Vec), Vec max(Vec, Vec)
+//   template <int X> Vec permuteXor(Vec)          lane k takes lane k ^ X
+//   template <int Bit> Vec blendHigh(Vec, Vec)     lane k from the second if k & Bit
+//
+// It is compiled per instruction set the same way as SimdPartition.hpp.
+
+namespace simd {
+
+// A layer whose comparators stay within a register: lane k meets lane
+// k ^ X, and of the two the lane with Bit set takes the larger key
+template <typename Traits, int Regs, int X, int Bit>
+void layerInRegisters(typename Traits::Vec* v) {
+    for (int r = 0; r < Regs; ++r) {
+        const typename Traits::Vec partner = Traits::template permuteXor<X>(v[r]);
+        v[r] = Traits::template blendHigh<Bit>(Traits::min(v[r], partner), Traits::max(v[r], partner));
+    }
+}
+
+// The layers of a merge after its first, comparing keys Distance apart
+template <typename Traits, int Regs, int Distance>
+void bitonicCleanRegisters(typename Traits::Vec* v) {
+    constexpr int lanes = static_cast<int>(Traits::kLanes);
+    if constexpr (Distance >= lanes) {
+        // Whole registers meet whole registers
+        for (int r = 0; r < Regs; ++r) {
+            if (r & (Distance / lanes)) continue;
+            const typename Traits::Vec low = Traits::min(v[r], v[r + Distance / lanes]);
+            v[r + Distance / lanes] = Traits::max(v[r], v[r + Distance / lanes]);
+            v[r] = low;
+        }
+    } else if constexpr (Distance >= 1) {
+        layerInRegisters<Traits, Regs, Distance, Distance>(v);
+    }
+    if constexpr (Distance > 1) bitonicCleanRegisters<Traits, Regs, Distance / 2>(v);
+}
+
+// Merges each pair of sorted runs of Span / 2 keys, starting with the layer
+// that compares mirror images
+template <typename Traits, int Regs, int Span>
+void bitonicMergeRegisters(typename Traits::Vec* v) {
+    constexpr int lanes = static_cast<int>(Traits::kLanes);
+    if constexpr (Span <= lanes) {
+        layerInRegisters<Traits, Regs, Span - 1, Span / 2>(v);
+    } else {
+        // The mirror image of a lane is in another register, lanes reversed
+        constexpr int block = Span / lanes;
+        for (int r = 0; r < Regs; ++r) {
+            if (r & (block / 2)) continue;
+            const int mirror = r ^ (block - 1);
+            const typename Traits::Vec reversed = Traits::template permuteXor<lanes - 1>(v[mirror]);
+            v[mirror] = Traits::template permuteXor<lanes - 1>(Traits::max(v[r], reversed));
+            v[r] = Traits::min(v[r], reversed);
+        }
+    }
+    bitonicCleanRegisters<Traits, Regs, Span / 4>(v);
+}
+
+template <typename Traits, int Regs, int Span = 2>
+void bitonicSortRegisters(typename Traits::Vec* v) {
+    bitonicMergeRegisters<Traits, Regs, Span>(v);
+    if constexpr (Span * 2 <= Regs * static_cast<int>(Traits::kLanes)) {
+        bitonicSortRegisters<Traits, Regs, Span * 2>(v);
+    }
+}
+
+template <typename Traits, int Regs>
+void sortInRegisters(typename Traits::Key* keys) {
+    typename Traits::Vec v[Regs];
+    for (int r = 0; r < Regs; ++r) v[r] = Traits::load(keys + r * Traits::kLanes);
+    bitonicSortRegisters<Traits, Regs>(v);
+    for (int r = 0; r < Regs; ++r) Traits::store(keys + r * Traits::kLanes, v[r]);
+}
+
+// Sorts up to MaxSize keys in as few registers as hold them, padded with
+// the largest key so the padding stays at the end
+template <typename Traits, SortIndex MaxSize>
+void sortSmallWith(typename Traits::Key* data, SortIndex n) {
+    using Key = typename Traits::Key;
+    constexpr SortIndex lanes = Traits::kLanes;
+    static_assert(MaxSize % lanes == 0 && MaxSize / lanes <= 8, "networks span 1 to 8 registers");
+
+    Key keys[MaxSize];
+    for (SortIndex k = 0; k < MaxSize; ++k) keys[k] = k < n ? data[k] : std::numeric_limits<Key>::max();
+    if (n <= lanes) {
+        sortInRegisters<Traits, 1>(keys);
+    } else if (n <= 2 * lanes) {
+        sortInRegisters<Traits, 2>(keys);
+    } else if constexpr (MaxSize >= 4 * lanes) {
+        if (n <= 4 * lanes) {
+            sortInRegisters<Traits, 4>(keys);
+        } else if constexpr (MaxSize >= 8 * lanes) {
+            sortInRegisters<Traits, 8>(keys);
+        }
+    }
+    for (SortIndex k = 0; k < n; ++k) data[k] = keys[k];
+}
+
+// Merges the sorted vectors at keys and keys + kLanes into one sorted run
+template <typename Traits>
+void mergeVectorsWith(typename Traits::Key* keys) {
+    typename Traits::Vec v[2] = {Traits::load(keys), Traits::load(keys + Traits::kLanes)};
+    bitonicMergeRegisters<Traits, 2, 2 * static_cast<int>(Traits::kLanes)>(v);
+    Traits::store(keys, v[0]);
+    Traits::store(keys + Traits::kLanes, v[1]);
+}
+
+}
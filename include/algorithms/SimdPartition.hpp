@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "algorithms/SortTypes.hpp"
+
+// The vector partition behind simd::partition, written once over a Traits
+// class per instruction set and key type:
+//
+//   Key, Vec, kLanes
+//   Vec load(const Key*), void store(Key*, Vec), Vec broadcast(Key)
+//   uint32_t lessMask(Vec keys, Vec pivots)   bit k set if lane k < pivot
+//   SortIndex count(uint32_t mask)
+//   Vec split(Vec keys, uint32_t mask)        masked lanes first, both in order
+//
+// Each instruction set's source file includes this after switching its
+// target on, with Traits local to that file, so every instantiation is
+// compiled for its own instruction set and none is shared between them.
+// The steps are those of kernels::vectorPartition, which describes them.
+
+namespace simd {
+
+// Stores a split vector whole at both write ends. Only the smaller keys at
+// the left and the others at the right are kept; the lanes past them land in
+// room that is written again before the partition ends.
+template <typename Traits>
+void storeSplit(typename Traits::Key* data, SortIndex& writeLeft, SortIndex& writeRight,
+                typename Traits::Vec keys, typename Traits::Vec pivots) {
+    const uint32_t mask = Traits::lessMask(keys, pivots);
+    const SortIndex smaller = Traits::count(mask);
+    const typename Traits::Vec split = Traits::split(keys, mask);
+    Traits::store(data + writeLeft, split);
+    Traits::store(data + writeRight - Traits::kLanes, split);
+    writeLeft += smaller;
+    writeRight -= Traits::kLanes - smaller;
+}
+
+template <typename Traits>
+SortIndex partitionWith(typename Traits::Key* data, SortIndex begin, SortIndex end, typename Traits::Key pivot) {
+    using Key = typename Traits::Key;
+    using Vec = typename Traits::Vec;
+    constexpr SortIndex lanes = Traits::kLanes;
+
+    const Vec pivots = Traits::broadcast(pivot);
+    SortIndex readLeft = begin;
+    SortIndex readRight = end;
+    SortIndex writeLeft = begin;
+    SortIndex writeRight = end;
+
+    const bool hasEnds = end - begin >= 2 * lanes;
+    Vec first = pivots;
+    Vec last = pivots;
+    if (hasEnds) {
+        first = Traits::load(data + begin);
+        last = Traits::load(data + end - lanes);
+        readLeft += lanes;
+        readRight -= lanes;
+        while (readRight - readLeft >= lanes) {
+            Vec keys;
+            if (readLeft - writeLeft <= writeRight - readRight) {
+                keys = Traits::load(data + readLeft);
+                readLeft += lanes;
+            } else {
+                readRight -= lanes;
+                keys = Traits::load(data + readRight);
+            }
+            storeSplit<Traits>(data, writeLeft, writeRight, keys, pivots);
+        }
+    }
+
+    // The rest is copied out first, since placing it overwrites the gap it
+    // is in, then written to both ends with only one end advancing
+    Key rest[2 * lanes];
+    const SortIndex restSize = readRight - readLeft;
+    for (SortIndex k = 0; k < restSize; ++k) {
+        rest[k] = data[readLeft + k];
+    }
+    for (SortIndex k = 0; k < restSize; ++k) {
+        const bool smaller = rest[k] < pivot;
+        data[writeLeft] = rest[k];
+        data[writeRight - 1] = rest[k];
+        writeLeft += smaller;
+        writeRight -= !smaller;
+    }
+
+    if (hasEnds) {
+        storeSplit<Traits>(data, writeLeft, writeRight, first, pivots);
+        storeSplit<Traits>(data, writeLeft, writeRight, last, pivots);
+    }
+    return writeLeft;
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/kernels/SortingNetwork.hpp"
+
+// Vectorized quicksort for 32- and 64-bit integer keys, in the manner of
+// x86-simd-sort and vqsort: the partition compares a whole vector of keys
+// with the pivot per instruction and stores it split in two, rearranged by
+// compress instructions (AVX-512) or a permute from a lookup table (AVX2). The instruction
+// set is picked at run time, so one binary runs everywhere and uses the
+// widest vectors the CPU has; without AVX2 it falls back to the branch-free
+// BlockQuicksort.
+//
+// Ranges of up to 32 keys are sorted in registers by a bitonic network, a
+// min and a max per layer, as in kernels::networkSort.
+//
+// Pivots, small ranges and the depth limit are kernels::vectorQuickSort's,
+// and every instruction set leaves the keys exactly where the scalar model
+// in kernels/VectorQuickSort.hpp does for the same number of lanes.
+
+// x86 builds compile the vector code with per-function target options
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_SORT_X86 1
+#else
+#define SIMD_SORT_X86 0
+#endif
+
+namespace simd {
+
+enum class Isa {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+// Widest instruction set both the build and the CPU support; looked up once
+Isa detectIsa();
+const char* getIsaName(Isa isa);
+
+// Keys per vector; the scalar partition models AVX2's
+template <typename Key>
+SortIndex vectorLanes(Isa isa) {
+    return (isa == Isa::AVX512 ? 64 : 32) / static_cast<SortIndex>(sizeof(Key));
+}
+
+// Partitions [begin, end) around the key at pivot, outside the range, the
+// way kernels::vectorPartition does, and returns where the keys not smaller
+// than it start. isa must be supported.
+SortIndex partition(int32_t* data, SortIndex begin, SortIndex end, SortIndex pivot, Isa isa);
+SortIndex partition(int64_t* data, SortIndex begin, SortIndex end, SortIndex pivot, Isa isa);
+
+// Most keys sortSmall takes
+constexpr SortIndex kSortSmallMax = kernels::kNetworkMaxSize;
+
+// Sorts up to kSortSmallMax keys in vector registers with a bitonic
+// network; without vectors, with the smallest known network unrolled
+void sortSmall(int32_t* data, size_t size, Isa isa);
+void sortSmall(int64_t* data, size_t size, Isa isa);
+
+// Merges two sorted vectors of vectorLanes(isa) keys, back to back at keys,
+// in registers with a bitonic merge
+void mergeVectors(int32_t* keys, Isa isa);
+void mergeVectors(int64_t* keys, Isa isa);
+
+// Quicksort on the vector partition and sortSmall; without vectors it is
+// BlockQuicksort
+void quickSort(int32_t* data, size_t size, Isa isa);
+void quickSort(int64_t* data, size_t size, Isa isa);
+
+inline void quickSort(int32_t* data, size_t size) { quickSort(data, size, detectIsa()); }
+inline void quickSort(int64_t* data, size_t size) { quickSort(data, size, detectIsa()); }
+
+}
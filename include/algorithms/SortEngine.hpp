@@ -0,0 +1,231 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "algorithms/Instrumentation.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/StdSortAdapter.hpp"
+#include "algorithms/kernels/AmericanFlagSort.hpp"
+#include "algorithms/kernels/BlockQuickSort.hpp"
+#include "algorithms/kernels/BubbleSort.hpp"
+#include "algorithms/kernels/DualPivotQuickSort.hpp"
+#include "algorithms/kernels/HeapSort.hpp"
+#include "algorithms/kernels/MergeSort.hpp"
+#include "algorithms/kernels/PdqSort.hpp"
+#include "algorithms/kernels/PowerSort.hpp"
+#include "algorithms/kernels/QuickSort.hpp"
+#include "algorithms/kernels/RadixSort.hpp"
+#include "algorithms/kernels/SortingNetwork.hpp"
+#include "algorithms/kernels/VectorQuickSort.hpp"
+
+// Fixed-width record ordered by its key alone, for sorting keys that carry a
+// payload
+template <typename Key, typename Payload>
+struct KeyValue {
+    Key key;
+    Payload value;
+
+    friend bool operator<(const KeyValue& a, const KeyValue& b) { return a.key < b.key; }
+    friend bool operator==(const KeyValue& a, const KeyValue& b) {
+        return a.key == b.key && a.value == b.value;
+    }
+};
+
+using KeyValue32 = KeyValue<uint32_t, uint32_t>;
+using KeyValue64 = KeyValue<uint64_t, uint64_t>;
+
+// Records go into the buckets of their key
+namespace kernels {
+template <typename Key, typename Payload>
+struct RadixKey<KeyValue<Key, Payload>> {
+    static uint64_t of(const KeyValue<Key, Payload>& record) { return RadixKey<Key>::of(record.key); }
+};
+}
+
+// Native sorting kernels for any element type, comparator and
+// instrumentation policy. Everything is resolved at compile time, so each
+// instantiation compiles to a plain loop over Key with the comparator and the
+// policy hooks inlined. With CountOps the counts match the step functions of
+// SortingAlgorithm for the same input.
+template <typename Key, typename Compare = std::less<Key>, typename Policy = CountOps>
+class SortEngine {
+public:
+    using View = ArrayView<Key, Compare, Policy>;
+
+    explicit SortEngine(Compare compare = Compare(), Policy policy = Policy())
+        : m_compare(compare), m_policy(std::move(policy)) {}
+
+    void bubbleSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::bubbleSort(view);
+    }
+
+    void quickSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::quickSort(view);
+    }
+
+    void dualPivotQuickSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::dualPivotQuickSort(view);
+    }
+
+    void pdqSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::pdqSort(view);
+    }
+
+    void blockQuickSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::blockQuickSort(view);
+    }
+
+    // The SIMD quicksort's partition modelled for vectors of lanes keys; the
+    // vectorized one is simd::quickSort
+    void vectorQuickSort(Key* data, size_t size, SortIndex lanes) {
+        View view = makeView(data, size);
+        kernels::vectorQuickSort(view, lanes);
+    }
+
+    void heapSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::heapSort(view);
+    }
+
+    void bottomUpHeapSort(Key* data, size_t size) {
+        View view = makeView(data, size);
+        kernels::bottomUpHeapSort(view);
+    }
+
+    // Merges through an aux buffer the size of the input, allocated once
+    // per sort
+    void mergeSort(Key* data, size_t size) {
+        std::vector<Key> aux(size);
+        View view(data, static_cast<SortIndex>(size), m_compare, m_policy, aux.data());
+        kernels::mergeSort(view);
+    }
+
+    // Merge sort on runs sorted by the smallest known networks of up to leaf
+    // keys, so up to leaf keys are one network; not stable
+    void networkMergeSort(Key* data, size_t size, SortIndex leaf = kernels::kNetworkMaxSize) {
+        std::vector<Key> aux(size);
+        View view(data, static_cast<SortIndex>(size), m_compare, m_policy, aux.data());
+        kernels::networkMergeSort(view, leaf);
+    }
+
+    // Stable and adaptive: sorted, reversed or appended-to input takes about
+    // n compares. Merges only ever copy the shorter run aside, so the aux
+    // buffer is half the input.
+    void powerSort(Key* data, size_t size) {
+        std::vector<Key> aux(size / 2);
+        View view(data, static_cast<SortIndex>(size), m_compare, m_policy, aux.data());
+        kernels::powerSort(view);
+    }
+
+    // The counting sorts order keys ascending by their bits and ignore
+    // Compare. Counting sort is for keys spanning a range not much wider
+    // than the input, like a permutation; wider ranges get 16-bit radix
+    // passes instead.
+    void countingSort(Key* data, size_t size, kernels::RadixWorkspace& workspace) {
+        uint64_t minKey;
+        uint64_t maxKey;
+        kernels::radixKeyRange(data, size, minKey, maxKey);
+        if (!kernels::countingRangeFits(minKey, maxKey, size)) {
+            radixSort(data, size, 16, workspace);
+            return;
+        }
+
+        std::vector<Key> aux(size);
+        View view(data, static_cast<SortIndex>(size), m_compare, m_policy, aux.data());
+        kernels::countingSort(view, minKey, maxKey, workspace);
+    }
+
+    void radixSort(Key* data, size_t size, unsigned digitBits, kernels::RadixWorkspace& workspace) {
+        std::vector<Key> aux(size);
+        View view(data, static_cast<SortIndex>(size), m_compare, m_policy, aux.data());
+        kernels::radixSort(view, digitBits, workspace);
+    }
+
+    // Needs no aux buffer, for inputs that take up most of memory
+    void americanFlagSort(Key* data, size_t size, kernels::RadixWorkspace& workspace) {
+        View view = makeView(data, size);
+        kernels::americanFlagSort(view, workspace);
+    }
+
+    void countingSort(Key* data, size_t size) {
+        kernels::RadixWorkspace workspace;
+        countingSort(data, size, workspace);
+    }
+
+    void radixSort(Key* data, size_t size, unsigned digitBits = 8) {
+        kernels::RadixWorkspace workspace;
+        radixSort(data, size, digitBits, workspace);
+    }
+
+    void americanFlagSort(Key* data, size_t size) {
+        kernels::RadixWorkspace workspace;
+        americanFlagSort(data, size, workspace);
+    }
+
+    // The toolchain's standard algorithms, run through counting proxies so
+    // the policy sees their compares and element moves
+    void stdSort(Key* data, size_t size) {
+        std::sort(begin(data), end(data, size), countingCompare());
+    }
+
+    void stdStableSort(Key* data, size_t size) {
+        std::stable_sort(begin(data), end(data, size), countingCompare());
+    }
+
+    void stdPartialSort(Key* data, size_t size, size_t middle) {
+        std::partial_sort(begin(data), begin(data) + middle, end(data, size), countingCompare());
+    }
+
+    void stdNthElement(Key* data, size_t size, size_t nth) {
+        std::nth_element(begin(data), begin(data) + nth, end(data, size), countingCompare());
+    }
+
+    void stdHeapSort(Key* data, size_t size) {
+        std::make_heap(begin(data), end(data, size), countingCompare());
+        std::sort_heap(begin(data), end(data, size), countingCompare());
+    }
+
+    Policy& getPolicy() { return m_policy; }
+    const Policy& getPolicy() const { return m_policy; }
+
+private:
+    using Iterator = stdsort::CountingIterator<Key, Policy>;
+
+    View makeView(Key* data, size_t size) {
+        return View(data, static_cast<SortIndex>(size), m_compare, m_policy);
+    }
+
+    Iterator begin(Key* data) { return Iterator(data, 0, &m_policy); }
+    Iterator end(Key* data, size_t size) { return Iterator(data, static_cast<SortIndex>(size), &m_policy); }
+    stdsort::CountingCompare<Compare, Policy> countingCompare() {
+        return stdsort::CountingCompare<Compare, Policy>(m_compare, &m_policy);
+    }
+
+    Compare m_compare;
+    Policy m_policy;
+};
+
+// The key types the tool is built for are compiled once in SortEngine.cpp,
+// counted and uninstrumented
+#define SORT_ENGINE_KEY_TYPES(X)          \
+    X(int32_t)                            \
+    X(int64_t)                            \
+    X(uint64_t)                           \
+    X(float)                              \
+    X(double)                             \
+    X(KeyValue32)                         \
+    X(KeyValue64)
+
+#define SORT_ENGINE_EXTERN(Key)                                          \
+    extern template class SortEngine<Key, std::less<Key>, CountOps>;     \
+    extern template class SortEngine<Key, std::less<Key>, NoInstrument>;
+SORT_ENGINE_KEY_TYPES(SORT_ENGINE_EXTERN)
+#undef SORT_ENGINE_EXTERN
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+// Element positions and operation counts are 64-bit so that arrays past 2^31
+// elements and runs past 2^32 operations keep correct metrics
+using SortIndex = std::int64_t;
+using OpCount = std::uint64_t;
+
+// For the few helpers unrolled code calls hundreds of times, which the
+// compiler would otherwise stop inlining once the caller grows large
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SORT_ALWAYS_INLINE __forceinline
+#else
+#define SORT_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
@@ -2,6 +2,23 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <cstdint>
+#include "algorithms/BranchPredictor.hpp"
+#include "algorithms/Coroutine.hpp"
+#include "algorithms/HighlightBuffer.hpp"
+#include "algorithms/PartitionStack.hpp"
+#include "algorithms/SimdSort.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/UndoLog.hpp"
+#include "algorithms/kernels/BlockQuickSort.hpp"
+#include "algorithms/kernels/DualPivotQuickSort.hpp"
+#include "algorithms/kernels/PowerSort.hpp"
+#include "algorithms/kernels/RadixSort.hpp"
+#include "algorithms/kernels/SortingNetwork.hpp"
+#include "algorithms/kernels/VectorQuickSort.hpp"
+#include "trace/Keyframes.hpp"
+#include "trace/OperationTrace.hpp"
+#include "trace/TraceFile.hpp"
 
 class SortingAlgorithm {
 public:
@@ -9,55 +26,294 @@ public:
         QUICK_SORT,
         MERGE_SORT,
         BUBBLE_SORT,
-        HEAP_SORT
+        HEAP_SORT,
+        STD_SORT,
+        STD_STABLE_SORT,
+        STD_PARTIAL_SORT,
+        STD_NTH_ELEMENT,
+        STD_HEAP_SORT,
+        BOTTOM_UP_HEAP_SORT,    // after the std:: types, so tags in existing trace files keep their meaning
+        COUNTING_SORT,
+        RADIX_SORT,
+        AMERICAN_FLAG_SORT,
+        PDQ_SORT,
+        BLOCK_QUICK_SORT,
+        VECTOR_QUICK_SORT,      // SIMD partition, modelled with this CPU's vector width
+        NETWORK_SORT,           // smallest known sorting networks; merged 32-key blocks past that
+        POWER_SORT,
+        DUAL_PIVOT_QUICK_SORT
     };
 
+    static constexpr int kAlgorithmCount = static_cast<int>(AlgorithmType::DUAL_PIVOT_QUICK_SORT) + 1;
+
+    // Order reset() deals the keys in
+    enum class InputPattern {
+        SHUFFLED,
+        SORTED,
+        REVERSED,
+        ORGAN_PIPE,         // ascending, then descending
+        APPENDED            // sorted, then a few random keys appended
+    };
+
+    static constexpr int kInputPatternCount = static_cast<int>(InputPattern::APPENDED) + 1;
+
+    // Elements are 32-bit to keep 100M+ element arrays lean, which caps the
+    // array at kMaxSize elements; positions and counters are 64-bit
+    static constexpr size_t kMaxSize = 0x7fffffff;
+
     struct AlgorithmState {
         std::vector<int> array;
-        int comparisons;
-        int swaps;
+        OpCount comparisons;
+        OpCount swaps;
+        OpCount moves;
+        OpCount mispredictions;     // of branches on compares, by a simulated predictor
+        OpCount scans;              // elements the quicksorts' partitioning indices passed over
         double timeElapsed;
-        std::vector<int> highlightIndices;
+        double nativeTime;
+        HighlightBuffer highlights;
+    };
+
+    // Wall times of sorting the current array with the scalar quicksort,
+    // std::sort and the SIMD quicksort, as 32-bit and as 64-bit keys
+    struct SortTimes {
+        double quickSort;
+        double stdSort;
+        double vectorQuickSort;
+    };
+
+    struct SimdBenchmark {
+        simd::Isa isa;
+        SortTimes keys32;
+        SortTimes keys64;
     };
 
     SortingAlgorithm(size_t size = 100);
     
     void reset();
+    void resize(size_t size);
     void shuffle();
     bool step();
+
+    // Batched stepping: one clock pair per batch and highlights only for the
+    // final step. Both return the number of steps actually executed.
+    size_t stepN(size_t count);
+    size_t stepFor(double budgetSeconds, size_t maxSteps = SIZE_MAX);
+
+    // Runs as many steps as the speed target allows for deltaSeconds of wall
+    // time, never spending more than budgetSeconds computing them.
+    size_t advance(double deltaSeconds, double budgetSeconds);
+
+    // Reverse stepping: undoes the most recent steps from an inverse-operation
+    // log of the last UndoLog::kStepCapacity steps. Stepping forward again
+    // redoes them before the algorithm itself continues. Batches longer than
+    // the log, like runToCompletion(), only log the steps that fit.
+    size_t stepBack(size_t count = 1);
+    size_t rewind(double deltaSeconds);
+    bool canStepBack() const { return m_undo.canUndo(); }
+
+    // Finishes the run with the algorithm's native loop instead of stepping,
+    // leaving the same array and counters; a fresh run's duration is stored
+    // in AlgorithmState::nativeTime, which includes counting the operations
+    // and simulating the branch predictor
+    void runToCompletion();
+
+    // Times the current algorithm's native loop without instrumentation on a
+    // copy of the array, leaving the run itself alone. Costs a copy of the
+    // array and a second sort, so it only runs when asked for.
+    double timeUninstrumented() const;
+
+    // Times the SIMD quicksort natively against the scalar ones on copies of
+    // the array, leaving the run itself alone
+    SimdBenchmark benchmarkSimd() const;
+
+    // Runs the current algorithm natively on a copy of the array while
+    // recording every operation, then steps by replaying the trace. The
+    // std:: algorithm types always step this way.
+    void recordRun();
+    bool isPlayingBack() const { return m_playback; }
+    const trace::OperationTrace& getTrace() const { return m_trace; }
+
+    // Same as recordRun() but streams the trace to a file, for runs whose
+    // trace would not fit in memory, and plays it back from there
+    bool recordRunToFile(const std::string& path);
+
+    // Restarts the current algorithm on a copy of the given array
+    void setArray(const std::vector<int>& array);
+
+    // Loads a trace file's initial array and algorithm and plays it back,
+    // mapping only a bounded window of chunks at a time
+    bool openTrace(const std::string& path);
+    const trace::TraceFile& getTraceFile() const { return m_traceFile; }
+
+    // Random access into a recorded run: restores the closest keyframe at or
+    // before the operation and replays only the operations after it.
+    // Keyframes are taken while recording, and while playing back a file.
+    bool seek(uint64_t operation);
+    uint64_t getPlaybackOperation() const { return m_playbackOperation; }
+    uint64_t getPlaybackLength() const;
+    void setKeyframeBudget(size_t bytes) { m_keyframes.setBudget(bytes); }
+    const trace::KeyframeIndex& getKeyframes() const { return m_keyframes; }
+
+    // Whether playback stopped at data that does not decode or an operation
+    // that does not fit the array, which only a corrupt or crafted trace
+    // file can hold
+    bool isTraceCorrupt() const { return m_traceCorrupt; }
+
+    // Speed is a target in steps (operations) per second
     void setSpeed(float speed) { m_speed = speed; }
+    float getSpeed() const { return m_speed; }
     void setAlgorithm(AlgorithmType type);
+
+    // Deals a fresh input in the given order
+    void setInputPattern(InputPattern pattern);
+    InputPattern getInputPattern() const { return m_inputPattern; }
+    static const char* getInputPatternName(InputPattern pattern);
+
+    // Digit width of radix sort: 8, 11 or 16 bits
+    void setRadixBits(unsigned bits);
+    unsigned getRadixBits() const { return m_radixBits; }
     
     const AlgorithmState& getState() const { return m_state; }
     bool isFinished() const { return m_finished; }
     std::string getAlgorithmName() const;
+    static const char* getAlgorithmName(AlgorithmType type);
     AlgorithmType getAlgorithmType() const { return m_currentAlgorithm; }
 
     // Getters for visualization state
-    int getCurrentIndex() const { return m_currentIndex; }
-    int getCompareIndex() const { return m_compareIndex; }
-    int getPartitionIndex() const { return m_partitionIndex; }
+    SortIndex getCurrentIndex() const { return m_currentIndex; }
+    SortIndex getCompareIndex() const { return m_compareIndex; }
+    SortIndex getPartitionIndex() const { return m_partitionIndex; }
     const std::vector<int>& getAuxArray() const { return m_auxArray; }
+    size_t getAuxBytes() const { return m_auxArray.capacity() * sizeof(int); }
+
+    // Buckets of the counting or radix pass being stepped through: counts
+    // while the histogram is built, then each bucket's next free slot while
+    // scattering. Null when there are none to show.
+    const SortIndex* getBuckets(size_t& count) const;
+
+    // Bytes read and written by each pass of the last counting or radix sort
+    const std::vector<uint64_t>& getPassBytes() const { return m_radix.passBytes; }
+
+    // Sorting network of the last small range stepped through
+    using NetworkProgress = kernels::NetworkProgress;
+    const NetworkProgress& getNetworkProgress() const { return m_network; }
+
+    // The dual-pivot partition being stepped through, as its three regions
+    // and the unscanned middle. Null when there is none.
+    const kernels::DualPartition* getDualPartition() const;
+
+    // Powersort's runs and merges as last stepped
+    const kernels::PowerSort& getPowerSort() const { return m_power; }
+
+    // Buckets an MSD radix sort has yet to sort
+    size_t getPendingBuckets() const { return m_radix.pending.size(); }
+    int getMaxValue() const { return m_maxValue; }
 
 private:
+    void restart();
+
     void initQuickSort();
     void initMergeSort();
     void initBubbleSort();
     void initHeapSort();
+    void initRadixSort();
+    void initPowerSort();
 
     bool stepQuickSort();
     bool stepMergeSort();
     bool stepBubbleSort();
     bool stepHeapSort();
+    bool stepBottomUpHeapSort();
+    bool stepCountingSort();
+    bool stepRadixSort();
+    bool stepAmericanFlagSort();
+    bool stepPdqSort();
+    bool stepBlockQuickSort();
+    bool stepVectorQuickSort();
+    bool stepNetworkSort();
+    bool stepPowerSort();
+    bool stepDualPivotQuickSort();
+    bool stepHeapSortRange();
+    bool stepMergePasses();
+    bool stepStdAlgorithm();
+
+    void recordTrace();
+    const uint8_t* playbackChunk(size_t& size);
+    bool playTrace(uint64_t until, bool stopAtVisible);
+    bool stepPlayback();
+    void captureKeyframe();
+    bool traceOpInBounds(const trace::Operation& op) const;
+    bool applyTraceOp(const trace::Operation& op);
+    void highlightTraceOp(const trace::Operation& op);
+
+    UndoLog::StepState stepState() const;
+    void restoreStepState(const UndoLog::StepState& state);
+    bool redoStep();
+    void redoAll();
+
+    bool stepOnce();
+    size_t runBatch(size_t count);
+    template <bool (SortingAlgorithm::*Step)()>
+    size_t runSteps(size_t count);
 
     AlgorithmState m_state;
     AlgorithmType m_currentAlgorithm;
+    InputPattern m_inputPattern;
     float m_speed;
     bool m_finished;
+    bool m_trackHighlights;
+    double m_pendingSteps;
+    size_t m_stepsTaken;
+    int m_maxValue;
     
-    // Algorithm specific state
+    // Algorithm specific state, kept here so the step coroutines can resume
+    Coroutine m_coroutine;
+    Coroutine m_rangeCoroutine;     // a sort of partitionRange within a larger one
+    PartitionStack m_partitions;
+    PartitionStack::Range m_partitionRange;
+    SortIndex m_mergeWidth;         // run width of the current merge pass
+    SortIndex m_mergeBegin;
+    SortIndex m_mergeMid;
+    SortIndex m_mergeEnd;
+    bool m_mergeToAux;
+    SortIndex m_heapRoot;           // node being sifted down
+    int m_heapCarry;                // element being shifted along a sift path
+    kernels::RadixWorkspace m_radix;
+    unsigned m_radixBits;
+    unsigned m_radixDigit;          // digit being scattered
+    bool m_radixFromAux;
+    uint64_t m_radixMinKey;
+    kernels::RadixRange m_radixRange;   // MSD bucket being sorted
+    size_t m_radixBucket;               // its sub-bucket being permuted into
+    int m_pdqStep;                  // pivot compare-exchange, or insertion sort pass
+    int m_pdqPasses;                // insertion sort passes that finish the range
+    bool m_pdqScanning;             // whether the last compare keeps a scan going
+    OpCount m_pdqMoves;
+    kernels::BlockPartition m_block;
+    SortIndex m_blockStep;          // element of the block being scanned, or pair being swapped
+    kernels::VectorPartition<int> m_vector;
+    SortIndex m_vectorLanes;
+    SortIndex m_vectorStep;         // leftover key being placed, or end vector being stored
+    NetworkProgress m_network;
+    kernels::PowerSort m_power;
+    kernels::DualPartition m_dual;
+    bool m_dualPartitioning;
+    BranchPredictor m_predictor;
     std::vector<int> m_auxArray;
-    int m_currentIndex;
-    int m_compareIndex;
-    int m_partitionIndex;
+    UndoLog m_undo;
+
+    // Recorded run being played back, from memory or chunk by chunk from a
+    // trace file
+    bool m_playback;
+    trace::OperationTrace m_trace;
+    trace::TraceFile m_traceFile;
+    size_t m_playbackChunk;
+    trace::DecoderState m_playbackState;
+    uint64_t m_playbackOperation;
+    trace::Operation m_lastVisible;
+    bool m_traceCorrupt;
+    trace::KeyframeIndex m_keyframes;
+    SortIndex m_currentIndex;
+    SortIndex m_compareIndex;
+    SortIndex m_partitionIndex;
 };
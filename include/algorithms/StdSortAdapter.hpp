@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include "algorithms/SortTypes.hpp"
+
+// Proxies that let the standard library's own sorting algorithms run on an
+// array while every compare and element move is reported to an
+// instrumentation policy (see Instrumentation.hpp).
+//
+// CountingIterator is a random-access iterator whose reference type is an
+// ElementRef proxy that knows its position, so assignments through it are
+// reported as writes and swapping two of them as a swap. Elements the
+// algorithm lifts out of the array into locals or a merge buffer become
+// TrackedValue, which has no position; a compare involving one reports index
+// -1 for that side. CountingCompare wraps the comparator and reports each call.
+namespace stdsort {
+
+template <typename Key, typename Policy>
+class ElementRef;
+
+template <typename Key, typename Policy>
+class TrackedValue {
+public:
+    TrackedValue() = default;
+    TrackedValue(const ElementRef<Key, Policy>& ref) : m_value(ref.read()) {}
+
+    TrackedValue& operator=(const ElementRef<Key, Policy>& ref) {
+        m_value = ref.read();
+        return *this;
+    }
+
+    const Key& get() const { return m_value; }
+    SortIndex index() const { return -1; }
+
+private:
+    Key m_value;
+};
+
+template <typename Key, typename Policy>
+class ElementRef {
+public:
+    ElementRef(Key* base, SortIndex index, Policy* policy)
+        : m_base(base), m_index(index), m_policy(policy) {}
+
+    // Copying the proxy aliases the element; assigning through it moves values
+    ElementRef(const ElementRef&) = default;
+
+    ElementRef& operator=(const ElementRef& other) {
+        write(other.read());
+        return *this;
+    }
+
+    ElementRef& operator=(const TrackedValue<Key, Policy>& value) {
+        write(value.get());
+        return *this;
+    }
+
+    const Key& get() const { return m_base[m_index]; }
+    SortIndex index() const { return m_index; }
+
+    Key read() const {
+        m_policy->onRead(m_index);
+        return m_base[m_index];
+    }
+
+    void write(const Key& value) const {
+        m_policy->onWrite(m_index, value);
+        m_base[m_index] = value;
+    }
+
+    friend void swap(ElementRef a, ElementRef b) {
+        a.m_policy->onSwap(a.m_index, b.m_index);
+        using std::swap;
+        swap(a.m_base[a.m_index], b.m_base[b.m_index]);
+    }
+
+private:
+    Key* m_base;
+    SortIndex m_index;
+    Policy* m_policy;
+};
+
+template <typename Key, typename Policy>
+class CountingIterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = TrackedValue<Key, Policy>;
+    using difference_type = std::ptrdiff_t;
+    using reference = ElementRef<Key, Policy>;
+    using pointer = void;
+
+    CountingIterator() : m_base(nullptr), m_index(0), m_policy(nullptr) {}
+    CountingIterator(Key* base, SortIndex index, Policy* policy)
+        : m_base(base), m_index(index), m_policy(policy) {}
+
+    reference operator*() const { return reference(m_base, m_index, m_policy); }
+    reference operator[](difference_type n) const { return reference(m_base, m_index + n, m_policy); }
+
+    CountingIterator& operator++() { ++m_index; return *this; }
+    CountingIterator& operator--() { --m_index; return *this; }
+    CountingIterator operator++(int) { CountingIterator old = *this; ++m_index; return old; }
+    CountingIterator operator--(int) { CountingIterator old = *this; --m_index; return old; }
+    CountingIterator& operator+=(difference_type n) { m_index += n; return *this; }
+    CountingIterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+    friend CountingIterator operator+(CountingIterator it, difference_type n) { return it += n; }
+    friend CountingIterator operator+(difference_type n, CountingIterator it) { return it += n; }
+    friend CountingIterator operator-(CountingIterator it, difference_type n) { return it -= n; }
+    friend difference_type operator-(const CountingIterator& a, const CountingIterator& b) {
+        return static_cast<difference_type>(a.m_index - b.m_index);
+    }
+
+    friend bool operator==(const CountingIterator& a, const CountingIterator& b) { return a.m_index == b.m_index; }
+    friend bool operator!=(const CountingIterator& a, const CountingIterator& b) { return a.m_index != b.m_index; }
+    friend bool operator<(const CountingIterator& a, const CountingIterator& b) { return a.m_index < b.m_index; }
+    friend bool operator>(const CountingIterator& a, const CountingIterator& b) { return a.m_index > b.m_index; }
+    friend bool operator<=(const CountingIterator& a, const CountingIterator& b) { return a.m_index <= b.m_index; }
+    friend bool operator>=(const CountingIterator& a, const CountingIterator& b) { return a.m_index >= b.m_index; }
+
+private:
+    Key* m_base;
+    SortIndex m_index;
+    Policy* m_policy;
+};
+
+template <typename Compare, typename Policy>
+class CountingCompare {
+public:
+    CountingCompare(const Compare& compare, Policy* policy) : m_compare(compare), m_policy(policy) {}
+
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const {
+        const bool result = m_compare(a.get(), b.get());
+        m_policy->onCompare(a.index(), b.index(), result);
+        m_policy->onBranch(result);
+        return result;
+    }
+
+private:
+    Compare m_compare;
+    Policy* m_policy;
+};
+
+}
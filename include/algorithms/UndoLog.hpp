@@ -0,0 +1,219 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "algorithms/BranchPredictor.hpp"
+#include "algorithms/HighlightBuffer.hpp"
+#include "algorithms/kernels/DualPivotQuickSort.hpp"
+#include "algorithms/kernels/SortingNetwork.hpp"
+#include "trace/OperationTrace.hpp"
+#include "algorithms/SortTypes.hpp"
+
+// Inverse operations of the most recent steps, for stepping backwards.
+//
+// Every step gets a record of the counters and indices from before it, and
+// every swap or write it makes to the array or the aux buffer is logged with
+// the old value, so a step is undone by reverting its few mutations and
+// redone by reapplying them. Records and mutations live in two ring buffers
+// that overwrite the oldest steps, so the cost per step is a handful of
+// stores and the memory is fixed however long the run.
+class UndoLog {
+public:
+    static constexpr size_t kStepCapacity = 1 << 16;
+    static constexpr size_t kMutationCapacity = 1 << 18;
+    // Radix passes over int keys: a counting pass, four 8-bit digits and a
+    // copy back at most
+    static constexpr size_t kPassCapacity = 6;
+
+    // What a step changes besides the array
+    struct StepState {
+        OpCount comparisons;
+        OpCount swaps;
+        OpCount moves;
+        OpCount mispredictions;
+        OpCount scans;
+        BranchPredictor predictor;
+        SortIndex currentIndex;
+        SortIndex compareIndex;
+        SortIndex partitionIndex;
+        kernels::DualPartition dual;
+        bool dualPartitioning;
+        bool finished;
+
+        // Progress the algorithms display, kept so that it rewinds too
+        kernels::NetworkProgress network;
+        SortIndex powerRunsFound;
+        size_t powerRunCount;
+        SortIndex powerMinGallop;
+        uint64_t passBytes[kPassCapacity];
+        uint8_t passCount;
+        uint64_t playbackOperation;
+        trace::Operation lastVisible;
+    };
+
+    void clear() {
+        m_stepHead = 0;
+        m_stepTail = 0;
+        m_mutationHead = 0;
+        m_tailMutation = 0;
+        m_depth = 0;
+    }
+
+    // For steps too far from the end of a batch to ever be stepped back to:
+    // the history is dropped and nothing is logged until resume()
+    void suspend() {
+        clear();
+        m_suspended = true;
+    }
+    void resume() { m_suspended = false; }
+
+    // Steps currently undone; new steps may only begin once they are redone
+    size_t depth() const { return m_depth; }
+    bool canUndo() const { return m_stepHead - m_stepTail > m_depth; }
+
+    void beginStep(const StepState& before) {
+        if (m_steps.empty()) {
+            m_steps.resize(kStepCapacity);
+            m_mutations.resize(kMutationCapacity);
+        }
+        if (m_stepHead == m_stepTail) m_tailMutation = m_mutationHead;
+        if (m_stepHead - m_stepTail == kStepCapacity) dropOldestStep();
+        m_steps[m_stepHead % kStepCapacity] = StepRecord{before, m_mutationHead};
+        m_stepHead++;
+    }
+
+    // Drops the step just begun, for steps that turned out not to be one.
+    // Such a step can still have mutated something on the way, like the aux
+    // writes trace playback applies before finding the trace exhausted, so
+    // its mutations become part of the step before it when there is one.
+    void discardStep() {
+        m_stepHead--;
+        if (m_stepTail >= m_stepHead) {
+            m_mutationHead = m_steps[m_stepHead % kStepCapacity].firstMutation;
+            m_stepTail = m_stepHead;
+        }
+    }
+
+    void recordSwap(SortIndex i, SortIndex j) {
+        push(Mutation{i, j, 0, 0});
+    }
+
+    void recordWrite(SortIndex i, int oldValue, int newValue) {
+        push(Mutation{i, kWrite, oldValue, newValue});
+    }
+
+    void recordAuxWrite(SortIndex i, int oldValue, int newValue) {
+        push(Mutation{i, kAuxWrite, oldValue, newValue});
+    }
+
+    // Reverts the latest step that is not undone yet and returns the state
+    // from before it. current is the state to come back to once every undone
+    // step is redone.
+    const StepState& undo(std::vector<int>& array, std::vector<int>& aux, const StepState& current) {
+        if (m_depth == 0) m_frontier = current;
+        m_depth++;
+        const uint64_t step = m_stepHead - m_depth;
+        const uint64_t end = mutationEnd(step);
+        for (uint64_t m = end; m-- > record(step).firstMutation;) {
+            const Mutation& mutation = m_mutations[m % kMutationCapacity];
+            if (mutation.other >= 0) {
+                std::swap(array[mutation.index], array[mutation.other]);
+            } else {
+                target(mutation, array, aux)[mutation.index] = mutation.oldValue;
+            }
+        }
+        return record(step).before;
+    }
+
+    // Reapplies the earliest undone step and returns the state after it
+    const StepState& redo(std::vector<int>& array, std::vector<int>& aux) {
+        const uint64_t step = m_stepHead - m_depth;
+        const uint64_t end = mutationEnd(step);
+        for (uint64_t m = record(step).firstMutation; m < end; ++m) {
+            const Mutation& mutation = m_mutations[m % kMutationCapacity];
+            if (mutation.other >= 0) {
+                std::swap(array[mutation.index], array[mutation.other]);
+            } else {
+                target(mutation, array, aux)[mutation.index] = mutation.newValue;
+            }
+        }
+        m_depth--;
+        return m_depth == 0 ? m_frontier : record(step + 1).before;
+    }
+
+    // Marks the elements of the step an undo or redo would touch next
+    void highlightNextUndo(HighlightBuffer& highlights) const {
+        if (canUndo()) highlightStep(m_stepHead - m_depth - 1, highlights);
+    }
+    void highlightNextRedo(HighlightBuffer& highlights) const {
+        if (m_depth > 0) highlightStep(m_stepHead - m_depth, highlights);
+    }
+
+private:
+    struct StepRecord {
+        StepState before;
+        uint64_t firstMutation;
+    };
+
+    // Writes keep the old and the new value and have other set to the buffer
+    // written; swaps have other >= 0
+    static constexpr SortIndex kWrite = -1;
+    static constexpr SortIndex kAuxWrite = -2;
+
+    struct Mutation {
+        SortIndex index;
+        SortIndex other;
+        int oldValue;
+        int newValue;
+    };
+
+    static std::vector<int>& target(const Mutation& mutation, std::vector<int>& array, std::vector<int>& aux) {
+        return mutation.other == kAuxWrite ? aux : array;
+    }
+
+    const StepRecord& record(uint64_t step) const { return m_steps[step % kStepCapacity]; }
+
+    uint64_t mutationEnd(uint64_t step) const {
+        return step + 1 < m_stepHead ? record(step + 1).firstMutation : m_mutationHead;
+    }
+
+    void push(const Mutation& mutation) {
+        // Nothing to attach mutations to before the first step
+        if (m_suspended || m_mutations.empty()) return;
+        m_mutations[m_mutationHead % kMutationCapacity] = mutation;
+        m_mutationHead++;
+        // Steps whose mutations were just overwritten can no longer be undone
+        while (m_stepTail < m_stepHead && m_mutationHead - m_tailMutation > kMutationCapacity) {
+            dropOldestStep();
+        }
+    }
+
+    void dropOldestStep() {
+        m_stepTail++;
+        m_tailMutation = m_stepTail < m_stepHead ? record(m_stepTail).firstMutation : m_mutationHead;
+    }
+
+    void highlightStep(uint64_t step, HighlightBuffer& highlights) const {
+        const uint64_t end = mutationEnd(step);
+        for (uint64_t m = record(step).firstMutation; m < end; ++m) {
+            const Mutation& mutation = m_mutations[m % kMutationCapacity];
+            // Highlights are positions in the array
+            if (mutation.other == kAuxWrite) continue;
+            if (highlights.size() < HighlightBuffer::kCapacity) highlights.add(mutation.index, HighlightRole::WRITE);
+            if (mutation.other >= 0 && highlights.size() < HighlightBuffer::kCapacity) {
+                highlights.add(mutation.other, HighlightRole::WRITE);
+            }
+        }
+    }
+
+    std::vector<StepRecord> m_steps;
+    std::vector<Mutation> m_mutations;
+    uint64_t m_stepHead = 0;
+    uint64_t m_stepTail = 0;
+    uint64_t m_mutationHead = 0;
+    uint64_t m_tailMutation = 0;    // first mutation of the oldest step
+    size_t m_depth = 0;
+    bool m_suspended = false;
+    StepState m_frontier{};
+};
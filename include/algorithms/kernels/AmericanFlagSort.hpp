@@ -0,0 +1,148 @@
+#pragma once
+#include <algorithm>
+#include "algorithms/kernels/RadixSort.hpp"
+
+namespace kernels {
+
+// American flag sort works on 8-bit digits, most significant first, and
+// leaves buckets this small to insertion sort
+constexpr unsigned kFlagDigitBits = 8;
+constexpr size_t kFlagBucketCount = size_t(1) << kFlagDigitBits;
+constexpr SortIndex kFlagInsertionThreshold = 32;
+
+// The workspace's buckets hold the heads of the range's buckets, then their ends
+inline SortIndex* flagHeads(RadixWorkspace& workspace) { return workspace.buckets.data(); }
+inline SortIndex* flagEnds(RadixWorkspace& workspace) { return workspace.buckets.data() + kFlagBucketCount; }
+
+// Traffic is counted per digit, the most significant one first
+inline uint64_t& flagBytes(RadixWorkspace& workspace, unsigned digit) {
+    return workspace.passBytes[workspace.digitCount - 1 - digit];
+}
+
+template <typename Key>
+size_t flagDigit(const Key& key, unsigned digit) {
+    return static_cast<size_t>(RadixKey<Key>::of(key) >> (digit * kFlagDigitBits)) & (kFlagBucketCount - 1);
+}
+
+template <typename Key>
+void flagBegin(RadixWorkspace& workspace, SortIndex n) {
+    workspace.digitBits = kFlagDigitBits;
+    workspace.digitCount = radixDigitCount<Key>(kFlagDigitBits);
+    workspace.buckets.assign(2 * kFlagBucketCount, 0);
+    workspace.skipDigit.clear();
+    workspace.passBytes.assign(workspace.digitCount, 0);
+    workspace.pending.clear();
+    if (n > 1) workspace.pending.push_back(RadixRange{0, n, workspace.digitCount - 1});
+}
+
+inline void flagClearCounts(RadixWorkspace& workspace) {
+    std::fill(flagHeads(workspace), flagHeads(workspace) + kFlagBucketCount, SortIndex(0));
+}
+
+template <typename View>
+void flagCount(View& a, RadixWorkspace& workspace, const RadixRange& range, SortIndex i) {
+    using Key = typename View::KeyType;
+    flagHeads(workspace)[flagDigit(a.read(i), range.digit)]++;
+    flagBytes(workspace, range.digit) += sizeof(Key);
+}
+
+// Turns the range's counts into the head and end of each bucket. False when
+// every key is in one bucket, which leaves nothing to permute on this digit.
+inline bool flagPrefixSums(RadixWorkspace& workspace, const RadixRange& range) {
+    SortIndex* heads = flagHeads(workspace);
+    SortIndex* ends = flagEnds(workspace);
+    SortIndex sum = range.begin;
+    bool spread = true;
+    for (size_t bucket = 0; bucket < kFlagBucketCount; ++bucket) {
+        const SortIndex count = heads[bucket];
+        if (count == range.end - range.begin) spread = false;
+        heads[bucket] = sum;
+        sum += count;
+        ends[bucket] = sum;
+    }
+    return spread;
+}
+
+// One move of the cycle-leader permutation: the element at the head of
+// bucket either belongs there, and the head moves on, or is swapped to the
+// head of its own bucket, which moves on instead while the element swapped
+// in is looked at next. Returns where the element went.
+template <typename View>
+SortIndex flagPlace(View& a, RadixWorkspace& workspace, unsigned digit, size_t bucket) {
+    using Key = typename View::KeyType;
+    const SortIndex from = flagHeads(workspace)[bucket];
+    const SortIndex to = flagHeads(workspace)[flagDigit(a.read(from), digit)]++;
+    flagBytes(workspace, digit) += sizeof(Key);
+    if (to != from) {
+        a.swap(from, to);
+        flagBytes(workspace, digit) += 4 * sizeof(Key);
+    }
+    return to;
+}
+
+// Queues the buckets of a permuted range, or the whole range if it was not
+// spread, for the next digit down with the first bucket on top
+inline void flagPushBuckets(RadixWorkspace& workspace, const RadixRange& range, bool spread) {
+    if (range.digit == 0) return;
+    if (!spread) {
+        workspace.pending.push_back(RadixRange{range.begin, range.end, range.digit - 1});
+        return;
+    }
+    const SortIndex* ends = flagEnds(workspace);
+    for (size_t bucket = kFlagBucketCount; bucket-- > 0;) {
+        const SortIndex begin = bucket == 0 ? range.begin : ends[bucket - 1];
+        if (ends[bucket] - begin > 1) workspace.pending.push_back(RadixRange{begin, ends[bucket], range.digit - 1});
+    }
+}
+
+// One compare of an insertion sort on a small bucket, swapping element j
+// down if it belongs before its neighbour; false once it is in place
+template <typename View>
+bool flagInsertionStep(View& a, RadixWorkspace& workspace, const RadixRange& range, SortIndex j) {
+    using Key = typename View::KeyType;
+    flagBytes(workspace, range.digit) += 2 * sizeof(Key);
+    if (!a.less(j, j - 1)) return false;
+    a.swap(j, j - 1);
+    flagBytes(workspace, range.digit) += 4 * sizeof(Key);
+    return true;
+}
+
+// In-place MSD radix sort. Each bucket has its digit counted, then is
+// permuted into sub-buckets by cycle leading through the bucket heads, and
+// its sub-buckets are sorted on the next digit. Only 2 x 256 bucket
+// boundaries and the pending buckets are kept besides the keys. The small
+// buckets' insertion sort compares with Compare, which like the radix
+// passes must order keys ascending.
+template <typename View>
+void americanFlagSort(View& a, RadixWorkspace& workspace) {
+    using Key = typename View::KeyType;
+    flagBegin<Key>(workspace, a.size());
+
+    while (!workspace.pending.empty()) {
+        const RadixRange range = workspace.pending.back();
+        workspace.pending.pop_back();
+
+        if (range.end - range.begin < kFlagInsertionThreshold) {
+            for (SortIndex i = range.begin + 1; i < range.end; ++i) {
+                for (SortIndex j = i; j > range.begin && flagInsertionStep(a, workspace, range, j); --j) {}
+            }
+            continue;
+        }
+
+        flagClearCounts(workspace);
+        for (SortIndex i = range.begin; i < range.end; ++i) {
+            flagCount(a, workspace, range, i);
+        }
+        const bool spread = flagPrefixSums(workspace, range);
+        if (spread) {
+            for (size_t bucket = 0; bucket < kFlagBucketCount; ++bucket) {
+                while (flagHeads(workspace)[bucket] < flagEnds(workspace)[bucket]) {
+                    flagPlace(a, workspace, range.digit, bucket);
+                }
+            }
+        }
+        flagPushBuckets(workspace, range, spread);
+    }
+}
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "algorithms/PartitionStack.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/kernels/HeapSort.hpp"
+#include "algorithms/kernels/PdqSort.hpp"
+
+namespace kernels {
+
+// Elements per block; offsets within a block fit in a byte
+constexpr SortIndex kBlockSize = 128;
+
+// A block partition in progress around the pivot at begin. Everything left
+// of left is smaller than the pivot and everything right of right is not.
+// The blocks at left and right each keep the offsets of their elements that
+// belong on the other side; count of them from start on are still to swap.
+struct BlockPartition {
+    SortIndex left = 0;
+    SortIndex right = 0;
+    size_t leftStart = 0;
+    size_t leftCount = 0;
+    size_t rightStart = 0;
+    size_t rightCount = 0;
+    uint8_t leftOffsets[kBlockSize] = {};
+    uint8_t rightOffsets[kBlockSize] = {};
+};
+
+// Whether the unpartitioned middle still holds two whole blocks
+inline bool blockHasTwoBlocks(const BlockPartition& p) {
+    return p.right - p.left + 1 > 2 * kBlockSize;
+}
+
+// One compare of filling the left buffer. The offset is always stored and
+// the count only advances past it if the element belongs right, so the
+// result never decides a branch.
+template <typename View>
+void blockScanLeft(View& a, BlockPartition& p, SortIndex pivot, SortIndex i) {
+    p.leftOffsets[p.leftCount] = static_cast<uint8_t>(i);
+    p.leftCount += !a.lessBranchFree(p.left + i, pivot);
+}
+
+template <typename View>
+void blockScanRight(View& a, BlockPartition& p, SortIndex pivot, SortIndex i) {
+    p.rightOffsets[p.rightCount] = static_cast<uint8_t>(i);
+    p.rightCount += a.lessBranchFree(p.right - i, pivot);
+}
+
+// The j-th pair of misplaced elements in the two blocks
+inline std::pair<SortIndex, SortIndex> blockSwapPair(const BlockPartition& p, size_t j) {
+    return {p.left + p.leftOffsets[p.leftStart + j], p.right - p.rightOffsets[p.rightStart + j]};
+}
+
+// After swapping pairs, moves past each block that has none left
+inline void blockAdvance(BlockPartition& p, size_t swapped) {
+    p.leftStart += swapped;
+    p.leftCount -= swapped;
+    p.rightStart += swapped;
+    p.rightCount -= swapped;
+    if (p.leftCount == 0) {
+        p.left += kBlockSize;
+        p.leftStart = 0;
+    }
+    if (p.rightCount == 0) {
+        p.right -= kBlockSize;
+        p.rightStart = 0;
+    }
+}
+
+// One element of a branch-free Lomuto partition: it is swapped to the
+// boundary whatever it is, and the boundary only moves past it if it is
+// smaller than the pivot. Returns how far the boundary moved.
+template <typename View>
+SortIndex blockLomutoStep(View& a, SortIndex pivot, SortIndex boundary, SortIndex i) {
+    const bool smaller = a.lessBranchFree(i, pivot);
+    a.swap(boundary, i);
+    return smaller;
+}
+
+// Block partition (Edelkamp and Weiss) of [begin, end) around the pivot at
+// begin, equal elements going right. Rather than branching on each compare
+// as Hoare's and Lomuto's scans do, which mispredicts about half the time on
+// random input, it compares a whole block from each end and writes down the
+// offsets of the misplaced elements, then swaps them in pairs. Fewer than
+// two blocks' worth in the middle are finished with a branch-free Lomuto
+// pass. Returns the pivot's final position.
+template <typename View>
+SortIndex blockPartition(View& a, SortIndex begin, SortIndex end) {
+    BlockPartition p;
+    p.left = begin + 1;
+    p.right = end - 1;
+    while (blockHasTwoBlocks(p)) {
+        if (p.leftCount == 0) {
+            for (SortIndex i = 0; i < kBlockSize; ++i) blockScanLeft(a, p, begin, i);
+        }
+        if (p.rightCount == 0) {
+            for (SortIndex i = 0; i < kBlockSize; ++i) blockScanRight(a, p, begin, i);
+        }
+        const size_t swaps = std::min(p.leftCount, p.rightCount);
+        for (size_t j = 0; j < swaps; ++j) {
+            const std::pair<SortIndex, SortIndex> pair = blockSwapPair(p, j);
+            a.swap(pair.first, pair.second);
+        }
+        blockAdvance(p, swaps);
+    }
+
+    SortIndex boundary = p.left;
+    for (SortIndex i = p.left; i <= p.right; ++i) {
+        boundary += blockLomutoStep(a, begin, boundary, i);
+    }
+    const SortIndex pivot = boundary - 1;
+    if (pivot != begin) a.swap(begin, pivot);
+    return pivot;
+}
+
+// Partitions a sort of n elements may go deep before a range is heap sorted
+// instead: 2 log2(n), as in introsort
+inline int blockDepthBudget(SortIndex n) {
+    return 2 * pdqBadPartitionBudget(n);
+}
+
+// BlockQuicksort: quicksort on block partitions, with pdqSort's pivots and
+// insertion sort of small ranges, and heap sort for ranges that run out of
+// depth budget
+template <typename View>
+void blockQuickSort(View& a) {
+    if (a.size() < 2) return;
+
+    PartitionStack pending;
+    pending.push(0, a.size() - 1, blockDepthBudget(a.size()));
+    while (!pending.empty()) {
+        PartitionStack::Range range = pending.pop();
+        const SortIndex begin = range.left;
+        const SortIndex end = range.right + 1;
+        if (end - begin < kPdqInsertionThreshold) {
+            pdqInsertionSort(a, begin, end, UINT64_MAX);
+            continue;
+        }
+        if (range.budget-- == 0) {
+            heapSortRange(a, begin, end);
+            continue;
+        }
+
+        pdqChoosePivot(a, begin, end);
+        pending.pushChildren(range, blockPartition(a, begin, end));
+    }
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// Classic bubble sort: n - 1 full passes, each one element shorter
+template <typename View>
+void bubbleSort(View& a) {
+    const SortIndex n = a.size();
+    for (SortIndex pass = 0; pass < n - 1; ++pass) {
+        for (SortIndex i = 0; i < n - pass - 1; ++i) {
+            if (a.less(i + 1, i)) {
+                a.swap(i, i + 1);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "algorithms/PartitionStack.hpp"
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// A dual-pivot partition of [left, right] in progress, with the small pivot
+// at left and the large one at right. Keys in (left, less) are smaller than
+// the small pivot, keys from less up to scan lie between the two, and keys in
+// (greater, right) are no smaller than the large pivot; [scan, greater] is
+// still to look at.
+struct DualPartition {
+    SortIndex left = 0;
+    SortIndex right = 0;
+    SortIndex less = 0;
+    SortIndex scan = 0;
+    SortIndex greater = 0;
+};
+
+// Orders the two pivots, the range's end keys
+template <typename View>
+void dualPivotBegin(View& a, DualPartition& p, SortIndex left, SortIndex right) {
+    if (a.less(right, left)) a.swap(left, right);
+    p.left = left;
+    p.right = right;
+    p.less = left + 1;
+    p.scan = left + 1;
+    p.greater = right - 1;
+}
+
+// End of the keys between the pivots. The last key looked at can go right
+// with scan passing greater, so the middle stops at whichever comes first.
+inline SortIndex dualPivotMiddleEnd(const DualPartition& p) {
+    return p.scan < p.greater + 1 ? p.scan : p.greater + 1;
+}
+
+// Whether there are keys left to look at
+inline bool dualPivotScanning(const DualPartition& p) {
+    return p.scan <= p.greater;
+}
+
+// Places the key at scan. A key no smaller than the large pivot is swapped
+// with the first key from greater down that is not larger; that one may in
+// turn be smaller than the small pivot.
+template <typename View>
+void dualPivotStep(View& a, DualPartition& p) {
+    const SortIndex k = p.scan;
+    a.scan(k);
+    if (a.less(k, p.left)) {
+        if (k != p.less) a.swap(k, p.less);
+        a.scan(p.less++);
+    } else if (!a.less(k, p.right)) {
+        while (k < p.greater && a.less(p.right, p.greater)) {
+            a.scan(p.greater--);
+        }
+        if (k != p.greater) a.swap(k, p.greater);
+        a.scan(p.greater--);
+        if (a.less(k, p.left)) {
+            if (k != p.less) a.swap(k, p.less);
+            a.scan(p.less++);
+        }
+    }
+    p.scan++;
+}
+
+// Swaps the pivots into their final places, less - 1 and greater + 1, and
+// leaves less and greater there
+template <typename View>
+void dualPivotFinish(View& a, DualPartition& p) {
+    p.less--;
+    p.greater++;
+    if (p.less != p.left) a.swap(p.left, p.less);
+    if (p.greater != p.right) a.swap(p.right, p.greater);
+}
+
+// Iterative dual-pivot quicksort (Yaroslavskiy), partitioning each range
+// three ways around its end keys in a single pass. It makes about as many
+// compares as the classic one but scans fewer elements, about 1.6 n ln n
+// against 2 n ln n for Hoare's partition and more for Lomuto's, so it
+// streams less memory.
+template <typename View>
+void dualPivotQuickSort(View& a) {
+    if (a.size() < 2) return;
+
+    PartitionStack pending;
+    pending.push(0, a.size() - 1);
+    while (!pending.empty()) {
+        const PartitionStack::Range range = pending.pop();
+
+        DualPartition p;
+        dualPivotBegin(a, p, range.left, range.right);
+        while (dualPivotScanning(p)) {
+            dualPivotStep(a, p);
+        }
+        dualPivotFinish(a, p);
+
+        pending.pushChildren(range, p.less, p.greater);
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// Heaps are laid out from index base of the array, with nodes and ends
+// counted from there; base is 0 unless sorting part of an array.
+
+// Larger child of a heap node, or -1 for a leaf. Takes one compare when the
+// node has two children.
+template <typename View>
+SortIndex heapLargerChild(View& a, SortIndex node, SortIndex end, SortIndex base = 0) {
+    const SortIndex left = 2 * node + 1;
+    if (left >= end) return -1;
+    if (left + 1 < end && a.less(base + left, base + left + 1)) return left + 1;
+    return left;
+}
+
+// One level of the classic sift-down: swaps the node with its larger child
+// if that child is bigger. Returns the child it moved to, or -1 once the
+// node is in place.
+template <typename View>
+SortIndex siftDownStep(View& a, SortIndex node, SortIndex end, SortIndex base = 0) {
+    const SortIndex child = heapLargerChild(a, node, end, base);
+    if (child < 0 || !a.less(base + node, base + child)) return -1;
+    a.swap(base + node, base + child);
+    return child;
+}
+
+template <typename View>
+void siftDown(View& a, SortIndex root, SortIndex end, SortIndex base = 0) {
+    for (SortIndex node = root; node >= 0;) {
+        node = siftDownStep(a, node, end, base);
+    }
+}
+
+// Wegener's bottom-up sift-down. Rather than comparing the sifted element at
+// every level, it follows the larger children all the way to a leaf at one
+// compare per level, then climbs back to where the element belongs. Most of
+// a heap is near its leaves, so the climb is usually a level or two and the
+// comparisons come to about half of siftDown's. The element is then put in
+// place by shifting the path above it up one level.
+template <typename View>
+void siftDownBottomUp(View& a, SortIndex root, SortIndex end) {
+    SortIndex node = root;
+    for (SortIndex child = heapLargerChild(a, node, end); child >= 0; child = heapLargerChild(a, node, end)) {
+        node = child;
+    }
+    while (node > root && a.less(node, root)) {
+        node = (node - 1) / 2;
+    }
+    if (node == root) return;
+
+    typename View::KeyType carry = a.read(root);
+    for (; node != root; node = (node - 1) / 2) {
+        typename View::KeyType displaced = a.read(node);
+        a.write(node, carry);
+        carry = displaced;
+    }
+    a.write(root, carry);
+}
+
+// Heap sort with Floyd's bottom-up construction, which sifts down every
+// inner node from the last one up and builds the heap in O(n), then moves
+// the maximum behind the heap n - 1 times
+template <typename View, typename Sift>
+void heapSortWith(View& a, Sift sift) {
+    const SortIndex n = a.size();
+    for (SortIndex root = n / 2 - 1; root >= 0; --root) {
+        sift(a, root, n);
+    }
+    for (SortIndex end = n - 1; end > 0; --end) {
+        a.swap(0, end);
+        sift(a, 0, end);
+    }
+}
+
+template <typename View>
+void heapSort(View& a) {
+    heapSortWith(a, [](View& view, SortIndex root, SortIndex end) { siftDown(view, root, end); });
+}
+
+template <typename View>
+void bottomUpHeapSort(View& a) {
+    heapSortWith(a, [](View& view, SortIndex root, SortIndex end) { siftDownBottomUp(view, root, end); });
+}
+
+// Heap sort of [begin, end) alone, as a fallback for other sorts
+template <typename View>
+void heapSortRange(View& a, SortIndex begin, SortIndex end) {
+    const SortIndex n = end - begin;
+    for (SortIndex root = n / 2 - 1; root >= 0; --root) {
+        siftDown(a, root, n, begin);
+    }
+    for (SortIndex last = n - 1; last > 0; --last) {
+        a.swap(begin, begin + last);
+        siftDown(a, 0, last, begin);
+    }
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/kernels/SortingNetwork.hpp"
+
+namespace kernels {
+
+// Passes a bottom-up merge sort of n elements makes, one per run width
+inline int mergePassCount(SortIndex n) {
+    int passes = 0;
+    for (SortIndex width = 1; width < n; width *= 2) {
+        passes++;
+    }
+    return passes;
+}
+
+// Whether the next element of a merge comes from the right run. Ties take
+// the left one, which keeps the sort stable.
+template <typename View>
+bool mergeTakesRight(View& a, bool fromAux, SortIndex left, SortIndex mid, SortIndex right, SortIndex end) {
+    if (left >= mid) return true;
+    if (right >= end) return false;
+    return fromAux ? a.auxLess(right, left) : a.less(right, left);
+}
+
+// Moves one element across to the other buffer
+template <typename View>
+void mergeMove(View& a, bool toAux, SortIndex to, SortIndex from) {
+    if (toAux) {
+        a.auxWrite(to, a.read(from));
+    } else {
+        a.write(to, a.auxRead(from));
+    }
+}
+
+// Merge passes from runs of width up, ping-ponging between the array and
+// an aux buffer of the same size: each pass merges runs of one width from
+// one buffer into runs of twice the width in the other, so nothing is
+// copied back. The first pass writes the aux buffer, so the last one lands
+// in the array when there is an even number of them.
+template <typename View>
+void mergePasses(View& a, SortIndex width) {
+    const SortIndex n = a.size();
+    for (bool toAux = true; width < n; width *= 2, toAux = !toAux) {
+        for (SortIndex begin = 0; begin < n; begin += 2 * width) {
+            const SortIndex mid = std::min(begin + width, n);
+            const SortIndex end = std::min(begin + 2 * width, n);
+            SortIndex left = begin;
+            SortIndex right = mid;
+            for (SortIndex out = begin; out < end; ++out) {
+                if (mergeTakesRight(a, !toAux, left, mid, right, end)) {
+                    mergeMove(a, toAux, out, right++);
+                } else {
+                    mergeMove(a, toAux, out, left++);
+                }
+            }
+        }
+    }
+}
+
+// Bottom-up merge sort. With an odd number of passes the first one sorts
+// pairs in place instead, so the last pass always lands in the array.
+template <typename View>
+void mergeSort(View& a) {
+    const SortIndex n = a.size();
+
+    SortIndex width = 1;
+    if (mergePassCount(n) % 2 == 1) {
+        for (SortIndex i = 0; i + 1 < n; i += 2) {
+            if (a.less(i + 1, i)) {
+                a.swap(i, i + 1);
+            }
+        }
+        width = 2;
+    }
+    mergePasses(a, width);
+}
+
+// Run width networkMergeSort starts merging from: leaf, halved when that
+// makes the number of passes even so the last one lands in the array
+inline SortIndex networkMergeLeaf(SortIndex n, SortIndex leaf) {
+    return mergePassCount((n + leaf - 1) / leaf) % 2 == 1 ? leaf / 2 : leaf;
+}
+
+// Merge sort on runs of up to leaf keys, 2 to kNetworkMaxSize, sorted in
+// place by the smallest known network for their size. A network saves the
+// merge passes over the smallest runs, whose branches go either way at
+// random, but can reorder equal keys, so this sort is not stable.
+template <typename View>
+void networkMergeSort(View& a, SortIndex leaf) {
+    const SortIndex n = a.size();
+    leaf = networkMergeLeaf(n, leaf);
+    for (SortIndex begin = 0; begin < n; begin += leaf) {
+        smallestNetworkSort(a, begin, std::min(begin + leaf, n));
+    }
+    mergePasses(a, leaf);
+}
+
+}
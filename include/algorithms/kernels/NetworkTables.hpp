@@ -0,0 +1,183 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// Largest network the sorts finish small ranges with: 32 keys, two AVX-512
+// or four AVX2 registers of 32-bit keys
+constexpr SortIndex kNetworkMaxSize = 32;
+
+struct NetworkComparator {
+    uint8_t low;        // wire that gets the smaller key
+    uint8_t high;
+};
+
+// The smallest known sorting networks, from Knuth's TAOCP 5.3.4 and the
+// later searches that settled the sizes up to 12. Each is listed layer by
+// layer; the 16-key one is Green's 60 comparators, and the 15-key one is
+// Green's without its top wire.
+namespace tables {
+    constexpr NetworkComparator kSize2[] = {{0, 1}};
+    constexpr NetworkComparator kSize3[] = {{0, 2}, {0, 1}, {1, 2}};
+    constexpr NetworkComparator kSize4[] = {{0, 2}, {1, 3}, {0, 1}, {2, 3}, {1, 2}};
+    constexpr NetworkComparator kSize5[] = {
+        {0, 3}, {1, 4}, {0, 2}, {1, 3}, {0, 1}, {2, 4}, {1, 2}, {3, 4}, {2, 3}
+    };
+    constexpr NetworkComparator kSize6[] = {
+        {0, 5}, {1, 3}, {2, 4}, {1, 2}, {3, 4}, {0, 3}, {2, 5}, {0, 1}, {2, 3}, {4, 5}, {1, 2}, {3, 4}
+    };
+    constexpr NetworkComparator kSize7[] = {
+        {0, 6}, {2, 3}, {4, 5}, {0, 2}, {1, 4}, {3, 6}, {0, 1}, {2, 5}, {3, 4}, {1, 2}, {4, 6}, {2, 3}, {4, 5},
+        {1, 2}, {3, 4}, {5, 6}
+    };
+    constexpr NetworkComparator kSize8[] = {
+        {0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {0, 1}, {2, 3}, {4, 5}, {6, 7},
+        {2, 4}, {3, 5}, {1, 4}, {3, 6}, {1, 2}, {3, 4}, {5, 6}
+    };
+    constexpr NetworkComparator kSize9[] = {
+        {0, 3}, {1, 7}, {2, 5}, {4, 8}, {0, 7}, {2, 4}, {3, 8}, {5, 6}, {0, 2}, {1, 3}, {4, 5}, {7, 8},
+        {1, 4}, {3, 6}, {5, 7}, {0, 1}, {2, 4}, {3, 5}, {6, 8}, {2, 3}, {4, 5}, {6, 7}, {1, 2}, {3, 4},
+        {5, 6}
+    };
+    constexpr NetworkComparator kSize10[] = {
+        {0, 8}, {1, 9}, {2, 7}, {3, 5}, {4, 6}, {0, 2}, {1, 4}, {5, 8}, {7, 9}, {0, 3}, {2, 4}, {5, 7},
+        {6, 9}, {0, 1}, {3, 6}, {8, 9}, {1, 5}, {2, 3}, {4, 8}, {6, 7}, {1, 2}, {3, 5}, {4, 6}, {7, 8},
+        {2, 3}, {4, 5}, {6, 7}, {3, 4}, {5, 6}
+    };
+    constexpr NetworkComparator kSize11[] = {
+        {0, 9}, {1, 6}, {2, 4}, {3, 7}, {5, 8}, {0, 1}, {3, 5}, {4, 10}, {6, 9}, {7, 8}, {1, 3}, {2, 5},
+        {4, 7}, {8, 10}, {0, 4}, {1, 2}, {3, 7}, {5, 9}, {6, 8}, {0, 1}, {2, 6}, {4, 5}, {7, 8}, {9, 10},
+        {2, 4}, {3, 6}, {5, 7}, {8, 9}, {1, 2}, {3, 4}, {5, 6}, {7, 8}, {2, 3}, {4, 5}, {6, 7}
+    };
+    constexpr NetworkComparator kSize12[] = {
+        {0, 8}, {1, 7}, {2, 6}, {3, 11}, {4, 10}, {5, 9}, {0, 1}, {2, 5}, {3, 4}, {6, 9}, {7, 8}, {10, 11},
+        {0, 2}, {1, 6}, {5, 10}, {9, 11}, {0, 3}, {1, 2}, {4, 6}, {5, 7}, {8, 11}, {9, 10}, {1, 4}, {3, 5},
+        {6, 8}, {7, 10}, {1, 3}, {2, 5}, {6, 9}, {8, 10}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {4, 6}, {5, 7},
+        {3, 4}, {5, 6}, {7, 8}
+    };
+    constexpr NetworkComparator kSize13[] = {
+        {0, 12}, {1, 10}, {2, 9}, {3, 7}, {5, 11}, {6, 8}, {1, 6}, {2, 3}, {4, 11}, {7, 9}, {8, 10},
+        {0, 4}, {1, 2}, {3, 6}, {7, 8}, {9, 10}, {11, 12}, {4, 6}, {5, 9}, {8, 11}, {10, 12}, {0, 5},
+        {3, 8}, {4, 7}, {6, 11}, {9, 10}, {0, 1}, {2, 5}, {6, 9}, {7, 8}, {10, 11}, {1, 3}, {2, 4},
+        {5, 6}, {9, 10}, {1, 2}, {3, 4}, {5, 7}, {6, 8}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {3, 4}, {5, 6}
+    };
+    constexpr NetworkComparator kSize14[] = {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {0, 2}, {1, 3}, {4, 8}, {5, 9},
+        {10, 12}, {11, 13}, {0, 4}, {1, 2}, {3, 7}, {5, 8}, {6, 10}, {9, 13}, {11, 12}, {0, 6}, {1, 5},
+        {3, 9}, {4, 10}, {7, 13}, {8, 12}, {2, 10}, {3, 11}, {4, 6}, {7, 9}, {1, 3}, {2, 8}, {5, 11},
+        {6, 7}, {10, 12}, {1, 4}, {2, 6}, {3, 5}, {7, 11}, {8, 10}, {9, 12}, {2, 4}, {3, 6}, {5, 8},
+        {7, 10}, {9, 11}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {6, 7}
+    };
+    constexpr NetworkComparator kSize15[] = {
+        {0, 13}, {1, 12}, {3, 14}, {4, 8}, {5, 6}, {7, 11}, {9, 10}, {0, 5}, {1, 7}, {2, 9}, {3, 4},
+        {6, 13}, {8, 14}, {11, 12}, {0, 1}, {2, 3}, {4, 5}, {6, 8}, {7, 9}, {10, 11}, {12, 13}, {0, 2},
+        {1, 3}, {4, 10}, {5, 11}, {6, 7}, {8, 9}, {12, 14}, {1, 2}, {3, 12}, {4, 6}, {5, 7}, {8, 10},
+        {9, 11}, {13, 14}, {1, 4}, {2, 6}, {5, 8}, {7, 10}, {9, 13}, {11, 14}, {2, 4}, {3, 6}, {9, 12},
+        {11, 13}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 12}, {6, 7},
+        {8, 9}
+    };
+    constexpr NetworkComparator kSize16[] = {
+        {0, 13}, {1, 12}, {2, 15}, {3, 14}, {4, 8}, {5, 6}, {7, 11}, {9, 10}, {0, 5}, {1, 7}, {2, 9},
+        {3, 4}, {6, 13}, {8, 14}, {10, 15}, {11, 12}, {0, 1}, {2, 3}, {4, 5}, {6, 8}, {7, 9}, {10, 11},
+        {12, 13}, {14, 15}, {0, 2}, {1, 3}, {4, 10}, {5, 11}, {6, 7}, {8, 9}, {12, 14}, {13, 15}, {1, 2},
+        {3, 12}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {13, 14}, {1, 4}, {2, 6}, {5, 8}, {7, 10}, {9, 13},
+        {11, 14}, {2, 4}, {3, 6}, {9, 12}, {11, 13}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {3, 4}, {5, 6},
+        {7, 8}, {9, 10}, {11, 12}, {6, 7}, {8, 9}
+    };
+
+    // The comparators of a network, reachable from a constant expression
+    struct KnownNetwork {
+        const NetworkComparator* comparators;
+        size_t count;
+    };
+
+    template <size_t Count>
+    constexpr KnownNetwork known(const NetworkComparator (&comparators)[Count]) {
+        return {comparators, Count};
+    }
+
+    constexpr KnownNetwork kKnown[] = {
+        {nullptr, 0}, {nullptr, 0}, known(kSize2), known(kSize3), known(kSize4), known(kSize5), known(kSize6),
+        known(kSize7), known(kSize8), known(kSize9), known(kSize10), known(kSize11), known(kSize12),
+        known(kSize13), known(kSize14), known(kSize15), known(kSize16)
+    };
+    constexpr SortIndex kKnownMaxSize = 16;
+}
+
+// Comparators of the 32-key network, the largest
+constexpr size_t kNetworkMaxComparators = 185;
+
+// A network as a flat comparator list, built at compile time
+struct NetworkTable {
+    SortIndex size = 0;
+    size_t count = 0;
+    NetworkComparator comparators[kNetworkMaxComparators] = {};
+
+    constexpr void add(SortIndex low, SortIndex high) {
+        comparators[count++] = {static_cast<uint8_t>(low), static_cast<uint8_t>(high)};
+    }
+};
+
+// Batcher's odd-even merge of the sorted halves of [begin, begin + length)
+// on wires spaced stride apart, leaving out comparators that reach wire
+// size or beyond. Wires past the keys hold padding larger than any key,
+// which such a comparator would leave where it is.
+constexpr void addOddEvenMerge(NetworkTable& table, SortIndex begin, SortIndex length, SortIndex stride) {
+    const SortIndex step = 2 * stride;
+    if (step < length) {
+        addOddEvenMerge(table, begin, length, step);
+        addOddEvenMerge(table, begin + stride, length, step);
+        for (SortIndex i = begin + stride; i + stride < begin + length; i += step) {
+            if (i + stride < table.size) table.add(i, i + stride);
+        }
+    } else if (begin + stride < table.size) {
+        table.add(begin, begin + stride);
+    }
+}
+
+// Up to 16 keys, the smallest known network. Above that, the 16-key one
+// and the one for the rest sort the two halves, and an odd-even merge of
+// 32 wires with the padding left out joins them. At 31 and 32 keys that is
+// as small as any known; from 17 to 30 it takes 1 to 11 comparators more
+// than the best found by search.
+constexpr NetworkTable makeNetworkTable(SortIndex size) {
+    NetworkTable table;
+    table.size = size;
+    if (size <= tables::kKnownMaxSize) {
+        const tables::KnownNetwork& known = tables::kKnown[size];
+        for (size_t c = 0; c < known.count; ++c) table.add(known.comparators[c].low, known.comparators[c].high);
+        return table;
+    }
+
+    const SortIndex half = tables::kKnownMaxSize;
+    const tables::KnownNetwork& low = tables::kKnown[half];
+    const tables::KnownNetwork& high = tables::kKnown[size - half];
+    for (size_t c = 0; c < low.count; ++c) table.add(low.comparators[c].low, low.comparators[c].high);
+    for (size_t c = 0; c < high.count; ++c) {
+        table.add(half + high.comparators[c].low, half + high.comparators[c].high);
+    }
+    addOddEvenMerge(table, 0, 2 * half, 1);
+    return table;
+}
+
+struct NetworkTables {
+    NetworkTable networks[kNetworkMaxSize + 1] = {};
+
+    constexpr NetworkTables() {
+        for (SortIndex size = 0; size <= kNetworkMaxSize; ++size) networks[size] = makeNetworkTable(size);
+    }
+};
+
+// Every size's network, computed by the compiler
+inline constexpr NetworkTables kNetworkTables;
+
+constexpr const NetworkTable& networkTable(SortIndex size) {
+    return kNetworkTables.networks[size];
+}
+
+static_assert(networkTable(16).count == 60, "Green's network has 60 comparators");
+static_assert(networkTable(kNetworkMaxSize).count == kNetworkMaxComparators, "the table holds the 32-key network");
+
+}
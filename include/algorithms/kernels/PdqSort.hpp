@@ -0,0 +1,190 @@
+#pragma once
+#include <utility>
+#include "algorithms/PartitionStack.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/kernels/HeapSort.hpp"
+
+namespace kernels {
+
+// Ranges below the first size are insertion sorted; above the second, the
+// pivot is Tukey's ninther rather than a median of three
+constexpr SortIndex kPdqInsertionThreshold = 24;
+constexpr SortIndex kPdqNintherThreshold = 128;
+// Moves after which a partial insertion sort gives up on a range
+constexpr OpCount kPdqPartialInsertionLimit = 8;
+
+// Bad partitions a sort of n elements takes before falling back to heap
+// sort: log2(n), which keeps the worst case at O(n log n)
+inline int pdqBadPartitionBudget(SortIndex n) {
+    int budget = 0;
+    for (; n > 1; n /= 2) budget++;
+    return budget;
+}
+
+// A partition is bad if it leaves less than an eighth of the range on one side
+inline bool pdqIsBadPartition(SortIndex begin, SortIndex pivot, SortIndex end) {
+    const SortIndex size = end - begin;
+    return pivot - begin < size / 8 || end - (pivot + 1) < size / 8;
+}
+
+// The pivot is chosen by compare-exchanges of pairs: three sorting a median
+// of three into place at begin, or twelve sorting the four triples of a
+// ninther, whose median then ends up at begin + size / 2
+inline int pdqPivotPairCount(SortIndex size) {
+    return size > kPdqNintherThreshold ? 12 : 3;
+}
+
+inline std::pair<SortIndex, SortIndex> pdqPivotPair(SortIndex begin, SortIndex end, int k) {
+    const SortIndex mid = begin + (end - begin) / 2;
+    const SortIndex triples[4][3] = {
+        {begin, mid, end - 1},
+        {begin + 1, mid - 1, end - 2},
+        {begin + 2, mid + 1, end - 3},
+        {mid - 1, mid, mid + 1}
+    };
+    const SortIndex medianOfThree[3] = {mid, begin, end - 1};
+    const SortIndex* triple = end - begin > kPdqNintherThreshold ? triples[k / 3] : medianOfThree;
+
+    // Three compare-exchanges sort a triple
+    static const int order[3][2] = {{0, 1}, {1, 2}, {0, 1}};
+    return {triple[order[k % 3][0]], triple[order[k % 3][1]]};
+}
+
+template <typename View>
+void pdqSort2(View& a, SortIndex i, SortIndex j) {
+    if (a.less(j, i)) a.swap(i, j);
+}
+
+// Moves the median of three or ninther of [begin, end) to begin
+template <typename View>
+void pdqChoosePivot(View& a, SortIndex begin, SortIndex end) {
+    const SortIndex size = end - begin;
+    for (int k = 0; k < pdqPivotPairCount(size); ++k) {
+        const std::pair<SortIndex, SortIndex> pair = pdqPivotPair(begin, end, k);
+        pdqSort2(a, pair.first, pair.second);
+    }
+    if (size > kPdqNintherThreshold) a.swap(begin, begin + size / 2);
+}
+
+// One compare of an insertion sort, swapping element j down past its
+// neighbour if it belongs before it; false once it is in place
+template <typename View>
+bool insertionStep(View& a, SortIndex j) {
+    if (!a.less(j, j - 1)) return false;
+    a.swap(j - 1, j);
+    return true;
+}
+
+// Insertion sort of [begin, end) that gives up, returning false, once it
+// has made more than limit moves
+template <typename View>
+bool pdqInsertionSort(View& a, SortIndex begin, SortIndex end, OpCount limit) {
+    OpCount moves = 0;
+    for (SortIndex i = begin + 1; i < end; ++i) {
+        for (SortIndex j = i; j > begin && insertionStep(a, j); --j) {
+            moves++;
+        }
+        if (moves > limit) return false;
+    }
+    return true;
+}
+
+struct PdqPartition {
+    SortIndex pivot;
+    bool alreadyPartitioned;    // no element had to be swapped
+};
+
+// Partitions [begin, end) around the pivot at begin, equal elements going
+// right. The pivot selection leaves an element no smaller than the pivot
+// after it and the scans stop at elements on the wrong side, so the inner
+// loops need no bounds checks.
+template <typename View>
+PdqPartition pdqPartitionRight(View& a, SortIndex begin, SortIndex end) {
+    SortIndex first = begin;
+    SortIndex last = end;
+    while (a.less(++first, begin)) {}
+    if (first - 1 == begin) {
+        while (first < last && !a.less(--last, begin)) {}
+    } else {
+        while (!a.less(--last, begin)) {}
+    }
+
+    const bool alreadyPartitioned = first >= last;
+    while (first < last) {
+        a.swap(first, last);
+        while (a.less(++first, begin)) {}
+        while (!a.less(--last, begin)) {}
+    }
+
+    const SortIndex pivot = first - 1;
+    if (pivot != begin) a.swap(begin, pivot);
+    return PdqPartition{pivot, alreadyPartitioned};
+}
+
+// After a bad partition, swaps a few elements on each side into new places
+// so the pattern that caused it does not repeat
+template <typename View>
+void pdqBreakPatterns(View& a, SortIndex begin, SortIndex pivot, SortIndex end) {
+    const SortIndex leftSize = pivot - begin;
+    const SortIndex rightSize = end - (pivot + 1);
+    if (leftSize >= kPdqInsertionThreshold) {
+        a.swap(begin, begin + leftSize / 4);
+        a.swap(pivot - 1, pivot - leftSize / 4);
+        if (leftSize > kPdqNintherThreshold) {
+            a.swap(begin + 1, begin + (leftSize / 4 + 1));
+            a.swap(begin + 2, begin + (leftSize / 4 + 2));
+            a.swap(pivot - 2, pivot - (leftSize / 4 + 1));
+            a.swap(pivot - 3, pivot - (leftSize / 4 + 2));
+        }
+    }
+    if (rightSize >= kPdqInsertionThreshold) {
+        a.swap(pivot + 1, pivot + (1 + rightSize / 4));
+        a.swap(end - 1, end - rightSize / 4);
+        if (rightSize > kPdqNintherThreshold) {
+            a.swap(pivot + 2, pivot + (2 + rightSize / 4));
+            a.swap(pivot + 3, pivot + (3 + rightSize / 4));
+            a.swap(end - 2, end - (1 + rightSize / 4));
+            a.swap(end - 3, end - (2 + rightSize / 4));
+        }
+    }
+}
+
+// Pattern-defeating quicksort (Peters): median-of-three or ninther pivots,
+// insertion sort for small ranges, and a partial insertion sort of both
+// sides when a partition swapped nothing, which finishes sorted and nearly
+// sorted input in linear time. Bad partitions shuffle a few elements, and
+// after log2(n) of them the range is heap sorted instead.
+template <typename View>
+void pdqSort(View& a) {
+    if (a.size() < 2) return;
+
+    PartitionStack pending;
+    pending.push(0, a.size() - 1, pdqBadPartitionBudget(a.size()));
+    while (!pending.empty()) {
+        PartitionStack::Range range = pending.pop();
+        const SortIndex begin = range.left;
+        const SortIndex end = range.right + 1;
+        const SortIndex size = end - begin;
+        if (size < kPdqInsertionThreshold) {
+            pdqInsertionSort(a, begin, end, UINT64_MAX);
+            continue;
+        }
+
+        pdqChoosePivot(a, begin, end);
+        const PdqPartition partition = pdqPartitionRight(a, begin, end);
+        if (pdqIsBadPartition(begin, partition.pivot, end)) {
+            if (--range.budget == 0) {
+                heapSortRange(a, begin, end);
+                continue;
+            }
+            pdqBreakPatterns(a, begin, partition.pivot, end);
+        } else if (partition.alreadyPartitioned &&
+                   pdqInsertionSort(a, begin, partition.pivot, kPdqPartialInsertionLimit) &&
+                   pdqInsertionSort(a, partition.pivot + 1, end, kPdqPartialInsertionLimit)) {
+            continue;
+        }
+        pending.pushChildren(range, partition.pivot);
+    }
+}
+
+}
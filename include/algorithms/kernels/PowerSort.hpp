@@ -0,0 +1,474 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// Consecutive wins by one run after which a merge starts galloping, as in
+// Timsort. The threshold a sort actually uses drifts from there: down while
+// galloping pays off, up each time it stops paying.
+constexpr SortIndex kPowerMinGallop = 7;
+
+// Powers on the run stack strictly increase from the bottom and are at most
+// 64 for 64-bit sizes, so this many runs are ever pending
+constexpr size_t kPowerMaxRuns = 66;
+
+// Shortest run Powersort lets stand, extending shorter ones by binary
+// insertion: n itself below 64, otherwise between 32 and 64 such that
+// n / minRun is a power of two or just under one, as in Timsort
+inline SortIndex powerMinRun(SortIndex n) {
+    SortIndex carry = 0;
+    while (n >= 64) {
+        carry |= n & 1;
+        n >>= 1;
+    }
+    return n + carry;
+}
+
+// Power of the boundary between the adjacent runs of n1 keys from begin
+// and of n2 keys after it, in a sort of n keys: the depth of the node
+// between their midpoints in the perfectly balanced merge tree over
+// [0, n), found bit by bit from the midpoints' binary fractions of n
+inline int powerNodePower(SortIndex begin, SortIndex n1, SortIndex n2, SortIndex n) {
+    SortIndex a = 2 * begin + n1;
+    SortIndex b = a + n1 + n2;
+    int power = 0;
+    for (;;) {
+        ++power;
+        if (a >= n) {
+            a -= n;
+            b -= n;
+        } else if (b >= n) {
+            break;
+        }
+        a <<= 1;
+        b <<= 1;
+    }
+    return power;
+}
+
+// Length of the prefix of [0, length) on which holds is true, for a holds
+// that is true on a prefix: probes 0, 1, 3, 7... then searches the last gap
+// in binary, so a prefix of k costs O(log k) compares rather than k
+template <typename Holds>
+SortIndex gallopPrefix(SortIndex length, Holds holds) {
+    SortIndex low = 0;
+    SortIndex probe = 0;
+    for (SortIndex stride = 1; probe < length && holds(probe); stride *= 2) {
+        low = probe + 1;
+        probe += stride;
+    }
+    SortIndex high = std::min(probe, length);
+    while (low < high) {
+        const SortIndex mid = low + (high - low) / 2;
+        if (holds(mid)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Moves the key at i into the sorted [begin, i), after any equal keys
+template <typename View>
+void powerInsert(View& a, SortIndex begin, SortIndex i) {
+    SortIndex low = begin;
+    SortIndex high = i;
+    while (low < high) {
+        const SortIndex mid = low + (high - low) / 2;
+        if (a.less(i, mid)) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    if (low == i) return;
+    const typename View::KeyType carry = a.read(i);
+    for (SortIndex k = i; k > low; --k) {
+        a.write(k, a.read(k - 1));
+    }
+    a.write(low, carry);
+}
+
+// A pending run, with the power of its boundary with the run above
+struct PowerRun {
+    SortIndex begin;
+    SortIndex end;
+    int power;
+};
+
+// A Powersort in progress. Merges stop and resume at every gallop, so
+// rather than a loop the sort is this state and powerSortStep, which the
+// native kernel and the visualizer's steps both drive.
+//
+// A merge of [mergeBegin, mergeMid) and [mergeMid, mergeEnd) first trims
+// the keys already in place off both ends, then copies the shorter run to
+// the aux buffer. A low merge (the left run in aux) fills the range from
+// the front, a high one from the back; aux, array and out are the next aux
+// key, the next key of the run left in the array, and the next slot.
+struct PowerSort {
+    enum class Phase : uint8_t {
+        SCHEDULE,       // bookkeeping: push the run found, merge or finish
+        FIND_RUN,
+        EXTEND_RUN,
+        REVERSE_RUN,
+        INSERT,         // binary insertion up to minRun keys
+        TRIM_LEFT,
+        TRIM_RIGHT,
+        COPY_RUN,
+        MERGE,          // one compare and one move
+        GALLOP_AUX,     // how many aux keys go next
+        MOVE_AUX,
+        GALLOP_ARRAY,
+        MOVE_ARRAY,
+        END_MERGE,
+        DONE
+    };
+
+    Phase phase = Phase::DONE;
+    SortIndex n = 0;
+    SortIndex minRun = 0;
+    SortIndex minGallop = kPowerMinGallop;
+    std::array<PowerRun, kPowerMaxRuns> runs = {};
+    size_t runCount = 0;
+    SortIndex runsFound = 0;
+
+    // Run being found, and the power of its boundary with the top run
+    SortIndex runBegin = 0;
+    SortIndex runEnd = 0;
+    bool descending = false;
+    bool pushing = false;
+    int power = 0;
+    SortIndex reverseLow = 0;
+    SortIndex reverseHigh = 0;
+
+    SortIndex mergeBegin = 0;
+    SortIndex mergeMid = 0;
+    SortIndex mergeEnd = 0;
+    bool high = false;
+    SortIndex auxCount = 0;
+    SortIndex aux = 0;
+    SortIndex array = 0;
+    SortIndex out = 0;
+    SortIndex auxWins = 0;
+    SortIndex arrayWins = 0;
+    SortIndex pending = 0;          // keys left to move in bulk
+    SortIndex gallopedAux = 0;
+    SortIndex gallopedArray = 0;
+};
+
+inline void powerSortBegin(PowerSort& s, SortIndex n) {
+    s = PowerSort();
+    s.n = n;
+    s.minRun = powerMinRun(n);
+    s.phase = PowerSort::Phase::SCHEDULE;
+}
+
+inline SortIndex powerAuxLeft(const PowerSort& s) {
+    return s.high ? s.aux + 1 : s.auxCount - s.aux;
+}
+
+inline SortIndex powerArrayLeft(const PowerSort& s) {
+    return s.high ? s.array - s.mergeBegin + 1 : s.mergeEnd - s.array;
+}
+
+// Ends the merge once the aux run is used up, or moves the rest of it once
+// the array run is; the keys of whichever is left are then in place
+inline bool powerMergeOver(PowerSort& s) {
+    if (powerAuxLeft(s) == 0) {
+        s.phase = PowerSort::Phase::END_MERGE;
+        return true;
+    }
+    if (powerArrayLeft(s) == 0) {
+        s.pending = powerAuxLeft(s);
+        s.phase = PowerSort::Phase::MOVE_AUX;
+        return true;
+    }
+    return false;
+}
+
+template <typename View>
+void powerMoveAux(View& a, PowerSort& s) {
+    if (s.high) {
+        a.write(s.out--, a.auxRead(s.aux--));
+    } else {
+        a.write(s.out++, a.auxRead(s.aux++));
+    }
+}
+
+template <typename View>
+void powerMoveArray(View& a, PowerSort& s) {
+    if (s.high) {
+        a.write(s.out--, a.read(s.array--));
+    } else {
+        a.write(s.out++, a.read(s.array++));
+    }
+}
+
+// Whether the array run's key goes next, strictly ahead of the aux one so
+// that equal keys keep their order. A low merge takes keys smallest first
+// and a high one largest first.
+template <typename View>
+bool powerArrayGoesNext(View& a, const PowerSort& s, SortIndex aux, SortIndex array) {
+    return s.high ? a.auxLessArray(aux, array) : a.arrayLessAux(array, aux);
+}
+
+// MERGE steps back to back, as the native sort runs them: the same
+// compares and moves until a run wins minGallop in a row or one runs out,
+// with the cursors in locals rather than the state. Does nothing if a run
+// is already out, which the next step then finds.
+template <typename View>
+void powerMergeLoop(View& a, PowerSort& s) {
+    SortIndex aux = s.aux;
+    SortIndex array = s.array;
+    SortIndex out = s.out;
+    SortIndex auxWins = s.auxWins;
+    SortIndex arrayWins = s.arrayWins;
+    if (s.high) {
+        while (aux >= 0 && array >= s.mergeBegin && std::max(auxWins, arrayWins) < s.minGallop) {
+            if (a.auxLessArray(aux, array)) {
+                a.write(out--, a.read(array--));
+                arrayWins++;
+                auxWins = 0;
+            } else {
+                a.write(out--, a.auxRead(aux--));
+                auxWins++;
+                arrayWins = 0;
+            }
+        }
+    } else {
+        while (aux < s.auxCount && array < s.mergeEnd && std::max(auxWins, arrayWins) < s.minGallop) {
+            if (a.arrayLessAux(array, aux)) {
+                a.write(out++, a.read(array++));
+                arrayWins++;
+                auxWins = 0;
+            } else {
+                a.write(out++, a.auxRead(aux++));
+                auxWins++;
+                arrayWins = 0;
+            }
+        }
+    }
+    s.aux = aux;
+    s.array = array;
+    s.out = out;
+    s.auxWins = auxWins;
+    s.arrayWins = arrayWins;
+    if (std::max(auxWins, arrayWins) >= s.minGallop) {
+        s.minGallop++;
+        s.phase = PowerSort::Phase::GALLOP_AUX;
+    }
+}
+
+// Does one step of the sort: a compare, a move or a gallop search, along
+// with any bookkeeping up to it. Returns false, without a step, once the
+// keys are sorted.
+template <typename View>
+bool powerSortStep(View& a, PowerSort& s) {
+    using Phase = PowerSort::Phase;
+    for (;;) {
+        switch (s.phase) {
+            case Phase::SCHEDULE: {
+                // A found run is pushed once every pending boundary deeper
+                // in the merge tree than its own is merged
+                const bool mergeTop = s.runCount >= 2 &&
+                    (s.pushing ? s.runs[s.runCount - 2].power > s.power : s.runEnd == s.n);
+                if (mergeTop) {
+                    s.mergeBegin = s.runs[s.runCount - 2].begin;
+                    s.mergeMid = s.runs[s.runCount - 1].begin;
+                    s.mergeEnd = s.runs[s.runCount - 1].end;
+                    s.phase = Phase::TRIM_LEFT;
+                    continue;
+                }
+                if (s.pushing) {
+                    if (s.runCount > 0) s.runs[s.runCount - 1].power = s.power;
+                    s.runs[s.runCount++] = PowerRun{s.runBegin, s.runEnd, 0};
+                    s.pushing = false;
+                    continue;
+                }
+                if (s.runEnd < s.n) {
+                    s.phase = Phase::FIND_RUN;
+                    continue;
+                }
+                s.phase = Phase::DONE;
+                return false;
+            }
+
+            case Phase::FIND_RUN:
+                s.runBegin = s.runEnd;
+                s.runEnd = s.runBegin + 1;
+                s.runsFound++;
+                if (s.runEnd == s.n) {
+                    s.phase = Phase::INSERT;
+                    continue;
+                }
+                s.descending = a.less(s.runEnd, s.runBegin);
+                s.runEnd++;
+                s.phase = Phase::EXTEND_RUN;
+                return true;
+
+            // Runs are non-descending, or strictly descending so that
+            // reversing them keeps equal keys in order
+            case Phase::EXTEND_RUN:
+                if (s.runEnd < s.n) {
+                    const bool extends = s.descending ? a.less(s.runEnd, s.runEnd - 1) : !a.less(s.runEnd, s.runEnd - 1);
+                    if (extends) {
+                        s.runEnd++;
+                        return true;
+                    }
+                }
+                if (s.descending) {
+                    s.reverseLow = s.runBegin;
+                    s.reverseHigh = s.runEnd - 1;
+                    s.phase = Phase::REVERSE_RUN;
+                } else {
+                    s.phase = Phase::INSERT;
+                }
+                if (s.runEnd < s.n) return true;
+                continue;
+
+            case Phase::REVERSE_RUN:
+                a.swap(s.reverseLow++, s.reverseHigh--);
+                if (s.reverseLow >= s.reverseHigh) s.phase = Phase::INSERT;
+                return true;
+
+            case Phase::INSERT:
+                if (s.runEnd < std::min(s.runBegin + s.minRun, s.n)) {
+                    powerInsert(a, s.runBegin, s.runEnd);
+                    s.runEnd++;
+                    return true;
+                }
+                if (s.runCount > 0) {
+                    const PowerRun& top = s.runs[s.runCount - 1];
+                    s.power = powerNodePower(top.begin, top.end - top.begin, s.runEnd - s.runBegin, s.n);
+                }
+                s.pushing = true;
+                s.phase = Phase::SCHEDULE;
+                continue;
+
+            // Left keys no greater than the right run's first are in place
+            case Phase::TRIM_LEFT:
+                s.mergeBegin += gallopPrefix(s.mergeMid - s.mergeBegin,
+                    [&a, &s](SortIndex k) { return !a.less(s.mergeMid, s.mergeBegin + k); });
+                s.phase = s.mergeBegin == s.mergeMid ? Phase::END_MERGE : Phase::TRIM_RIGHT;
+                return true;
+
+            // And so are right keys no smaller than the left run's last
+            case Phase::TRIM_RIGHT:
+                s.mergeEnd -= gallopPrefix(s.mergeEnd - s.mergeMid,
+                    [&a, &s](SortIndex k) { return !a.less(s.mergeEnd - 1 - k, s.mergeMid - 1); });
+                s.high = s.mergeMid - s.mergeBegin > s.mergeEnd - s.mergeMid;
+                s.auxCount = s.high ? s.mergeEnd - s.mergeMid : s.mergeMid - s.mergeBegin;
+                s.aux = 0;
+                s.phase = Phase::COPY_RUN;
+                return true;
+
+            case Phase::COPY_RUN:
+                a.auxWrite(s.aux, a.read((s.high ? s.mergeMid : s.mergeBegin) + s.aux));
+                if (++s.aux == s.auxCount) {
+                    s.aux = s.high ? s.auxCount - 1 : 0;
+                    s.array = s.high ? s.mergeMid - 1 : s.mergeMid;
+                    s.out = s.high ? s.mergeEnd - 1 : s.mergeBegin;
+                    s.auxWins = 0;
+                    s.arrayWins = 0;
+                    s.phase = Phase::MERGE;
+                }
+                return true;
+
+            // One run winning minGallop times in a row switches to
+            // galloping, which stays on while either run keeps winning
+            // kPowerMinGallop or more at a time
+            case Phase::MERGE:
+                if (powerMergeOver(s)) continue;
+                if (powerArrayGoesNext(a, s, s.aux, s.array)) {
+                    powerMoveArray(a, s);
+                    s.arrayWins++;
+                    s.auxWins = 0;
+                } else {
+                    powerMoveAux(a, s);
+                    s.auxWins++;
+                    s.arrayWins = 0;
+                }
+                if (std::max(s.auxWins, s.arrayWins) >= s.minGallop) {
+                    s.minGallop++;
+                    s.phase = Phase::GALLOP_AUX;
+                }
+                return true;
+
+            case Phase::GALLOP_AUX:
+                if (powerMergeOver(s)) continue;
+                s.minGallop -= s.minGallop > 1;
+                s.gallopedAux = gallopPrefix(powerAuxLeft(s), [&a, &s](SortIndex k) {
+                    return !powerArrayGoesNext(a, s, s.high ? s.aux - k : s.aux + k, s.array);
+                });
+                s.pending = s.gallopedAux;
+                s.phase = Phase::MOVE_AUX;
+                return true;
+
+            case Phase::MOVE_AUX:
+                if (s.pending == 0) {
+                    if (!powerMergeOver(s)) s.phase = Phase::GALLOP_ARRAY;
+                    continue;
+                }
+                powerMoveAux(a, s);
+                s.pending--;
+                return true;
+
+            case Phase::GALLOP_ARRAY:
+                if (powerMergeOver(s)) continue;
+                s.gallopedArray = gallopPrefix(powerArrayLeft(s), [&a, &s](SortIndex k) {
+                    return powerArrayGoesNext(a, s, s.aux, s.high ? s.array - k : s.array + k);
+                });
+                s.pending = s.gallopedArray;
+                s.phase = Phase::MOVE_ARRAY;
+                return true;
+
+            case Phase::MOVE_ARRAY:
+                if (s.pending == 0) {
+                    if (powerMergeOver(s)) continue;
+                    if (s.gallopedAux < kPowerMinGallop && s.gallopedArray < kPowerMinGallop) {
+                        s.minGallop++;
+                        s.auxWins = 0;
+                        s.arrayWins = 0;
+                        s.phase = Phase::MERGE;
+                    } else {
+                        s.phase = Phase::GALLOP_AUX;
+                    }
+                    continue;
+                }
+                powerMoveArray(a, s);
+                s.pending--;
+                return true;
+
+            case Phase::END_MERGE:
+                s.runs[s.runCount - 2].end = s.runs[s.runCount - 1].end;
+                s.runCount--;
+                s.phase = Phase::SCHEDULE;
+                continue;
+
+            case Phase::DONE:
+                return false;
+        }
+    }
+}
+
+// Powersort (Munro and Wild): Timsort's natural runs, extended to minRun
+// keys, and galloping merges, merged in the order of a nearly optimal
+// merge tree over the runs rather than by Timsort's stack rules. Stable;
+// input that is already k runs takes O(n + n log k) compares, down to
+// n - 1 for sorted or strictly descending input. Needs an aux buffer of
+// n / 2 keys.
+template <typename View>
+void powerSort(View& a) {
+    PowerSort s;
+    powerSortBegin(s, a.size());
+    while (powerSortStep(a, s)) {
+        if (s.phase == PowerSort::Phase::MERGE) powerMergeLoop(a, s);
+    }
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "algorithms/PartitionStack.hpp"
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// Iterative quicksort with a Lomuto partition around the first element. Both
+// of Lomuto's indices scan, so it passes over about 3 n ln n elements.
+template <typename View>
+void quickSort(View& a) {
+    if (a.size() < 2) return;
+
+    PartitionStack pending;
+    pending.push(0, a.size() - 1);
+    while (!pending.empty()) {
+        const PartitionStack::Range range = pending.pop();
+
+        SortIndex partition = range.left;
+        for (SortIndex i = range.left + 1; i <= range.right; ++i) {
+            a.scan(i);
+            if (a.less(i, range.left)) {
+                a.scan(++partition);
+                if (partition != i) {
+                    a.swap(partition, i);
+                }
+            }
+        }
+        if (partition != range.left) {
+            a.swap(range.left, partition);
+        }
+
+        pending.pushChildren(range, partition);
+    }
+}
+
+}
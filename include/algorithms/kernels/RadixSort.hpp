@@ -0,0 +1,245 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "algorithms/SortTypes.hpp"
+
+namespace kernels {
+
+// Maps keys to unsigned integers that sort in the same order, which is all
+// the counting sorts look at. Signed integers get their sign bit flipped;
+// floats get it flipped too when positive and every bit flipped when
+// negative, so more negative values map lower.
+template <typename Key>
+struct RadixKey;
+
+template <>
+struct RadixKey<int32_t> {
+    static uint64_t of(int32_t key) { return static_cast<uint32_t>(key) ^ 0x80000000u; }
+};
+
+template <>
+struct RadixKey<uint32_t> {
+    static uint64_t of(uint32_t key) { return key; }
+};
+
+template <>
+struct RadixKey<int64_t> {
+    static uint64_t of(int64_t key) { return static_cast<uint64_t>(key) ^ (uint64_t(1) << 63); }
+};
+
+template <>
+struct RadixKey<uint64_t> {
+    static uint64_t of(uint64_t key) { return key; }
+};
+
+template <>
+struct RadixKey<float> {
+    static uint64_t of(float key) {
+        uint32_t bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return bits ^ (static_cast<uint32_t>(-static_cast<int32_t>(bits >> 31)) | 0x80000000u);
+    }
+};
+
+template <>
+struct RadixKey<double> {
+    static uint64_t of(double key) {
+        uint64_t bits;
+        std::memcpy(&bits, &key, sizeof(bits));
+        return bits ^ (static_cast<uint64_t>(-static_cast<int64_t>(bits >> 63)) | (uint64_t(1) << 63));
+    }
+};
+
+// Smallest and largest mapped key, read straight from the keys; 0 and 0
+// when there are none
+template <typename Key>
+void radixKeyRange(const Key* keys, size_t size, uint64_t& minKey, uint64_t& maxKey) {
+    minKey = size > 0 ? UINT64_MAX : 0;
+    maxKey = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const uint64_t key = RadixKey<Key>::of(keys[i]);
+        minKey = key < minKey ? key : minKey;
+        maxKey = key > maxKey ? key : maxKey;
+    }
+}
+
+// Whether counting sort's one bucket per key value stays within a few
+// buckets per key; wider ranges are better off with radix passes
+constexpr uint64_t kCountingRangePerKey = 4;
+constexpr uint64_t kCountingRangeSlack = 1 << 16;
+
+inline bool countingRangeFits(uint64_t minKey, uint64_t maxKey, size_t size) {
+    return maxKey - minKey <= kCountingRangePerKey * size + kCountingRangeSlack;
+}
+
+// Bucket [begin, end) of an MSD radix sort, still to be sorted on digit and
+// the ones below it
+struct RadixRange {
+    SortIndex begin;
+    SortIndex end;
+    unsigned digit;
+};
+
+// Buckets and per-pass traffic of a counting or radix sort. Kept by the
+// caller so that stepping through a sort reuses one allocation.
+struct RadixWorkspace {
+    unsigned digitBits = 0;
+    unsigned digitCount = 0;
+    std::vector<SortIndex> buckets;     // counts, then each bucket's next slot; digit after digit
+    std::vector<uint8_t> skipDigit;     // digits every key shares need no pass
+    std::vector<uint64_t> passBytes;    // bytes read and written by each pass over the data
+    std::vector<RadixRange> pending;    // MSD buckets still to sort, the next one last
+
+    SortIndex* digitBuckets(unsigned digit) { return buckets.data() + (size_t(digit) << digitBits); }
+};
+
+// Turns each digit's counts into the first slot of every bucket
+inline void radixPrefixSums(RadixWorkspace& workspace, SortIndex n) {
+    const size_t bucketCount = size_t(1) << workspace.digitBits;
+    for (unsigned digit = 0; digit < workspace.digitCount; ++digit) {
+        SortIndex* buckets = workspace.digitBuckets(digit);
+        SortIndex sum = 0;
+        workspace.skipDigit[digit] = 0;
+        for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+            if (buckets[bucket] == n) workspace.skipDigit[digit] = 1;
+            const SortIndex count = buckets[bucket];
+            buckets[bucket] = sum;
+            sum += count;
+        }
+    }
+}
+
+inline void countingBegin(RadixWorkspace& workspace, uint64_t minKey, uint64_t maxKey) {
+    workspace.digitBits = 0;
+    workspace.digitCount = 1;
+    workspace.buckets.assign(static_cast<size_t>(maxKey - minKey + 1), 0);
+    workspace.skipDigit.assign(1, 0);
+    workspace.passBytes.clear();
+}
+
+template <typename View>
+void countingCount(View& a, RadixWorkspace& workspace, uint64_t minKey, SortIndex i) {
+    using Key = typename View::KeyType;
+    const Key key = a.read(i);
+    a.auxWrite(i, key);
+    workspace.buckets[RadixKey<Key>::of(key) - minKey]++;
+}
+
+inline void countingPrefixSums(RadixWorkspace& workspace) {
+    SortIndex sum = 0;
+    for (SortIndex& bucket : workspace.buckets) {
+        const SortIndex count = bucket;
+        bucket = sum;
+        sum += count;
+    }
+}
+
+template <typename View>
+SortIndex countingScatter(View& a, RadixWorkspace& workspace, uint64_t minKey, SortIndex i) {
+    using Key = typename View::KeyType;
+    const Key key = a.auxRead(i);
+    const SortIndex slot = workspace.buckets[RadixKey<Key>::of(key) - minKey]++;
+    a.write(slot, key);
+    return slot;
+}
+
+// Counting sort over keys known to lie in [minKey, maxKey], as in a
+// permutation. The first pass counts each key while copying it to the aux
+// buffer, the second scatters the copies straight to their final slots.
+template <typename View>
+void countingSort(View& a, uint64_t minKey, uint64_t maxKey, RadixWorkspace& workspace) {
+    using Key = typename View::KeyType;
+    const SortIndex n = a.size();
+    countingBegin(workspace, minKey, maxKey);
+
+    workspace.passBytes.push_back(2 * n * sizeof(Key));
+    for (SortIndex i = 0; i < n; ++i) {
+        countingCount(a, workspace, minKey, i);
+    }
+    countingPrefixSums(workspace);
+
+    workspace.passBytes.push_back(2 * n * sizeof(Key));
+    for (SortIndex i = 0; i < n; ++i) {
+        countingScatter(a, workspace, minKey, i);
+    }
+}
+
+template <typename Key>
+unsigned radixDigitCount(unsigned digitBits) {
+    return static_cast<unsigned>((sizeof(Key) * 8 + digitBits - 1) / digitBits);
+}
+
+template <typename Key>
+void radixBegin(RadixWorkspace& workspace, unsigned digitBits) {
+    workspace.digitBits = digitBits;
+    workspace.digitCount = radixDigitCount<Key>(digitBits);
+    workspace.buckets.assign(size_t(workspace.digitCount) << digitBits, 0);
+    workspace.skipDigit.assign(workspace.digitCount, 0);
+    workspace.passBytes.clear();
+}
+
+template <typename View>
+void radixCount(View& a, RadixWorkspace& workspace, SortIndex i) {
+    using Key = typename View::KeyType;
+    const uint64_t key = RadixKey<Key>::of(a.read(i));
+    const uint64_t mask = (uint64_t(1) << workspace.digitBits) - 1;
+    for (unsigned digit = 0; digit < workspace.digitCount; ++digit) {
+        workspace.digitBuckets(digit)[(key >> (digit * workspace.digitBits)) & mask]++;
+    }
+}
+
+// Moves element i of the pass's source buffer into its bucket in the other
+// buffer and returns where it went
+template <typename View>
+SortIndex radixScatter(View& a, RadixWorkspace& workspace, unsigned digit, bool fromAux, SortIndex i) {
+    using Key = typename View::KeyType;
+    const Key key = fromAux ? a.auxRead(i) : a.read(i);
+    const uint64_t mask = (uint64_t(1) << workspace.digitBits) - 1;
+    const uint64_t bucket = (RadixKey<Key>::of(key) >> (digit * workspace.digitBits)) & mask;
+    const SortIndex slot = workspace.digitBuckets(digit)[bucket]++;
+    if (fromAux) {
+        a.write(slot, key);
+    } else {
+        a.auxWrite(slot, key);
+    }
+    return slot;
+}
+
+// LSD radix sort with digits of digitBits (8, 11 or 16). One read pass
+// builds the histograms of every digit at once; then each digit, least
+// significant first, is a stable scatter from one buffer into the other,
+// skipping digits that every key shares. An odd number of scatters ends in
+// the aux buffer and takes one more pass to copy back.
+template <typename View>
+void radixSort(View& a, unsigned digitBits, RadixWorkspace& workspace) {
+    using Key = typename View::KeyType;
+    const SortIndex n = a.size();
+    radixBegin<Key>(workspace, digitBits);
+
+    workspace.passBytes.push_back(n * sizeof(Key));
+    for (SortIndex i = 0; i < n; ++i) {
+        radixCount(a, workspace, i);
+    }
+    radixPrefixSums(workspace, n);
+
+    bool inAux = false;
+    for (unsigned digit = 0; digit < workspace.digitCount; ++digit) {
+        if (workspace.skipDigit[digit]) continue;
+        workspace.passBytes.push_back(2 * n * sizeof(Key));
+        for (SortIndex i = 0; i < n; ++i) {
+            radixScatter(a, workspace, digit, inAux, i);
+        }
+        inAux = !inAux;
+    }
+
+    if (inAux) {
+        workspace.passBytes.push_back(2 * n * sizeof(Key));
+        for (SortIndex i = 0; i < n; ++i) {
+            a.write(i, a.auxRead(i));
+        }
+    }
+}
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "algorithms/Instrumentation.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/kernels/NetworkTables.hpp"
+
+namespace kernels {
+
+// A sorting network as layers of compare-exchanges on disjoint wires, so a
+// whole layer can run at once: as one min and one max of vector registers,
+// or as one step of the visualizer
+class SortingNetwork {
+public:
+    SortIndex size() const { return m_size; }
+    const char* name() const { return m_name; }
+    int layerCount() const { return static_cast<int>(m_layerStarts.size()) - 1; }
+    size_t comparatorCount() const { return m_comparators.size(); }
+    const NetworkComparator* layerBegin(int layer) const { return m_comparators.data() + m_layerStarts[layer]; }
+    const NetworkComparator* layerEnd(int layer) const { return m_comparators.data() + m_layerStarts[layer + 1]; }
+
+    // Batcher's bitonic sorter for a power of two wires: merges of sorted
+    // runs of 1, 2, 4... keys, each of n/2 comparators per layer. Each merge
+    // starts by comparing mirror images rather than reversing a run, so
+    // every comparator puts the smaller key on the lower wire.
+    static SortingNetwork bitonicSort(SortIndex size) {
+        SortingNetwork network(size, "Bitonic sorter");
+        for (SortIndex span = 2; span <= size; span *= 2) {
+            network.addMerge(span);
+        }
+        return network;
+    }
+
+    // The last merge alone, which sorts two sorted halves
+    static SortingNetwork bitonicMerge(SortIndex size) {
+        SortingNetwork network(size, "Bitonic merger");
+        if (size >= 2) network.addMerge(size);
+        return network;
+    }
+
+    // A compile-time table, each comparator in the first layer after the
+    // last one that used either of its wires
+    static SortingNetwork fromTable(const NetworkTable& table, const char* name) {
+        SortingNetwork network(table.size, name);
+        std::vector<int> wireLayers(static_cast<size_t>(table.size), 0);
+        std::vector<std::vector<NetworkComparator>> layers;
+        for (size_t c = 0; c < table.count; ++c) {
+            const NetworkComparator comparator = table.comparators[c];
+            const int layer = std::max(wireLayers[comparator.low], wireLayers[comparator.high]);
+            if (layer == static_cast<int>(layers.size())) layers.emplace_back();
+            layers[layer].push_back(comparator);
+            wireLayers[comparator.low] = wireLayers[comparator.high] = layer + 1;
+        }
+        for (auto& layer : layers) {
+            std::sort(layer.begin(), layer.end(),
+                      [](NetworkComparator x, NetworkComparator y) { return x.low < y.low; });
+            network.m_comparators.insert(network.m_comparators.end(), layer.begin(), layer.end());
+            network.m_layerStarts.push_back(network.m_comparators.size());
+        }
+        return network;
+    }
+
+private:
+    SortingNetwork(SortIndex size, const char* name) : m_size(size), m_name(name), m_layerStarts{0} {}
+
+    // Layers merging each pair of sorted runs of span / 2 into one
+    void addMerge(SortIndex span) {
+        for (SortIndex i = 0; i < m_size; ++i) {
+            const SortIndex mirror = i ^ (span - 1);
+            if (i < mirror) m_comparators.push_back({static_cast<uint8_t>(i), static_cast<uint8_t>(mirror)});
+        }
+        m_layerStarts.push_back(m_comparators.size());
+        for (SortIndex distance = span / 4; distance >= 1; distance /= 2) {
+            for (SortIndex i = 0; i < m_size; ++i) {
+                if ((i & distance) == 0) {
+                    m_comparators.push_back({static_cast<uint8_t>(i), static_cast<uint8_t>(i + distance)});
+                }
+            }
+            m_layerStarts.push_back(m_comparators.size());
+        }
+    }
+
+    SortIndex m_size;
+    const char* m_name;
+    std::vector<NetworkComparator> m_comparators;
+    std::vector<size_t> m_layerStarts;      // and one past the last layer
+};
+
+// Sorting network of the last small range stepped through, the range's
+// first index and size, and the layer being applied, or the layer count
+// once it is sorted. network is null until there is one.
+struct NetworkProgress {
+    const SortingNetwork* network = nullptr;
+    SortIndex begin = 0;
+    SortIndex size = 0;
+    int layer = 0;
+};
+
+// Smallest bitonic network that covers n keys
+inline SortIndex networkSizeFor(SortIndex n) {
+    SortIndex size = 1;
+    while (size < n) size *= 2;
+    return size;
+}
+
+inline int networkLog2(SortIndex size) {
+    int log = 0;
+    while ((SortIndex(1) << log) < size) ++log;
+    return log;
+}
+
+// The bitonic sorter of a power of two wires up to kNetworkMaxSize, built
+// once
+inline const SortingNetwork& bitonicSortNetwork(SortIndex size) {
+    static const SortingNetwork networks[] = {
+        SortingNetwork::bitonicSort(1), SortingNetwork::bitonicSort(2), SortingNetwork::bitonicSort(4),
+        SortingNetwork::bitonicSort(8), SortingNetwork::bitonicSort(16), SortingNetwork::bitonicSort(32)
+    };
+    return networks[networkLog2(size)];
+}
+
+// The bitonic merge of two sorted halves of up to kNetworkMaxSize wires
+inline const SortingNetwork& bitonicMergeNetwork(SortIndex size) {
+    static const SortingNetwork networks[] = {
+        SortingNetwork::bitonicMerge(1), SortingNetwork::bitonicMerge(2), SortingNetwork::bitonicMerge(4),
+        SortingNetwork::bitonicMerge(8), SortingNetwork::bitonicMerge(16), SortingNetwork::bitonicMerge(32)
+    };
+    return networks[networkLog2(size)];
+}
+
+// The smallest known network for each size up to kNetworkMaxSize, in
+// layers, built once
+inline const SortingNetwork& smallestNetwork(SortIndex size) {
+    static const std::vector<SortingNetwork> networks = [] {
+        std::vector<SortingNetwork> built;
+        for (SortIndex n = 0; n <= kNetworkMaxSize; ++n) built.push_back(SortingNetwork::fromTable(networkTable(n), "Smallest known"));
+        return built;
+    }();
+    return networks[size];
+}
+
+// One compare-exchange. Vector code does it with a min and a max, so the
+// outcome is a swap or not rather than a branch.
+template <typename View>
+SORT_ALWAYS_INLINE void networkCompareExchange(View& a, SortIndex low, SortIndex high) {
+    a.swapIf(a.lessBranchFree(high, low), low, high);
+}
+
+// Applies a layer to the n keys from begin, fewer than the network's wires
+// if the rest are taken as padding larger than any key: comparators that
+// reach the padding would leave it where it is, so they are skipped.
+// Returns how many comparators ran.
+template <typename View>
+SortIndex networkLayer(View& a, SortIndex begin, SortIndex n, const SortingNetwork& network, int layer) {
+    SortIndex applied = 0;
+    for (const NetworkComparator* c = network.layerBegin(layer); c != network.layerEnd(layer); ++c) {
+        if (c->high >= n) continue;
+        networkCompareExchange(a, begin + c->low, begin + c->high);
+        applied++;
+    }
+    return applied;
+}
+
+// Sorts [begin, end), at most kNetworkMaxSize keys, with a bitonic network
+template <typename View>
+void networkSort(View& a, SortIndex begin, SortIndex end) {
+    const SortingNetwork& network = bitonicSortNetwork(networkSizeFor(end - begin));
+    for (int layer = 0; layer < network.layerCount(); ++layer) {
+        networkLayer(a, begin, end - begin, network, layer);
+    }
+}
+
+// The table network for Size keys as straight-line code: every comparator
+// is a compile-time pair of wires, so there are no loops and, with
+// swapIf, no branches
+template <SortIndex Size, typename View, size_t... Comparators>
+void tableSortUnrolled(View& a, SortIndex begin, std::index_sequence<Comparators...>) {
+    (networkCompareExchange(a, begin + networkTable(Size).comparators[Comparators].low,
+                            begin + networkTable(Size).comparators[Comparators].high), ...);
+}
+
+template <typename View, SortIndex Size>
+void tableSort(View& a, SortIndex begin) {
+    tableSortUnrolled<Size>(a, begin, std::make_index_sequence<networkTable(Size).count>());
+}
+
+template <typename View, SortIndex... Sizes>
+void tableSortSized(View& a, SortIndex begin, SortIndex n, std::integer_sequence<SortIndex, Sizes...>) {
+    using Sort = void (*)(View&, SortIndex);
+    static constexpr Sort sorts[] = {&tableSort<View, Sizes>...};
+    sorts[n](a, begin);
+}
+
+// Sorts [begin, end), at most kNetworkMaxSize keys, with the smallest known
+// network for its size. Only uninstrumented views get the unrolled code;
+// the others, slow anyway, loop over the same comparators rather than
+// compile every policy's hooks into 33 straight-line functions.
+template <typename View>
+void smallestNetworkSort(View& a, SortIndex begin, SortIndex end) {
+    if constexpr (std::is_same_v<typename View::PolicyType, NoInstrument>) {
+        tableSortSized(a, begin, end - begin, std::make_integer_sequence<SortIndex, kNetworkMaxSize + 1>());
+    } else {
+        const NetworkTable& table = networkTable(end - begin);
+        for (size_t c = 0; c < table.count; ++c) {
+            networkCompareExchange(a, begin + table.comparators[c].low, begin + table.comparators[c].high);
+        }
+    }
+}
+
+}
@@ -0,0 +1,204 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "algorithms/PartitionStack.hpp"
+#include "algorithms/SortTypes.hpp"
+#include "algorithms/kernels/BlockQuickSort.hpp"
+#include "algorithms/kernels/HeapSort.hpp"
+#include "algorithms/kernels/PdqSort.hpp"
+#include "algorithms/kernels/SortingNetwork.hpp"
+
+namespace kernels {
+
+// Widest vector the partition is modelled for: 16 lanes of 32-bit keys
+constexpr SortIndex kMaxVectorLanes = 16;
+
+// The in-place vector partition of x86-simd-sort and vqsort, element by
+// element. Both ends of the range are read into registers first, which
+// leaves a vector's worth of room at each end. From then on a vector is read
+// from whichever end has less room, compared with the pivot in one go and
+// stored split: the smaller keys packed onto the left end of the room and
+// the rest onto the right, both in their lane order. What is left over
+// after the last whole vector goes the same way one key at a time, and the
+// two vectors read first close the remaining gap.
+//
+// simd::partition runs the same steps with compresses or permutes and
+// leaves the keys in the same order, so this is also the step function's
+// model of it and the reference it is tested against.
+template <typename Key>
+struct VectorPartition {
+    SortIndex lanes = 0;
+    SortIndex pivot = 0;        // index of the pivot, outside the range
+    SortIndex readLeft = 0;     // keys not yet read are [readLeft, readRight)
+    SortIndex readRight = 0;
+    SortIndex writeLeft = 0;    // keys placed are [begin, writeLeft) and [writeRight, end)
+    SortIndex writeRight = 0;
+    bool hasEnds = false;                   // false for ranges under two vectors
+    Key ends[2][kMaxVectorLanes] = {};      // the two vectors read first, and
+    uint32_t endMasks[2] = {};              // which of their lanes are smaller
+    Key rest[2 * kMaxVectorLanes] = {};     // what no whole vector covers
+    uint32_t restMask = 0;
+    SortIndex restSize = 0;
+};
+
+// Compares lanes keys from index from with the pivot and reads them into
+// values; returns a mask of the ones that are smaller
+template <typename View, typename Key>
+uint32_t vectorLoad(View& a, const VectorPartition<Key>& p, SortIndex from, SortIndex lanes, Key* values) {
+    uint32_t mask = 0;
+    for (SortIndex k = 0; k < lanes; ++k) {
+        mask |= uint32_t(a.lessBranchFree(from + k, p.pivot)) << k;
+        values[k] = a.read(from + k);
+    }
+    return mask;
+}
+
+// Stores a vector split: the smaller keys from writeLeft up, the others so
+// they end at writeRight
+template <typename View, typename Key>
+void vectorStore(View& a, VectorPartition<Key>& p, const Key* values, uint32_t mask) {
+    SortIndex right = p.writeRight - p.lanes;
+    for (SortIndex k = 0; k < p.lanes; ++k) {
+        if (mask >> k & 1) {
+            a.write(p.writeLeft++, values[k]);
+            right++;
+        }
+    }
+    p.writeRight = right;
+    for (SortIndex k = 0; k < p.lanes; ++k) {
+        if (!(mask >> k & 1)) a.write(right++, values[k]);
+    }
+}
+
+// Reads the two end vectors, or the whole range into rest if it is too
+// small for them
+template <typename View, typename Key>
+void vectorPartitionBegin(View& a, VectorPartition<Key>& p, SortIndex begin, SortIndex end, SortIndex pivot,
+                          SortIndex lanes) {
+    p.lanes = lanes;
+    p.pivot = pivot;
+    p.writeLeft = begin;
+    p.writeRight = end;
+    p.restSize = 0;
+    p.hasEnds = end - begin >= 2 * lanes;
+    if (!p.hasEnds) {
+        p.readLeft = begin;
+        p.readRight = end;
+        return;
+    }
+    p.endMasks[0] = vectorLoad(a, p, begin, lanes, p.ends[0]);
+    p.endMasks[1] = vectorLoad(a, p, end - lanes, lanes, p.ends[1]);
+    p.readLeft = begin + lanes;
+    p.readRight = end - lanes;
+}
+
+template <typename Key>
+bool vectorHasWholeVector(const VectorPartition<Key>& p) {
+    return p.hasEnds && p.readRight - p.readLeft >= p.lanes;
+}
+
+// Whether the next vector is read from the left end, the one with less room
+template <typename Key>
+bool vectorReadsLeft(const VectorPartition<Key>& p) {
+    return p.readLeft - p.writeLeft <= p.writeRight - p.readRight;
+}
+
+// Partitions the next whole vector
+template <typename View, typename Key>
+void vectorPartitionStep(View& a, VectorPartition<Key>& p) {
+    Key values[kMaxVectorLanes];
+    SortIndex from;
+    if (vectorReadsLeft(p)) {
+        from = p.readLeft;
+        p.readLeft += p.lanes;
+    } else {
+        p.readRight -= p.lanes;
+        from = p.readRight;
+    }
+    vectorStore(a, p, values, vectorLoad(a, p, from, p.lanes, values));
+}
+
+// Reads the keys left over between the whole vectors
+template <typename View, typename Key>
+void vectorLoadRest(View& a, VectorPartition<Key>& p) {
+    p.restSize = p.readRight - p.readLeft;
+    p.restMask = vectorLoad(a, p, p.readLeft, p.restSize, p.rest);
+    p.readLeft = p.readRight;
+}
+
+// Places a leftover key: smaller ones onto the left of the gap, the others
+// onto its right, from the outside in
+template <typename View, typename Key>
+void vectorPlaceRest(View& a, VectorPartition<Key>& p, SortIndex k) {
+    if (p.restMask >> k & 1) {
+        a.write(p.writeLeft++, p.rest[k]);
+    } else {
+        a.write(--p.writeRight, p.rest[k]);
+    }
+}
+
+// Partitions [begin, end) around the key at pivot, outside the range, and
+// returns where the keys not smaller than it start
+template <typename View>
+SortIndex vectorPartition(View& a, SortIndex begin, SortIndex end, SortIndex pivot, SortIndex lanes) {
+    VectorPartition<typename View::KeyType> p;
+    vectorPartitionBegin(a, p, begin, end, pivot, lanes);
+    while (vectorHasWholeVector(p)) {
+        vectorPartitionStep(a, p);
+    }
+    vectorLoadRest(a, p);
+    for (SortIndex k = 0; k < p.restSize; ++k) {
+        vectorPlaceRest(a, p, k);
+    }
+    if (p.hasEnds) {
+        vectorStore(a, p, p.ends[0], p.endMasks[0]);
+        vectorStore(a, p, p.ends[1], p.endMasks[1]);
+    }
+    return p.writeLeft;
+}
+
+// Quicksort around a partition function called as partition(a, begin, end,
+// pivot), which splits [begin, end) around the key at pivot and returns the
+// boundary, and a function called as sortSmall(a, begin, end) that sorts
+// ranges of up to kNetworkMaxSize keys. Pivots and the depth limit are as
+// in blockQuickSort.
+template <typename View, typename Partition, typename SortSmall>
+void vectorQuickSortWith(View& a, Partition partition, SortSmall sortSmall) {
+    if (a.size() < 2) return;
+
+    PartitionStack pending;
+    pending.push(0, a.size() - 1, blockDepthBudget(a.size()));
+    while (!pending.empty()) {
+        PartitionStack::Range range = pending.pop();
+        const SortIndex begin = range.left;
+        const SortIndex end = range.right + 1;
+        if (end - begin <= kNetworkMaxSize) {
+            sortSmall(a, begin, end);
+            continue;
+        }
+        if (range.budget-- == 0) {
+            heapSortRange(a, begin, end);
+            continue;
+        }
+
+        pdqChoosePivot(a, begin, end);
+        const SortIndex pivot = partition(a, begin + 1, end, begin) - 1;
+        if (pivot != begin) a.swap(begin, pivot);
+        pending.pushChildren(range, pivot);
+    }
+}
+
+// The vector quicksort with its partition modelled in scalar code for
+// vectors of lanes keys, and small ranges sorted by the bitonic network the
+// vector code sorts them with in registers
+template <typename View>
+void vectorQuickSort(View& a, SortIndex lanes) {
+    vectorQuickSortWith(
+        a,
+        [lanes](View& view, SortIndex begin, SortIndex end, SortIndex pivot) {
+            return vectorPartition(view, begin, end, pivot, lanes);
+        },
+        [](View& view, SortIndex begin, SortIndex end) { networkSort(view, begin, end); });
+}
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "algorithms/BranchPredictor.hpp"
+#include "trace/OperationTrace.hpp"
+
+namespace trace {
+
+// Everything playback needs to resume before a given operation: full copies
+// of the array and the aux buffer, the counters and where the operation
+// starts in the trace
+struct Keyframe {
+    uint64_t operation;
+    TracePosition position;
+    uint64_t comparisons;
+    uint64_t swaps;
+    uint64_t moves;
+    Operation lastVisible;      // drives the highlights; READ when none yet
+    std::vector<int> array;
+    uint64_t mispredictions = 0;
+    BranchPredictor predictor{};    // its state going into the operation
+    std::vector<int> aux{};
+    uint64_t scans = 0;
+};
+
+// Keyframes of one run, ordered by operation. Whenever they outgrow the
+// memory budget every other one is dropped and the spacing doubles, so a run
+// of any length keeps keyframes spread evenly within the budget. The first
+// keyframe always stays, so seeking never has to replay from nothing.
+class KeyframeIndex {
+public:
+    static constexpr size_t kDefaultBudgetBytes = size_t(256) << 20;
+    static constexpr uint64_t kMinSpacing = 4096;
+
+    void reset(size_t elementCount) {
+        m_keyframes.clear();
+        m_memoryBytes = 0;
+        // At least n operations apart, so copying the array costs O(1) per op
+        m_spacing = std::max<uint64_t>(kMinSpacing, elementCount);
+        m_next = 0;
+    }
+
+    void setBudget(size_t bytes) {
+        m_budgetBytes = bytes;
+        thin();
+    }
+    size_t budget() const { return m_budgetBytes; }
+
+    // Whether a keyframe should be taken before this operation
+    bool due(uint64_t operation) const { return operation >= m_next; }
+
+    void add(Keyframe keyframe) {
+        m_memoryBytes += bytesOf(keyframe);
+        m_keyframes.push_back(std::move(keyframe));
+        thin();
+        m_next = m_keyframes.back().operation + m_spacing;
+    }
+
+    // The last keyframe at or before the operation, found by binary search
+    const Keyframe* find(uint64_t operation) const {
+        auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), operation,
+            [](uint64_t op, const Keyframe& keyframe) { return op < keyframe.operation; });
+        return it == m_keyframes.begin() ? nullptr : &*(it - 1);
+    }
+
+    size_t size() const { return m_keyframes.size(); }
+    bool empty() const { return m_keyframes.empty(); }
+    uint64_t spacing() const { return m_spacing; }
+    size_t memoryBytes() const { return m_memoryBytes; }
+
+private:
+    static size_t bytesOf(const Keyframe& keyframe) {
+        return sizeof(Keyframe) + (keyframe.array.size() + keyframe.aux.size()) * sizeof(int);
+    }
+
+    void thin() {
+        while (m_memoryBytes > m_budgetBytes && m_keyframes.size() > 1) {
+            size_t kept = 0;
+            m_memoryBytes = 0;
+            for (size_t i = 0; i < m_keyframes.size(); i += 2) {
+                m_memoryBytes += bytesOf(m_keyframes[i]);
+                if (kept != i) m_keyframes[kept] = std::move(m_keyframes[i]);
+                kept++;
+            }
+            m_keyframes.resize(kept);
+            m_spacing *= 2;
+        }
+        if (!m_keyframes.empty()) m_next = m_keyframes.back().operation + m_spacing;
+    }
+
+    std::vector<Keyframe> m_keyframes;
+    size_t m_budgetBytes = kDefaultBudgetBytes;
+    size_t m_memoryBytes = 0;
+    uint64_t m_spacing = kMinSpacing;
+    uint64_t m_next = 0;
+};
+
+// Trace sink that takes keyframes of the array being sorted as it records
+// into another sink. Hooks run before their operation mutates the array, so
+// the array seen at each append is the state before that operation. The
+// kernel's own aux buffer is not the one playback shows, so aux writes are
+// applied to a copy of playback's, starting from how playback starts it.
+template <typename Sink>
+class KeyframeRecorder {
+public:
+    KeyframeRecorder(Sink sink, const int* array, size_t size, std::vector<int> aux, KeyframeIndex& keyframes)
+        : m_sink(std::move(sink)), m_array(array), m_size(size), m_aux(std::move(aux)), m_keyframes(&keyframes) {}
+
+    void append(const Operation& op) {
+        if (m_keyframes->due(m_operation)) snapshot();
+        m_sink.append(op);
+        m_operation++;
+
+        // Counted as playback counts them: every compare as a branch
+        switch (op.code) {
+            case OpCode::COMPARE:
+                m_comparisons++;
+                m_mispredictions += m_predictor.mispredicts(op.result);
+                break;
+            case OpCode::SWAP: m_swaps++; break;
+            case OpCode::WRITE: m_moves++; break;
+            case OpCode::AUX_WRITE:
+                // Playback skips writes past its aux buffer too
+                if (op.a >= 0 && op.a < static_cast<int64_t>(m_aux.size())) m_aux[op.a] = static_cast<int>(op.b);
+                m_moves++;
+                break;
+            default: break;
+        }
+        if (isVisible(op.code)) m_lastVisible = op;
+    }
+
+    Sink& sink() { return m_sink; }
+
+private:
+    void snapshot() {
+        m_keyframes->add(Keyframe{m_operation, m_sink.position(), m_comparisons, m_swaps, m_moves,
+                                  m_lastVisible, std::vector<int>(m_array, m_array + m_size),
+                                  m_mispredictions, m_predictor, m_aux});
+    }
+
+    Sink m_sink;
+    const int* m_array;
+    size_t m_size;
+    std::vector<int> m_aux;
+    KeyframeIndex* m_keyframes;
+    uint64_t m_operation = 0;
+    uint64_t m_comparisons = 0;
+    uint64_t m_swaps = 0;
+    uint64_t m_moves = 0;
+    uint64_t m_mispredictions = 0;
+    BranchPredictor m_predictor;
+    Operation m_lastVisible{OpCode::READ, false, 0, 0};
+};
+
+}
@@ -0,0 +1,359 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace trace {
+
+enum class OpCode : uint8_t {
+    COMPARE,    // a, b: element positions (-1 for a temporary or aux element), result: a < b
+    SWAP,       // a, b: element positions
+    READ,       // a: position read into a temporary
+    WRITE,      // a: position, b: value written
+    AUX_READ,   // a: aux buffer position
+    AUX_WRITE   // a: aux buffer position, b: value written
+};
+
+constexpr size_t kOpCodeCount = 6;
+
+struct Operation {
+    OpCode code;
+    bool result;
+    int64_t a;
+    int64_t b;
+};
+
+// Operations on the main array, the ones playback shows as a step
+inline bool isVisible(OpCode code) {
+    return code == OpCode::COMPARE || code == OpCode::SWAP || code == OpCode::WRITE;
+}
+
+inline bool hasSecondOperand(OpCode code) {
+    return code != OpCode::READ && code != OpCode::AUX_READ;
+}
+
+inline uint64_t zigzagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Everything needed to resume decoding in the middle of a trace: the byte
+// offset, the previous operands of each opcode that deltas apply to, and any
+// run being expanded. A fresh state decodes from the start of a chunk.
+struct DecoderState {
+    uint64_t offset = 0;
+    int64_t lastA[kOpCodeCount] = {};
+    int64_t lastB[kOpCodeCount] = {};
+
+    // Shape of the last token, which a run repeats
+    uint8_t shapeCode = 0;
+    int64_t shapeDeltaA = 0;
+    int64_t shapeDeltaB = 0;
+
+    uint64_t runRemaining = 0;
+    uint64_t runBits = 0;       // offset of the run's compare results
+    uint64_t runIndex = 0;
+};
+
+// Where an operation starts in an encoded trace. In-memory traces are a
+// single chunk.
+struct TracePosition {
+    uint64_t chunk;
+    DecoderState state;
+};
+
+// Trace encoding.
+//
+// Operands are stored as deltas from the same opcode's previous operands, so
+// the regular strides of sorting loops (bubble sort comparing j+1 with j,
+// a partition scan comparing j with a fixed pivot) become tiny numbers.
+// Each token is a header byte:
+//
+//   bits 0-2   opcode, or kRunToken
+//   bit 3      compare result
+//   bits 4-5   form of the delta of a: +1, -1, 0, or a zigzag varint follows
+//   bits 6-7   the same for b
+//
+// so a scan step takes a single byte. A run token repeats the previous
+// token's opcode and deltas a varint count of times, followed for compares
+// by their results packed one bit each, which is how long sequential scans
+// cost about a bit per operation.
+namespace codec {
+
+constexpr uint8_t kRunToken = 6;
+constexpr unsigned kFormPlusOne = 0;
+constexpr unsigned kFormMinusOne = 1;
+constexpr unsigned kFormZero = 2;
+constexpr unsigned kFormVarint = 3;
+
+// Repeats shorter than this are cheaper as plain tokens
+constexpr uint64_t kMinRun = 4;
+constexpr uint64_t kMaxRun = 4096;
+
+inline unsigned deltaForm(int64_t delta) {
+    switch (delta) {
+        case 1: return kFormPlusOne;
+        case -1: return kFormMinusOne;
+        case 0: return kFormZero;
+        default: return kFormVarint;
+    }
+}
+
+inline uint8_t* writeVarint(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+// A 64-bit value takes at most ten bytes
+constexpr unsigned kMaxVarintBytes = 10;
+
+// False if the varint runs past size or past ten bytes, which only corrupt
+// data does
+inline bool readVarint(const uint8_t* data, uint64_t size, uint64_t& offset, uint64_t& value) {
+    value = 0;
+    for (unsigned i = 0; i < kMaxVarintBytes && offset < size; ++i) {
+        const uint8_t byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+}
+
+// Append-only log of the primitive operations of one run, in the encoding
+// above. Repeats of the last token are held back until they end, so call
+// flush() before reading the bytes.
+class OperationTrace {
+public:
+    static constexpr size_t kMaxTokenBytes = 1 + 2 * 10;
+
+    void clear() {
+        m_bytes.clear();
+        m_size = 0;
+        m_count = 0;
+        m_context = DecoderState();
+        m_runCount = 0;
+        m_runResults.clear();
+        m_hasShape = false;
+    }
+
+    // Writes out a pending run
+    void flush() {
+        if (m_runCount == 0) return;
+
+        if (m_runCount < codec::kMinRun) {
+            for (uint64_t i = 0; i < m_runCount; ++i) {
+                const bool result = (m_runResults[i / 8] >> (i % 8)) & 1;
+                reserve(kMaxTokenBytes);
+                m_bytes[m_size] = static_cast<uint8_t>((m_shapeHeader & ~0x08u) | (result ? 0x08u : 0u));
+                std::copy(m_shapeOperands, m_shapeOperands + m_shapeOperandBytes, &m_bytes[m_size + 1]);
+                m_size += 1 + m_shapeOperandBytes;
+            }
+        } else {
+            const bool compare = m_context.shapeCode == static_cast<uint8_t>(OpCode::COMPARE);
+            const size_t bitBytes = compare ? (m_runCount + 7) / 8 : 0;
+            reserve(1 + 10 + bitBytes);
+            uint8_t* out = &m_bytes[m_size];
+            *out++ = codec::kRunToken;
+            out = codec::writeVarint(out, m_runCount);
+            out = std::copy(m_runResults.begin(), m_runResults.begin() + bitBytes, out);
+            m_size = static_cast<size_t>(out - m_bytes.data());
+        }
+        m_runCount = 0;
+        m_runResults.clear();
+    }
+
+    // Drops the slack kept for appending once a recording is complete
+    void shrinkToFit() {
+        flush();
+        m_bytes.resize(m_size);
+        m_bytes.shrink_to_fit();
+    }
+
+    void append(const Operation& op) {
+        const size_t code = static_cast<size_t>(op.code);
+        const int64_t b = hasSecondOperand(op.code) ? op.b : 0;
+        const int64_t deltaA = op.a - m_context.lastA[code];
+        const int64_t deltaB = b - m_context.lastB[code];
+        m_context.lastA[code] = op.a;
+        m_context.lastB[code] = b;
+        m_count++;
+
+        // Same opcode and strides as the last token: extend the run
+        if (m_hasShape && m_context.shapeCode == code &&
+            m_context.shapeDeltaA == deltaA && m_context.shapeDeltaB == deltaB) {
+            if (m_runCount % 8 == 0) m_runResults.push_back(0);
+            if (op.result) m_runResults.back() |= static_cast<uint8_t>(1u << (m_runCount % 8));
+            if (++m_runCount == codec::kMaxRun) flush();
+            return;
+        }
+
+        flush();
+        const unsigned formA = codec::deltaForm(deltaA);
+        const unsigned formB = codec::deltaForm(deltaB);
+        m_shapeHeader = static_cast<uint8_t>(code | (op.result ? 0x08u : 0u) | (formA << 4) | (formB << 6));
+        uint8_t* operands = m_shapeOperands;
+        if (formA == codec::kFormVarint) operands = codec::writeVarint(operands, zigzagEncode(deltaA));
+        if (formB == codec::kFormVarint) operands = codec::writeVarint(operands, zigzagEncode(deltaB));
+        m_shapeOperandBytes = static_cast<size_t>(operands - m_shapeOperands);
+
+        reserve(kMaxTokenBytes);
+        m_bytes[m_size] = m_shapeHeader;
+        std::copy(m_shapeOperands, operands, &m_bytes[m_size + 1]);
+        m_size += 1 + m_shapeOperandBytes;
+
+        m_context.shapeCode = static_cast<uint8_t>(code);
+        m_context.shapeDeltaA = deltaA;
+        m_context.shapeDeltaB = deltaB;
+        m_hasShape = true;
+    }
+
+    void compare(int64_t i, int64_t j, bool result) { append(Operation{OpCode::COMPARE, result, i, j}); }
+    void swap(int64_t i, int64_t j) { append(Operation{OpCode::SWAP, false, i, j}); }
+    void read(int64_t i) { append(Operation{OpCode::READ, false, i, 0}); }
+    void write(int64_t i, int64_t value) { append(Operation{OpCode::WRITE, false, i, value}); }
+    void auxRead(int64_t i) { append(Operation{OpCode::AUX_READ, false, i, 0}); }
+    void auxWrite(int64_t i, int64_t value) { append(Operation{OpCode::AUX_WRITE, false, i, value}); }
+
+    size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    size_t byteSize() const { return m_size; }
+    const uint8_t* data() const { return m_bytes.data(); }
+
+    // Flushes so the next operation starts a token, for keyframes
+    TracePosition position() {
+        flush();
+        TracePosition position{0, m_context};
+        position.state.offset = m_size;
+        return position;
+    }
+
+private:
+    // Grows geometrically ahead of time so the hot path is plain stores
+    void reserve(size_t bytes) {
+        if (m_bytes.size() - m_size < bytes) {
+            m_bytes.resize(std::max(m_bytes.size() * 2, m_size + bytes));
+        }
+    }
+
+    std::vector<uint8_t> m_bytes;
+    size_t m_size = 0;
+    size_t m_count = 0;
+
+    // Encoder side of the decoder's state, and the run being held back
+    DecoderState m_context;
+    bool m_hasShape = false;
+    uint8_t m_shapeHeader = 0;
+    uint8_t m_shapeOperands[20] = {};
+    size_t m_shapeOperandBytes = 0;
+    uint64_t m_runCount = 0;
+    std::vector<uint8_t> m_runResults;
+};
+
+// Sequential decoder over an encoded trace. Its state can live outside it,
+// so a player keeps the state between steps and wraps it in a reader
+// whenever it needs one. Data that does not decode, such as a truncated
+// chunk or an unknown opcode, ends it with failed() set.
+class TraceReader {
+public:
+    TraceReader(const uint8_t* data, size_t size)
+        : m_data(data), m_size(size), m_state(&m_ownState) {}
+    TraceReader(const uint8_t* data, size_t size, DecoderState& state)
+        : m_data(data), m_size(size), m_state(&state) {}
+    // The trace must be flushed
+    explicit TraceReader(const OperationTrace& trace)
+        : TraceReader(trace.data(), trace.byteSize()) {}
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool atEnd() const { return m_state->runRemaining == 0 && m_state->offset >= m_size; }
+    bool failed() const { return m_failed; }
+    const DecoderState& state() const { return *m_state; }
+
+    bool next(Operation& op) {
+        DecoderState& s = *m_state;
+        if (s.runRemaining == 0) {
+            if (m_failed || s.offset >= m_size) return false;
+            const uint8_t header = m_data[s.offset++];
+            const unsigned code = header & 0x7;
+            if (code != codec::kRunToken) {
+                if (code >= kOpCodeCount) return fail();
+                s.shapeCode = static_cast<uint8_t>(code);
+                if (!readDelta((header >> 4) & 0x3, s.shapeDeltaA) || !readDelta(header >> 6, s.shapeDeltaB)) {
+                    return fail();
+                }
+                emit(op, (header & 0x08) != 0);
+                return true;
+            }
+
+            // The encoder never writes an empty or over-long run, and the
+            // results of a run of compares must fit in what is left
+            uint64_t count = 0;
+            if (!codec::readVarint(m_data, m_size, s.offset, count) || count == 0 || count > codec::kMaxRun) {
+                return fail();
+            }
+            const uint64_t bitBytes = s.shapeCode == static_cast<uint8_t>(OpCode::COMPARE) ? (count + 7) / 8 : 0;
+            if (bitBytes > m_size - s.offset) return fail();
+            s.runRemaining = count;
+            s.runBits = s.offset;
+            s.runIndex = 0;
+            s.offset += bitBytes;
+        }
+
+        const bool result = s.shapeCode == static_cast<uint8_t>(OpCode::COMPARE) &&
+            ((m_data[s.runBits + s.runIndex / 8] >> (s.runIndex % 8)) & 1);
+        s.runIndex++;
+        s.runRemaining--;
+        emit(op, result);
+        return true;
+    }
+
+private:
+    // The short forms are a table lookup rather than a branch, since which
+    // one comes next is as unpredictable as the sort itself
+    bool readDelta(unsigned form, int64_t& delta) {
+        static constexpr int64_t kShortDeltas[4] = {1, -1, 0, 0};
+        if (form != codec::kFormVarint) {
+            delta = kShortDeltas[form];
+            return true;
+        }
+        uint64_t value = 0;
+        if (!codec::readVarint(m_data, m_size, m_state->offset, value)) return false;
+        delta = zigzagDecode(value);
+        return true;
+    }
+
+    bool fail() {
+        m_failed = true;
+        return false;
+    }
+
+    // Applies the current shape's deltas and produces the operation
+    void emit(Operation& op, bool result) {
+        DecoderState& s = *m_state;
+        const unsigned code = s.shapeCode;
+        s.lastA[code] += s.shapeDeltaA;
+        s.lastB[code] += s.shapeDeltaB;
+        op.code = static_cast<OpCode>(code);
+        op.result = result;
+        op.a = s.lastA[code];
+        op.b = s.lastB[code];
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    DecoderState m_ownState;
+    DecoderState* m_state;
+    bool m_failed = false;
+};
+
+}
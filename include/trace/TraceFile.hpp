@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "trace/OperationTrace.hpp"
+
+namespace trace {
+
+// On-disk trace layout, in host byte order (little-endian on every platform
+// this builds for):
+//
+//   TraceFileHeader
+//   initial array        elementCount x int32
+//   chunks               encoded operations, each decodable on its own
+//   index                chunkCount x TraceChunkInfo
+//
+// The header is written last, so a recording that never finished has no
+// index offset and is rejected on open.
+constexpr char kTraceFileMagic[8] = {'A', 'V', 'T', 'R', 'A', 'C', 'E', '\0'};
+constexpr uint32_t kTraceFileVersion = 2;
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t algorithm;         // tag chosen by the writer
+    uint64_t elementCount;
+    uint64_t arrayOffset;
+    uint64_t operationCount;
+    uint64_t chunkCount;
+    uint64_t indexOffset;
+};
+
+struct TraceChunkInfo {
+    uint64_t offset;
+    uint64_t byteSize;
+    uint64_t firstOperation;
+    uint64_t operationCount;
+};
+
+// Streams operations to a trace file, buffering one chunk at a time.
+// Has the same append() as OperationTrace so it can back RecordTraceTo.
+class TraceFileWriter {
+public:
+    static constexpr size_t kDefaultChunkBytes = 1 << 20;
+
+    TraceFileWriter() = default;
+    TraceFileWriter(TraceFileWriter&& other) noexcept;
+    TraceFileWriter& operator=(TraceFileWriter&& other) noexcept;
+    TraceFileWriter(const TraceFileWriter&) = delete;
+    TraceFileWriter& operator=(const TraceFileWriter&) = delete;
+    ~TraceFileWriter();
+
+    bool open(const std::string& path, const std::vector<int>& initialArray, uint32_t algorithm,
+              size_t chunkBytes = kDefaultChunkBytes);
+    bool isOpen() const { return m_file != nullptr; }
+
+    void append(const Operation& op) {
+        m_chunk.append(op);
+        if (m_chunk.byteSize() >= m_chunkBytes) flushChunk();
+    }
+
+    uint64_t size() const { return m_header.operationCount + m_chunk.size(); }
+    TracePosition position() {
+        TracePosition position = m_chunk.position();
+        position.chunk = m_index.size();
+        return position;
+    }
+
+    // Writes the last chunk, the index and the header; false if any write failed
+    bool finish();
+
+private:
+    void flushChunk();
+    void write(const void* data, size_t bytes);
+
+    std::FILE* m_file = nullptr;
+    TraceFileHeader m_header{};
+    OperationTrace m_chunk;
+    std::vector<TraceChunkInfo> m_index;
+    uint64_t m_offset = 0;
+    size_t m_chunkBytes = kDefaultChunkBytes;
+    bool m_failed = false;
+};
+
+// Read side of a trace file. Opening reads only the header and the chunk
+// index; chunk data is memory-mapped a window at a time, so a multi-gigabyte
+// trace opens instantly and only the window around playback is resident.
+class TraceFile {
+public:
+    static constexpr size_t kDefaultWindowBytes = 16 << 20;
+
+    TraceFile() = default;
+    // Copies open the same file with their own mapping
+    TraceFile(const TraceFile& other) { *this = other; }
+    TraceFile& operator=(const TraceFile& other);
+    ~TraceFile() { close(); }
+
+    bool open(const std::string& path, size_t windowBytes = kDefaultWindowBytes);
+    void close();
+    bool isOpen() const { return m_open; }
+
+    const TraceFileHeader& header() const { return m_header; }
+    size_t chunkCount() const { return m_index.size(); }
+    const TraceChunkInfo& chunkInfo(size_t chunk) const { return m_index[chunk]; }
+    uint64_t fileSize() const { return m_fileSize; }
+    size_t residentBytes() const { return m_window.length; }
+
+    bool readInitialArray(std::vector<int>& array);
+
+    // Bytes of the given chunk, valid until the next call moves the window
+    const uint8_t* mapChunk(size_t chunk);
+
+private:
+    struct Region {
+        void* base = nullptr;
+        size_t length = 0;
+        uint64_t offset = 0;
+    };
+
+    bool mapRegion(Region& region, uint64_t offset, size_t length);
+    void unmapRegion(Region& region);
+
+    // Reads through a temporary mapping; used for the header, index and array
+    bool readRange(void* out, uint64_t offset, size_t length);
+
+    bool m_open = false;
+    std::string m_path;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    uint64_t m_fileSize = 0;
+    size_t m_windowBytes = kDefaultWindowBytes;
+    TraceFileHeader m_header{};
+    std::vector<TraceChunkInfo> m_index;
+    Region m_window;
+};
+
+}
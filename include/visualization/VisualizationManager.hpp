@@ -1,6 +1,7 @@
 #pragma once
 #include "algorithms/SortingAlgorithm.hpp"
 #include <memory>
+#include <vector>
 
 class VisualizationManager {
 public:
@@ -11,12 +12,32 @@ public:
     void renderImGui();
 
 private:
-    void renderSortingAlgorithm();
+    void renderSortingAlgorithm(const SortingAlgorithm& sorter, const char* title);
+    // Layers of the sorting network finishing a small range, as wires and
+    // compare-exchanges
+    void renderSortingNetwork(const SortingAlgorithm& sorter);
     void renderControls();
     void renderMetrics();
 
+    // Restarts the comparison run on the main run's current array
+    void syncComparison();
+
     std::unique_ptr<SortingAlgorithm> m_sortingAlgorithm;
+    // Second algorithm run side by side on the same input, if one is chosen
+    std::unique_ptr<SortingAlgorithm> m_comparison;
+    int m_comparisonAlgorithm;
+    std::vector<HighlightRole> m_barRoles;
+    std::vector<int> m_networkColumns;
     float m_speed;
+    unsigned long long m_arraySize;
+    float m_keyframeBudgetMB;
+    char m_tracePath[256];
+    bool m_traceFileFailed;
+    SortingAlgorithm::SimdBenchmark m_simdBenchmark;
+    bool m_hasSimdBenchmark;
+    double m_uninstrumentedTime;
+    bool m_hasUninstrumentedTime;
     bool m_isPaused;
+    bool m_playReverse;
     bool m_stepMode;
 };
@@ -0,0 +1,172 @@
+#include "algorithms/SimdSort.hpp"
+#include "algorithms/Instrumentation.hpp"
+#include "algorithms/kernels/BlockQuickSort.hpp"
+#include "algorithms/kernels/VectorQuickSort.hpp"
+#include <functional>
+
+#if SIMD_SORT_X86 && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace simd {
+
+// In SimdSortAvx2.cpp and SimdSortAvx512.cpp, compiled for those sets
+SortIndex avx2Partition(int32_t* data, SortIndex begin, SortIndex end, int32_t pivot);
+SortIndex avx2Partition(int64_t* data, SortIndex begin, SortIndex end, int64_t pivot);
+SortIndex avx512Partition(int32_t* data, SortIndex begin, SortIndex end, int32_t pivot);
+SortIndex avx512Partition(int64_t* data, SortIndex begin, SortIndex end, int64_t pivot);
+void avx2SortSmall(int32_t* data, SortIndex n);
+void avx2SortSmall(int64_t* data, SortIndex n);
+void avx512SortSmall(int32_t* data, SortIndex n);
+void avx512SortSmall(int64_t* data, SortIndex n);
+void avx2MergeVectors(int32_t* keys);
+void avx2MergeVectors(int64_t* keys);
+void avx512MergeVectors(int32_t* keys);
+void avx512MergeVectors(int64_t* keys);
+
+}
+
+namespace {
+    simd::Isa findIsa() {
+#if SIMD_SORT_X86 && defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return simd::Isa::SCALAR;
+        __cpuid(info, 1);
+        const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));    // OSXSAVE and AVX
+        if (!avx) return simd::Isa::SCALAR;
+        const unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        if ((xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16))) return simd::Isa::AVX512;
+        if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5))) return simd::Isa::AVX2;
+        return simd::Isa::SCALAR;
+#elif SIMD_SORT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return simd::Isa::AVX512;
+        if (__builtin_cpu_supports("avx2")) return simd::Isa::AVX2;
+        return simd::Isa::SCALAR;
+#else
+        return simd::Isa::SCALAR;
+#endif
+    }
+
+    template <typename Key>
+    using NativeView = ArrayView<Key, std::less<Key>, NoInstrument>;
+
+    template <typename Key>
+    SortIndex partitionFor(Key* data, SortIndex begin, SortIndex end, SortIndex pivot, simd::Isa isa) {
+        switch (isa) {
+#if SIMD_SORT_X86
+            case simd::Isa::AVX512: return simd::avx512Partition(data, begin, end, data[pivot]);
+            case simd::Isa::AVX2: return simd::avx2Partition(data, begin, end, data[pivot]);
+#endif
+            default: break;
+        }
+        NoInstrument policy;
+        NativeView<Key> view(data, end, std::less<Key>(), policy);
+        return kernels::vectorPartition(view, begin, end, pivot, simd::vectorLanes<Key>(isa));
+    }
+
+    // Without vectors the bitonic networks have nothing to gain over the
+    // smallest known ones, unrolled
+    template <typename Key>
+    void sortSmallFor(Key* data, SortIndex n, simd::Isa isa) {
+        switch (isa) {
+#if SIMD_SORT_X86
+            case simd::Isa::AVX512: simd::avx512SortSmall(data, n); return;
+            case simd::Isa::AVX2: simd::avx2SortSmall(data, n); return;
+#endif
+            default: break;
+        }
+        NoInstrument policy;
+        NativeView<Key> view(data, n, std::less<Key>(), policy);
+        kernels::smallestNetworkSort(view, 0, n);
+    }
+
+    template <typename Key>
+    void mergeVectorsFor(Key* keys, simd::Isa isa) {
+        switch (isa) {
+#if SIMD_SORT_X86
+            case simd::Isa::AVX512: simd::avx512MergeVectors(keys); return;
+            case simd::Isa::AVX2: simd::avx2MergeVectors(keys); return;
+#endif
+            default: break;
+        }
+        const SortIndex n = 2 * simd::vectorLanes<Key>(isa);
+        const kernels::SortingNetwork& merge = kernels::bitonicMergeNetwork(n);
+        NoInstrument policy;
+        NativeView<Key> view(keys, n, std::less<Key>(), policy);
+        for (int layer = 0; layer < merge.layerCount(); ++layer) {
+            kernels::networkLayer(view, 0, n, merge, layer);
+        }
+    }
+
+    // Without vectors, the model's partition is no faster than any other
+    // scalar one, so the fallback is the branch-free BlockQuicksort
+    template <typename Key>
+    void quickSortFor(Key* data, size_t size, simd::Isa isa) {
+        NoInstrument policy;
+        NativeView<Key> view(data, static_cast<SortIndex>(size), std::less<Key>(), policy);
+        if (isa == simd::Isa::SCALAR) {
+            kernels::blockQuickSort(view);
+            return;
+        }
+        kernels::vectorQuickSortWith(
+            view,
+            [data, isa](NativeView<Key>&, SortIndex begin, SortIndex end, SortIndex pivot) {
+                return partitionFor(data, begin, end, pivot, isa);
+            },
+            [data, isa](NativeView<Key>&, SortIndex begin, SortIndex end) { sortSmallFor(data + begin, end - begin, isa); });
+    }
+}
+
+namespace simd {
+
+Isa detectIsa() {
+    static const Isa isa = findIsa();
+    return isa;
+}
+
+const char* getIsaName(Isa isa) {
+    switch (isa) {
+        case Isa::SCALAR: return "Scalar";
+        case Isa::AVX2: return "AVX2";
+        case Isa::AVX512: return "AVX-512";
+    }
+    return "Unknown";
+}
+
+SortIndex partition(int32_t* data, SortIndex begin, SortIndex end, SortIndex pivot, Isa isa) {
+    return partitionFor(data, begin, end, pivot, isa);
+}
+
+SortIndex partition(int64_t* data, SortIndex begin, SortIndex end, SortIndex pivot, Isa isa) {
+    return partitionFor(data, begin, end, pivot, isa);
+}
+
+void sortSmall(int32_t* data, size_t size, Isa isa) {
+    sortSmallFor(data, static_cast<SortIndex>(size), isa);
+}
+
+void sortSmall(int64_t* data, size_t size, Isa isa) {
+    sortSmallFor(data, static_cast<SortIndex>(size), isa);
+}
+
+void mergeVectors(int32_t* keys, Isa isa) {
+    mergeVectorsFor(keys, isa);
+}
+
+void mergeVectors(int64_t* keys, Isa isa) {
+    mergeVectorsFor(keys, isa);
+}
+
+void quickSort(int32_t* data, size_t size, Isa isa) {
+    quickSortFor(data, size, isa);
+}
+
+void quickSort(int64_t* data, size_t size, Isa isa) {
+    quickSortFor(data, size, isa);
+}
+
+}
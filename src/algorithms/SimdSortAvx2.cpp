@@ -0,0 +1,138 @@
+#include "algorithms/SimdSort.hpp"
+
+#if SIMD_SORT_X86
+#include <immintrin.h>
+#include <limits>
+#include "algorithms/SortTypes.hpp"
+
+// Everything from here on may use AVX2; it is only called once detectIsa
+// has found it. The headers it uses are included above, so that only its
+// own functions are compiled for AVX2.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+#endif
+
+#include "algorithms/SimdLanes.hpp"
+#include "algorithms/SimdNetwork.hpp"
+#include "algorithms/SimdPartition.hpp"
+
+namespace {
+    // For each compare mask, the lane order that puts the masked lanes
+    // first, as 32-bit lane indices for permutevar8x32. 64-bit lanes take
+    // two 32-bit lanes each.
+    template <int Lanes>
+    struct SplitTable {
+        uint8_t order[1 << Lanes][8] = {};
+
+        constexpr SplitTable() {
+            constexpr int width = 8 / Lanes;
+            for (int mask = 0; mask < (1 << Lanes); ++mask) {
+                int out = 0;
+                for (int pass = 0; pass < 2; ++pass) {
+                    for (int lane = 0; lane < Lanes; ++lane) {
+                        if (((mask >> lane & 1) != 0) != (pass == 0)) continue;
+                        for (int half = 0; half < width; ++half) {
+                            order[mask][out++] = static_cast<uint8_t>(lane * width + half);
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    constexpr SplitTable<8> kSplit32;
+    constexpr SplitTable<4> kSplit64;
+
+    inline __m256i splitWith(__m256i keys, const uint8_t* order) {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(order));
+        return _mm256_permutevar8x32_epi32(keys, _mm256_cvtepu8_epi32(bytes));
+    }
+
+    struct Avx2Int32 {
+        using Key = int32_t;
+        using Vec = __m256i;
+        static constexpr SortIndex kLanes = 8;
+
+        static Vec load(const Key* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        static void store(Key* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+        static Vec broadcast(Key k) { return _mm256_set1_epi32(k); }
+        static uint32_t lessMask(Vec keys, Vec pivots) {
+            return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pivots, keys))));
+        }
+        static SortIndex count(uint32_t mask) { return popCount(mask); }
+        static Vec split(Vec keys, uint32_t mask) { return splitWith(keys, kSplit32.order[mask]); }
+
+        static Vec min(Vec a, Vec b) { return _mm256_min_epi32(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm256_max_epi32(a, b); }
+        template <int X>
+        static Vec permuteXor(Vec v) {
+            return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0 ^ X, 1 ^ X, 2 ^ X, 3 ^ X, 4 ^ X, 5 ^ X, 6 ^ X, 7 ^ X));
+        }
+        template <int Bit>
+        static Vec blendHigh(Vec low, Vec high) { return _mm256_blend_epi32(low, high, laneMask(8, Bit, 1)); }
+    };
+
+    struct Avx2Int64 {
+        using Key = int64_t;
+        using Vec = __m256i;
+        static constexpr SortIndex kLanes = 4;
+
+        static Vec load(const Key* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        static void store(Key* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+        static Vec broadcast(Key k) { return _mm256_set1_epi64x(k); }
+        static uint32_t lessMask(Vec keys, Vec pivots) {
+            return static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(pivots, keys))));
+        }
+        static SortIndex count(uint32_t mask) { return popCount(mask); }
+        static Vec split(Vec keys, uint32_t mask) { return splitWith(keys, kSplit64.order[mask]); }
+
+        // No 64-bit min and max before AVX-512, so they are a compare and a blend
+        static Vec min(Vec a, Vec b) { return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+        static Vec max(Vec a, Vec b) { return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+        template <int X>
+        static Vec permuteXor(Vec v) {
+            return _mm256_permute4x64_epi64(v, (0 ^ X) | (1 ^ X) << 2 | (2 ^ X) << 4 | (3 ^ X) << 6);
+        }
+        template <int Bit>
+        static Vec blendHigh(Vec low, Vec high) { return _mm256_blend_epi32(low, high, laneMask(4, Bit, 2)); }
+    };
+}
+
+namespace simd {
+
+SortIndex avx2Partition(int32_t* data, SortIndex begin, SortIndex end, int32_t pivot) {
+    return partitionWith<Avx2Int32>(data, begin, end, pivot);
+}
+
+SortIndex avx2Partition(int64_t* data, SortIndex begin, SortIndex end, int64_t pivot) {
+    return partitionWith<Avx2Int64>(data, begin, end, pivot);
+}
+
+void avx2SortSmall(int32_t* data, SortIndex n) {
+    sortSmallWith<Avx2Int32, kSortSmallMax>(data, n);
+}
+
+void avx2SortSmall(int64_t* data, SortIndex n) {
+    sortSmallWith<Avx2Int64, kSortSmallMax>(data, n);
+}
+
+void avx2MergeVectors(int32_t* keys) {
+    mergeVectorsWith<Avx2Int32>(keys);
+}
+
+void avx2MergeVectors(int64_t* keys) {
+    mergeVectorsWith<Avx2Int64>(keys);
+}
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
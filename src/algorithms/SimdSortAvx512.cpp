@@ -0,0 +1,125 @@
+#include "algorithms/SimdSort.hpp"
+
+#if SIMD_SORT_X86
+#include <immintrin.h>
+#include <limits>
+#include "algorithms/SortTypes.hpp"
+
+// Everything from here on may use AVX-512F; it is only called once
+// detectIsa has found it. The headers it uses are included above, so that
+// only its own functions are compiled for AVX-512.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,popcnt")
+// GCC 12 takes the undefined pass-through operand of some intrinsics for an
+// uninitialized variable
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "algorithms/SimdLanes.hpp"
+#include "algorithms/SimdNetwork.hpp"
+#include "algorithms/SimdPartition.hpp"
+
+namespace {
+    // The split compresses the masked lanes to the bottom and the others
+    // after them, so the same vector serves both ends
+    struct Avx512Int32 {
+        using Key = int32_t;
+        using Vec = __m512i;
+        static constexpr SortIndex kLanes = 16;
+
+        static Vec load(const Key* p) { return _mm512_loadu_si512(p); }
+        static void store(Key* p, Vec v) { _mm512_storeu_si512(p, v); }
+        static Vec broadcast(Key k) { return _mm512_set1_epi32(k); }
+        static uint32_t lessMask(Vec keys, Vec pivots) { return _mm512_cmplt_epi32_mask(keys, pivots); }
+        static SortIndex count(uint32_t mask) { return popCount(mask); }
+        static Vec split(Vec keys, uint32_t mask) {
+            const __mmask16 smaller = static_cast<__mmask16>(mask);
+            const __mmask16 upper = static_cast<__mmask16>(0xFFFFu << popCount(mask));
+            return _mm512_mask_expand_epi32(_mm512_maskz_compress_epi32(smaller, keys), upper,
+                                            _mm512_maskz_compress_epi32(static_cast<__mmask16>(~smaller), keys));
+        }
+
+        static Vec min(Vec a, Vec b) { return _mm512_min_epi32(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm512_max_epi32(a, b); }
+        template <int X>
+        static Vec permuteXor(Vec v) {
+            return _mm512_permutexvar_epi32(_mm512_setr_epi32(0 ^ X, 1 ^ X, 2 ^ X, 3 ^ X, 4 ^ X, 5 ^ X, 6 ^ X, 7 ^ X,
+                                                              8 ^ X, 9 ^ X, 10 ^ X, 11 ^ X, 12 ^ X, 13 ^ X, 14 ^ X, 15 ^ X), v);
+        }
+        template <int Bit>
+        static Vec blendHigh(Vec low, Vec high) {
+            return _mm512_mask_blend_epi32(static_cast<__mmask16>(laneMask(16, Bit, 1)), low, high);
+        }
+    };
+
+    struct Avx512Int64 {
+        using Key = int64_t;
+        using Vec = __m512i;
+        static constexpr SortIndex kLanes = 8;
+
+        static Vec load(const Key* p) { return _mm512_loadu_si512(p); }
+        static void store(Key* p, Vec v) { _mm512_storeu_si512(p, v); }
+        static Vec broadcast(Key k) { return _mm512_set1_epi64(k); }
+        static uint32_t lessMask(Vec keys, Vec pivots) { return _mm512_cmplt_epi64_mask(keys, pivots); }
+        static SortIndex count(uint32_t mask) { return popCount(mask); }
+        static Vec split(Vec keys, uint32_t mask) {
+            const __mmask8 smaller = static_cast<__mmask8>(mask);
+            const __mmask8 upper = static_cast<__mmask8>(0xFFu << popCount(mask));
+            return _mm512_mask_expand_epi64(_mm512_maskz_compress_epi64(smaller, keys), upper,
+                                            _mm512_maskz_compress_epi64(static_cast<__mmask8>(~smaller), keys));
+        }
+
+        static Vec min(Vec a, Vec b) { return _mm512_min_epi64(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm512_max_epi64(a, b); }
+        template <int X>
+        static Vec permuteXor(Vec v) {
+            return _mm512_permutexvar_epi64(_mm512_setr_epi64(0 ^ X, 1 ^ X, 2 ^ X, 3 ^ X, 4 ^ X, 5 ^ X, 6 ^ X, 7 ^ X), v);
+        }
+        template <int Bit>
+        static Vec blendHigh(Vec low, Vec high) {
+            return _mm512_mask_blend_epi64(static_cast<__mmask8>(laneMask(8, Bit, 1)), low, high);
+        }
+    };
+}
+
+namespace simd {
+
+SortIndex avx512Partition(int32_t* data, SortIndex begin, SortIndex end, int32_t pivot) {
+    return partitionWith<Avx512Int32>(data, begin, end, pivot);
+}
+
+SortIndex avx512Partition(int64_t* data, SortIndex begin, SortIndex end, int64_t pivot) {
+    return partitionWith<Avx512Int64>(data, begin, end, pivot);
+}
+
+void avx512SortSmall(int32_t* data, SortIndex n) {
+    sortSmallWith<Avx512Int32, kSortSmallMax>(data, n);
+}
+
+void avx512SortSmall(int64_t* data, SortIndex n) {
+    sortSmallWith<Avx512Int64, kSortSmallMax>(data, n);
+}
+
+void avx512MergeVectors(int32_t* keys) {
+    mergeVectorsWith<Avx512Int32>(keys);
+}
+
+void avx512MergeVectors(int64_t* keys) {
+    mergeVectorsWith<Avx512Int64>(keys);
+}
+
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,7 @@
+#include "algorithms/SortEngine.hpp"
+
+#define SORT_ENGINE_INSTANTIATE(Key)                              \
+    template class SortEngine<Key, std::less<Key>, CountOps>;     \
+    template class SortEngine<Key, std::less<Key>, NoInstrument>;
+SORT_ENGINE_KEY_TYPES(SORT_ENGINE_INSTANTIATE)
+#undef SORT_ENGINE_INSTANTIATE
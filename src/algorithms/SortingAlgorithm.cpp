@@ -1,220 +1,2100 @@
 #include "algorithms/SortingAlgorithm.hpp"
+#include "algorithms/SortEngine.hpp"
+#include "algorithms/kernels/AmericanFlagSort.hpp"
+#include "algorithms/kernels/BlockQuickSort.hpp"
+#include "algorithms/kernels/DualPivotQuickSort.hpp"
+#include "algorithms/kernels/HeapSort.hpp"
+#include "algorithms/kernels/MergeSort.hpp"
+#include "algorithms/kernels/PdqSort.hpp"
+#include "algorithms/kernels/PowerSort.hpp"
+#include "algorithms/kernels/RadixSort.hpp"
+#include "algorithms/kernels/VectorQuickSort.hpp"
 #include <random>
 #include <algorithm>
 #include <chrono>
+#include <numeric>
+
+namespace {
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Batched stepping only looks at the clock once per this many steps
+    constexpr size_t kStepsPerClockCheck = 1024;
+
+    // Step functions touch the array through the same view as the native
+    // kernels, with the counts going straight into the visible state and
+    // every mutation logged for stepping back
+    struct StepInstrument {
+        SortingAlgorithm::AlgorithmState& state;
+        std::vector<int>& aux;
+        UndoLog& undo;
+        BranchPredictor& predictor;
+
+        void onCompare(SortIndex, SortIndex, bool) { state.comparisons++; }
+        void onBranch(bool taken) { state.mispredictions += predictor.mispredicts(taken); }
+        void onSwap(SortIndex i, SortIndex j) {
+            state.swaps++;
+            undo.recordSwap(i, j);
+        }
+        void onRead(SortIndex) {}
+        template <typename Key>
+        void onWrite(SortIndex i, const Key& value) {
+            state.moves++;
+            undo.recordWrite(i, state.array[i], static_cast<int>(value));
+        }
+        void onAuxRead(SortIndex) {}
+        template <typename Key>
+        void onAuxWrite(SortIndex i, const Key& value) {
+            state.moves++;
+            undo.recordAuxWrite(i, aux[i], static_cast<int>(value));
+        }
+        void onScan(SortIndex) { state.scans++; }
+    };
+
+    using StepView = ArrayView<int, std::less<int>, StepInstrument>;
+
+    StepView makeStepView(StepInstrument& instrument) {
+        return StepView(instrument.state.array.data(), static_cast<SortIndex>(instrument.state.array.size()),
+                        std::less<int>(), instrument, instrument.aux.data());
+    }
+
+    // Lanes of the vector quicksort's model: the widest vectors of ints
+    // this CPU partitions with
+    SortIndex vectorLanes() {
+        return simd::vectorLanes<int>(simd::detectIsa());
+    }
+
+    // Times sorting copies of keys natively with each of the quicksorts
+    template <typename Key>
+    SortingAlgorithm::SortTimes timeSorts(const std::vector<Key>& keys) {
+        const auto time = [&keys](auto sort) {
+            std::vector<Key> copy = keys;
+            const auto start = Clock::now();
+            sort(copy.data(), copy.size());
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        };
+        SortEngine<Key, std::less<Key>, NoInstrument> engine;
+        SortingAlgorithm::SortTimes times;
+        times.quickSort = time([&engine](Key* data, size_t size) { engine.quickSort(data, size); });
+        times.stdSort = time([](Key* data, size_t size) { std::sort(data, data + size); });
+        times.vectorQuickSort = time([](Key* data, size_t size) { simd::quickSort(data, size); });
+        return times;
+    }
+
+    // Native kernel behind each algorithm type, with the same operations as
+    // its step function. partial_sort orders the smallest quarter and
+    // nth_element places the median. The counting sorts leave their buckets
+    // and pass traffic in the workspace.
+    template <typename Policy>
+    void runKernel(SortingAlgorithm::AlgorithmType type, std::vector<int>& array,
+                   SortEngine<int, std::less<int>, Policy>& engine,
+                   unsigned radixBits, kernels::RadixWorkspace& radix) {
+        using AlgorithmType = SortingAlgorithm::AlgorithmType;
+        switch (type) {
+            case AlgorithmType::QUICK_SORT: engine.quickSort(array.data(), array.size()); break;
+            case AlgorithmType::BUBBLE_SORT: engine.bubbleSort(array.data(), array.size()); break;
+            case AlgorithmType::MERGE_SORT: engine.mergeSort(array.data(), array.size()); break;
+            case AlgorithmType::HEAP_SORT: engine.heapSort(array.data(), array.size()); break;
+            case AlgorithmType::STD_SORT: engine.stdSort(array.data(), array.size()); break;
+            case AlgorithmType::STD_STABLE_SORT: engine.stdStableSort(array.data(), array.size()); break;
+            case AlgorithmType::STD_PARTIAL_SORT: engine.stdPartialSort(array.data(), array.size(), array.size() / 4); break;
+            case AlgorithmType::STD_NTH_ELEMENT: engine.stdNthElement(array.data(), array.size(), array.size() / 2); break;
+            case AlgorithmType::STD_HEAP_SORT: engine.stdHeapSort(array.data(), array.size()); break;
+            case AlgorithmType::BOTTOM_UP_HEAP_SORT: engine.bottomUpHeapSort(array.data(), array.size()); break;
+            case AlgorithmType::COUNTING_SORT: engine.countingSort(array.data(), array.size(), radix); break;
+            case AlgorithmType::RADIX_SORT: engine.radixSort(array.data(), array.size(), radixBits, radix); break;
+            case AlgorithmType::AMERICAN_FLAG_SORT: engine.americanFlagSort(array.data(), array.size(), radix); break;
+            case AlgorithmType::PDQ_SORT: engine.pdqSort(array.data(), array.size()); break;
+            case AlgorithmType::BLOCK_QUICK_SORT: engine.blockQuickSort(array.data(), array.size()); break;
+            case AlgorithmType::VECTOR_QUICK_SORT: engine.vectorQuickSort(array.data(), array.size(), vectorLanes()); break;
+            case AlgorithmType::NETWORK_SORT: engine.networkMergeSort(array.data(), array.size()); break;
+            case AlgorithmType::POWER_SORT: engine.powerSort(array.data(), array.size()); break;
+            case AlgorithmType::DUAL_PIVOT_QUICK_SORT: engine.dualPivotQuickSort(array.data(), array.size()); break;
+        }
+    }
+}
 
 SortingAlgorithm::SortingAlgorithm(size_t size) 
-    : m_speed(1.0f)
+    : m_currentAlgorithm(AlgorithmType::QUICK_SORT)
+    , m_inputPattern(InputPattern::SHUFFLED)
+    , m_speed(60.0f)
     , m_finished(false)
+    , m_trackHighlights(true)
+    , m_pendingSteps(0.0)
+    , m_stepsTaken(0)
+    , m_maxValue(0)
+    , m_partitionRange{0, 0, 0}
+    , m_mergeWidth(0)
+    , m_mergeBegin(0)
+    , m_mergeMid(0)
+    , m_mergeEnd(0)
+    , m_mergeToAux(false)
+    , m_heapRoot(0)
+    , m_heapCarry(0)
+    , m_radixBits(8)
+    , m_radixDigit(0)
+    , m_radixFromAux(false)
+    , m_radixMinKey(0)
+    , m_radixRange{0, 0, 0}
+    , m_radixBucket(0)
+    , m_pdqStep(0)
+    , m_pdqPasses(0)
+    , m_pdqScanning(false)
+    , m_pdqMoves(0)
+    , m_blockStep(0)
+    , m_vectorLanes(0)
+    , m_vectorStep(0)
+    , m_dualPartitioning(false)
+    , m_playback(false)
+    , m_playbackChunk(0)
+    , m_playbackOperation(0)
+    , m_lastVisible{trace::OpCode::READ, false, 0, 0}
+    , m_traceCorrupt(false)
     , m_currentIndex(0)
     , m_compareIndex(0)
     , m_partitionIndex(0)
 {
-    m_state.array.resize(size);
+    resize(size);
+}
+
+void SortingAlgorithm::resize(size_t size) {
+    size = std::min(size, kMaxSize);
+    if (size < m_state.array.size()) {
+        // Give the memory back when going down from a large input
+        std::vector<int>(size).swap(m_state.array);
+    } else {
+        m_state.array.resize(size);
+    }
     reset();
-    setAlgorithm(AlgorithmType::QUICK_SORT);
 }
 
 void SortingAlgorithm::reset() {
-    for (size_t i = 0; i < m_state.array.size(); ++i) {
-        m_state.array[i] = static_cast<int>(i);
+    auto& a = m_state.array;
+    std::iota(a.begin(), a.end(), 0);
+    m_maxValue = a.empty() ? 0 : static_cast<int>(a.size() - 1);
+    switch (m_inputPattern) {
+        case InputPattern::SHUFFLED:
+            shuffle();
+            break;
+        case InputPattern::SORTED:
+            break;
+        case InputPattern::REVERSED:
+            std::reverse(a.begin(), a.end());
+            break;
+        case InputPattern::ORGAN_PIPE:
+            // Even keys rising, then odd keys falling
+            for (size_t i = 0; i < a.size(); ++i) {
+                a[i] = static_cast<int>(i < (a.size() + 1) / 2 ? 2 * i : 2 * (a.size() - 1 - i) + 1);
+            }
+            break;
+        case InputPattern::APPENDED:
+            // A sorted log with a thirty-second of its keys arriving late
+            shuffle();
+            std::sort(a.begin(), a.end() - static_cast<std::ptrdiff_t>(a.size() / 32));
+            break;
+    }
+    restart();
+}
+
+void SortingAlgorithm::setInputPattern(InputPattern pattern) {
+    m_inputPattern = pattern;
+    reset();
+}
+
+const char* SortingAlgorithm::getInputPatternName(InputPattern pattern) {
+    switch (pattern) {
+        case InputPattern::SHUFFLED: return "Shuffled";
+        case InputPattern::SORTED: return "Sorted";
+        case InputPattern::REVERSED: return "Reversed";
+        case InputPattern::ORGAN_PIPE: return "Organ Pipe";
+        case InputPattern::APPENDED: return "Sorted + Appends";
+        default: return "Unknown";
     }
-    m_state.comparisons = 0;
-    m_state.swaps = 0;
-    m_state.timeElapsed = 0;
-    m_state.highlightIndices.clear();
-    shuffle();
 }
 
 void SortingAlgorithm::shuffle() {
     std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937_64 gen(rd());
     std::shuffle(m_state.array.begin(), m_state.array.end(), gen);
     m_finished = false;
 }
 
 void SortingAlgorithm::setAlgorithm(AlgorithmType type) {
     m_currentAlgorithm = type;
+    restart();
+}
+
+void SortingAlgorithm::setRadixBits(unsigned bits) {
+    m_radixBits = bits;
+    if (m_currentAlgorithm == AlgorithmType::RADIX_SORT) restart();
+}
+
+void SortingAlgorithm::restart() {
+    // Only the algorithms that need the aux buffer and buckets size them in
+    // their init
+    std::vector<int>().swap(m_auxArray);
+    m_radix = kernels::RadixWorkspace();
+    m_playback = false;
+    m_trace = trace::OperationTrace();
+    m_traceFile.close();
+    m_playbackChunk = 0;
+    m_playbackState = trace::DecoderState();
+    m_playbackOperation = 0;
+    m_lastVisible = trace::Operation{trace::OpCode::READ, false, 0, 0};
+    m_traceCorrupt = false;
+    m_keyframes.reset(m_state.array.size());
+    m_undo.clear();
+
+    m_state.comparisons = 0;
+    m_state.swaps = 0;
+    m_state.moves = 0;
+    m_state.mispredictions = 0;
+    m_state.scans = 0;
+    m_state.timeElapsed = 0;
+    m_state.nativeTime = 0;
+    m_state.highlights.clear();
     m_finished = false;
+    m_pendingSteps = 0.0;
+    m_stepsTaken = 0;
+    m_coroutine.reset();
+    m_rangeCoroutine.reset();
+    m_predictor = BranchPredictor();
+    m_vectorLanes = vectorLanes();
+    m_network = NetworkProgress();
+    m_dual = kernels::DualPartition();
+    m_dualPartitioning = false;
     m_currentIndex = 0;
     m_compareIndex = 0;
     m_partitionIndex = 0;
     
-    switch (type) {
+    switch (m_currentAlgorithm) {
         case AlgorithmType::QUICK_SORT:
+        case AlgorithmType::PDQ_SORT:
+        case AlgorithmType::BLOCK_QUICK_SORT:
+        case AlgorithmType::VECTOR_QUICK_SORT:
+        case AlgorithmType::DUAL_PIVOT_QUICK_SORT:
             initQuickSort();
             break;
         case AlgorithmType::MERGE_SORT:
+        case AlgorithmType::NETWORK_SORT:
             initMergeSort();
             break;
+        case AlgorithmType::POWER_SORT:
+            initPowerSort();
+            break;
         case AlgorithmType::BUBBLE_SORT:
             initBubbleSort();
             break;
         case AlgorithmType::HEAP_SORT:
+        case AlgorithmType::BOTTOM_UP_HEAP_SORT:
             initHeapSort();
             break;
+        case AlgorithmType::COUNTING_SORT:
+        case AlgorithmType::RADIX_SORT:
+        case AlgorithmType::AMERICAN_FLAG_SORT:
+            initRadixSort();
+            break;
+        default:
+            break;
     }
 }
 
 bool SortingAlgorithm::step() {
     if (m_finished) return false;
 
-    auto start = std::chrono::high_resolution_clock::now();
+    auto start = Clock::now();
+    bool result = stepOnce();
+    auto end = Clock::now();
+    m_state.timeElapsed += std::chrono::duration<double>(end - start).count();
     
+    return result;
+}
+
+size_t SortingAlgorithm::stepN(size_t count) {
+    if (m_finished || count == 0) return 0;
+
+    auto start = Clock::now();
+
+    // Only the last step of the batch is ever seen, so skip the others' highlights
+    m_trackHighlights = false;
+    size_t executed = runBatch(count - 1);
+    m_trackHighlights = true;
+    if (executed == count - 1 && !m_finished && stepOnce()) {
+        ++executed;
+    }
+
+    auto end = Clock::now();
+    m_state.timeElapsed += std::chrono::duration<double>(end - start).count();
+
+    return executed;
+}
+
+size_t SortingAlgorithm::stepFor(double budgetSeconds, size_t maxSteps) {
+    if (m_finished || maxSteps == 0) return 0;
+
+    const auto start = Clock::now();
+    const auto deadline = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(budgetSeconds));
+
+    size_t executed = 0;
+    auto now = start;
+    m_trackHighlights = false;
+    while (!m_finished && executed + 1 < maxSteps && now < deadline) {
+        const size_t chunk = std::min(kStepsPerClockCheck, maxSteps - 1 - executed);
+        const size_t done = runBatch(chunk);
+        executed += done;
+        now = Clock::now();
+        if (done < chunk) break;
+    }
+    m_trackHighlights = true;
+    if (!m_finished && stepOnce()) {
+        ++executed;
+    }
+
+    m_state.timeElapsed += std::chrono::duration<double>(Clock::now() - start).count();
+
+    return executed;
+}
+
+size_t SortingAlgorithm::advance(double deltaSeconds, double budgetSeconds) {
+    if (m_finished) {
+        m_pendingSteps = 0.0;
+        return 0;
+    }
+
+    m_pendingSteps += static_cast<double>(m_speed) * deltaSeconds;
+    if (m_pendingSteps < 1.0) return 0;
+
+    const size_t wanted = m_pendingSteps >= static_cast<double>(SIZE_MAX)
+        ? SIZE_MAX
+        : static_cast<size_t>(m_pendingSteps);
+    const size_t executed = stepFor(budgetSeconds, wanted);
+
+    // Steps that did not fit in the budget are dropped instead of carried over,
+    // otherwise one slow frame snowballs into ever larger batches
+    m_pendingSteps = executed < wanted ? 0.0 : m_pendingSteps - static_cast<double>(wanted);
+
+    return executed;
+}
+
+bool SortingAlgorithm::stepOnce() {
     bool result = false;
-    switch (m_currentAlgorithm) {
-        case AlgorithmType::QUICK_SORT:
-            result = stepQuickSort();
-            break;
-        case AlgorithmType::MERGE_SORT:
-            result = stepMergeSort();
-            break;
-        case AlgorithmType::BUBBLE_SORT:
-            result = stepBubbleSort();
+    if (m_undo.depth() > 0) {
+        result = redoStep();
+        m_stepsTaken++;
+        return result;
+    }
+
+    m_undo.beginStep(stepState());
+    if (m_playback) {
+        result = stepPlayback();
+    } else switch (m_currentAlgorithm) {
+        case AlgorithmType::QUICK_SORT: result = stepQuickSort(); break;
+        case AlgorithmType::MERGE_SORT: result = stepMergeSort(); break;
+        case AlgorithmType::BUBBLE_SORT: result = stepBubbleSort(); break;
+        case AlgorithmType::HEAP_SORT: result = stepHeapSort(); break;
+        case AlgorithmType::BOTTOM_UP_HEAP_SORT: result = stepBottomUpHeapSort(); break;
+        case AlgorithmType::COUNTING_SORT:
+            result = m_radix.digitBits == 0 ? stepCountingSort() : stepRadixSort();
             break;
-        case AlgorithmType::HEAP_SORT:
-            result = stepHeapSort();
+        case AlgorithmType::RADIX_SORT: result = stepRadixSort(); break;
+        case AlgorithmType::AMERICAN_FLAG_SORT: result = stepAmericanFlagSort(); break;
+        case AlgorithmType::PDQ_SORT: result = stepPdqSort(); break;
+        case AlgorithmType::BLOCK_QUICK_SORT: result = stepBlockQuickSort(); break;
+        case AlgorithmType::VECTOR_QUICK_SORT: result = stepVectorQuickSort(); break;
+        case AlgorithmType::NETWORK_SORT: result = stepNetworkSort(); break;
+        case AlgorithmType::POWER_SORT: result = stepPowerSort(); break;
+        case AlgorithmType::DUAL_PIVOT_QUICK_SORT: result = stepDualPivotQuickSort(); break;
+        default: result = stepStdAlgorithm(); break;
+    }
+    if (!result) m_undo.discardStep();
+    m_stepsTaken += result ? 1 : 0;
+    return result;
+}
+
+template <bool (SortingAlgorithm::*Step)()>
+size_t SortingAlgorithm::runSteps(size_t count) {
+    size_t executed = 0;
+    while (executed < count && m_undo.depth() > 0 && redoStep()) {
+        ++executed;
+    }
+
+    // Only the last kStepCapacity steps of a batch could ever be stepped
+    // back to, so the ones before them skip the undo log
+    if (count - executed > UndoLog::kStepCapacity) {
+        const size_t unlogged = count - executed - UndoLog::kStepCapacity;
+        size_t done = 0;
+        m_undo.suspend();
+        while (done < unlogged && (this->*Step)()) {
+            ++done;
+        }
+        m_undo.resume();
+        executed += done;
+        if (done < unlogged) {
+            m_stepsTaken += executed;
+            return executed;
+        }
+    }
+
+    while (executed < count) {
+        m_undo.beginStep(stepState());
+        if (!(this->*Step)()) {
+            m_undo.discardStep();
             break;
+        }
+        ++executed;
     }
+    m_stepsTaken += executed;
+    return executed;
+}
 
-    auto end = std::chrono::high_resolution_clock::now();
-    m_state.timeElapsed += std::chrono::duration<double>(end - start).count();
-    
-    return result;
+UndoLog::StepState SortingAlgorithm::stepState() const {
+    UndoLog::StepState state{
+        m_state.comparisons,
+        m_state.swaps,
+        m_state.moves,
+        m_state.mispredictions,
+        m_state.scans,
+        m_predictor,
+        m_currentIndex,
+        m_compareIndex,
+        m_partitionIndex,
+        m_dual,
+        m_dualPartitioning,
+        m_finished,
+        m_network,
+        m_power.runsFound,
+        m_power.runCount,
+        m_power.minGallop,
+        {},
+        static_cast<uint8_t>(std::min(m_radix.passBytes.size(), UndoLog::kPassCapacity)),
+        m_playbackOperation,
+        m_lastVisible
+    };
+    std::copy_n(m_radix.passBytes.begin(), state.passCount, state.passBytes);
+    return state;
 }
 
-std::string SortingAlgorithm::getAlgorithmName() const {
+void SortingAlgorithm::restoreStepState(const UndoLog::StepState& state) {
+    m_state.comparisons = state.comparisons;
+    m_state.swaps = state.swaps;
+    m_state.moves = state.moves;
+    m_state.mispredictions = state.mispredictions;
+    m_state.scans = state.scans;
+    m_predictor = state.predictor;
+    m_currentIndex = state.currentIndex;
+    m_compareIndex = state.compareIndex;
+    m_partitionIndex = state.partitionIndex;
+    m_dual = state.dual;
+    m_dualPartitioning = state.dualPartitioning;
+    m_finished = state.finished;
+    m_network = state.network;
+    m_power.runsFound = state.powerRunsFound;
+    m_power.runCount = state.powerRunCount;
+    m_power.minGallop = state.powerMinGallop;
+    m_radix.passBytes.assign(state.passBytes, state.passBytes + state.passCount);
+    m_playbackOperation = state.playbackOperation;
+    m_lastVisible = state.lastVisible;
+}
+
+bool SortingAlgorithm::redoStep() {
+    restoreStepState(m_undo.redo(m_state.array, m_auxArray));
+    if (m_trackHighlights) {
+        m_state.highlights.clear();
+        m_undo.highlightNextUndo(m_state.highlights);
+    }
+    return true;
+}
+
+void SortingAlgorithm::redoAll() {
+    while (m_undo.depth() > 0) {
+        restoreStepState(m_undo.redo(m_state.array, m_auxArray));
+    }
+}
+
+size_t SortingAlgorithm::stepBack(size_t count) {
+    size_t executed = 0;
+    while (executed < count && m_undo.canUndo()) {
+        restoreStepState(m_undo.undo(m_state.array, m_auxArray, stepState()));
+        ++executed;
+    }
+
+    // Show what stepping forward would change back
+    if (executed > 0) {
+        m_state.highlights.clear();
+        m_undo.highlightNextRedo(m_state.highlights);
+    }
+    return executed;
+}
+
+size_t SortingAlgorithm::rewind(double deltaSeconds) {
+    m_pendingSteps += static_cast<double>(m_speed) * deltaSeconds;
+    if (m_pendingSteps < 1.0) return 0;
+
+    const size_t wanted = m_pendingSteps >= static_cast<double>(SIZE_MAX)
+        ? SIZE_MAX
+        : static_cast<size_t>(m_pendingSteps);
+    m_pendingSteps -= static_cast<double>(wanted);
+    const size_t executed = stepBack(wanted);
+    if (executed < wanted) m_pendingSteps = 0.0;
+    return executed;
+}
+
+// Dispatches once and then loops on the algorithm's step function directly
+size_t SortingAlgorithm::runBatch(size_t count) {
+    if (m_playback) return runSteps<&SortingAlgorithm::stepPlayback>(count);
+
     switch (m_currentAlgorithm) {
+        case AlgorithmType::QUICK_SORT: return runSteps<&SortingAlgorithm::stepQuickSort>(count);
+        case AlgorithmType::MERGE_SORT: return runSteps<&SortingAlgorithm::stepMergeSort>(count);
+        case AlgorithmType::BUBBLE_SORT: return runSteps<&SortingAlgorithm::stepBubbleSort>(count);
+        case AlgorithmType::HEAP_SORT: return runSteps<&SortingAlgorithm::stepHeapSort>(count);
+        case AlgorithmType::BOTTOM_UP_HEAP_SORT: return runSteps<&SortingAlgorithm::stepBottomUpHeapSort>(count);
+        case AlgorithmType::COUNTING_SORT:
+            return m_radix.digitBits == 0 ? runSteps<&SortingAlgorithm::stepCountingSort>(count)
+                                          : runSteps<&SortingAlgorithm::stepRadixSort>(count);
+        case AlgorithmType::RADIX_SORT: return runSteps<&SortingAlgorithm::stepRadixSort>(count);
+        case AlgorithmType::AMERICAN_FLAG_SORT: return runSteps<&SortingAlgorithm::stepAmericanFlagSort>(count);
+        case AlgorithmType::PDQ_SORT: return runSteps<&SortingAlgorithm::stepPdqSort>(count);
+        case AlgorithmType::BLOCK_QUICK_SORT: return runSteps<&SortingAlgorithm::stepBlockQuickSort>(count);
+        case AlgorithmType::VECTOR_QUICK_SORT: return runSteps<&SortingAlgorithm::stepVectorQuickSort>(count);
+        case AlgorithmType::NETWORK_SORT: return runSteps<&SortingAlgorithm::stepNetworkSort>(count);
+        case AlgorithmType::POWER_SORT: return runSteps<&SortingAlgorithm::stepPowerSort>(count);
+        case AlgorithmType::DUAL_PIVOT_QUICK_SORT: return runSteps<&SortingAlgorithm::stepDualPivotQuickSort>(count);
+        default: return runSteps<&SortingAlgorithm::stepStdAlgorithm>(count);
+    }
+    return 0;
+}
+
+void SortingAlgorithm::runToCompletion() {
+    if (m_finished) return;
+
+    // The native loops start from scratch, so a run that is already under way
+    // is finished by stepping to keep its metrics consistent
+    if (m_stepsTaken > 0) {
+        m_trackHighlights = false;
+        auto start = Clock::now();
+        runBatch(SIZE_MAX);
+        m_state.timeElapsed += std::chrono::duration<double>(Clock::now() - start).count();
+        m_trackHighlights = true;
+    } else {
+        SortEngine<int, std::less<int>, SimulateBranches> engine;
+        auto start = Clock::now();
+        runKernel(m_currentAlgorithm, m_state.array, engine, m_radixBits, m_radix);
+        m_state.nativeTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+        m_state.comparisons += engine.getPolicy().comparisons;
+        m_state.swaps += engine.getPolicy().swaps;
+        m_state.moves += engine.getPolicy().writes + engine.getPolicy().auxWrites;
+        m_state.mispredictions += engine.getPolicy().mispredictions;
+        m_state.scans += engine.getPolicy().scans;
+    }
+
+    m_state.highlights.clear();
+    m_undo.clear();
+    m_finished = true;
+}
+
+double SortingAlgorithm::timeUninstrumented() const {
+    // A workspace of its own keeps the run's buckets and pass traffic intact
+    std::vector<int> copy = m_state.array;
+    kernels::RadixWorkspace radix;
+    SortEngine<int, std::less<int>, NoInstrument> engine;
+    const auto start = Clock::now();
+    runKernel(m_currentAlgorithm, copy, engine, m_radixBits, radix);
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+SortingAlgorithm::SimdBenchmark SortingAlgorithm::benchmarkSimd() const {
+    SimdBenchmark benchmark;
+    benchmark.isa = simd::detectIsa();
+    benchmark.keys32 = timeSorts(std::vector<int32_t>(m_state.array.begin(), m_state.array.end()));
+    benchmark.keys64 = timeSorts(std::vector<int64_t>(m_state.array.begin(), m_state.array.end()));
+    return benchmark;
+}
+
+void SortingAlgorithm::recordRun() {
+    restart();
+    recordTrace();
+}
+
+void SortingAlgorithm::recordTrace() {
+    using Recorder = trace::KeyframeRecorder<trace::OperationTrace>;
+    std::vector<int> scratch = m_state.array;
+    SortEngine<int, std::less<int>, RecordTraceTo<Recorder>> engine(
+        std::less<int>(), RecordTraceTo<Recorder>(Recorder(trace::OperationTrace(), scratch.data(), scratch.size(), m_auxArray, m_keyframes)));
+    runKernel(m_currentAlgorithm, scratch, engine, m_radixBits, m_radix);
+
+    m_trace = std::move(engine.getPolicy().trace.sink());
+    m_trace.shrinkToFit();
+    m_playback = true;
+}
+
+bool SortingAlgorithm::recordRunToFile(const std::string& path) {
+    restart();
+
+    trace::TraceFileWriter writer;
+    if (!writer.open(path, m_state.array, static_cast<uint32_t>(m_currentAlgorithm))) return false;
+
+    // Opening the file restarts, so keyframes are collected on the side
+    using Recorder = trace::KeyframeRecorder<trace::TraceFileWriter>;
+    trace::KeyframeIndex keyframes = m_keyframes;
+    std::vector<int> scratch = m_state.array;
+    SortEngine<int, std::less<int>, RecordTraceTo<Recorder>> engine(
+        std::less<int>(), RecordTraceTo<Recorder>(Recorder(std::move(writer), scratch.data(), scratch.size(), m_auxArray, keyframes)));
+    runKernel(m_currentAlgorithm, scratch, engine, m_radixBits, m_radix);
+    std::vector<int>().swap(scratch);
+
+    if (!engine.getPolicy().trace.sink().finish() || !openTrace(path)) return false;
+    m_keyframes = std::move(keyframes);
+    return true;
+}
+
+void SortingAlgorithm::setArray(const std::vector<int>& array) {
+    m_state.array.assign(array.begin(), array.begin() + static_cast<std::ptrdiff_t>(std::min(array.size(), kMaxSize)));
+    m_maxValue = m_state.array.empty() ? 0 : *std::max_element(m_state.array.begin(), m_state.array.end());
+    restart();
+}
+
+bool SortingAlgorithm::openTrace(const std::string& path) {
+    trace::TraceFile file;
+    if (!file.open(path)) return false;
+    const auto& header = file.header();
+    if (header.algorithm >= static_cast<uint32_t>(kAlgorithmCount) || header.elementCount > kMaxSize) return false;
+
+    // Nothing changes until the whole file checks out
+    std::vector<int> array;
+    if (!file.readInitialArray(array)) return false;
+
+    m_currentAlgorithm = static_cast<AlgorithmType>(header.algorithm);
+    m_state.array = std::move(array);
+    m_maxValue = m_state.array.empty() ? 0 : *std::max_element(m_state.array.begin(), m_state.array.end());
+    restart();
+
+    m_playback = m_traceFile.open(path);
+    return m_playback;
+}
+
+std::string SortingAlgorithm::getAlgorithmName() const {
+    return getAlgorithmName(m_currentAlgorithm);
+}
+
+const char* SortingAlgorithm::getAlgorithmName(AlgorithmType type) {
+    switch (type) {
         case AlgorithmType::QUICK_SORT: return "Quick Sort";
         case AlgorithmType::MERGE_SORT: return "Merge Sort";
         case AlgorithmType::BUBBLE_SORT: return "Bubble Sort";
         case AlgorithmType::HEAP_SORT: return "Heap Sort";
+        case AlgorithmType::STD_SORT: return "std::sort";
+        case AlgorithmType::STD_STABLE_SORT: return "std::stable_sort";
+        case AlgorithmType::STD_PARTIAL_SORT: return "std::partial_sort (n/4)";
+        case AlgorithmType::STD_NTH_ELEMENT: return "std::nth_element (median)";
+        case AlgorithmType::STD_HEAP_SORT: return "std::make_heap + sort_heap";
+        case AlgorithmType::BOTTOM_UP_HEAP_SORT: return "Heap Sort (bottom-up)";
+        case AlgorithmType::COUNTING_SORT: return "Counting Sort";
+        case AlgorithmType::RADIX_SORT: return "Radix Sort (LSD)";
+        case AlgorithmType::AMERICAN_FLAG_SORT: return "American Flag Sort (MSD)";
+        case AlgorithmType::PDQ_SORT: return "Pattern-Defeating Quicksort";
+        case AlgorithmType::BLOCK_QUICK_SORT: return "BlockQuicksort (branch-free)";
+        case AlgorithmType::VECTOR_QUICK_SORT: return "Vector Quicksort (SIMD)";
+        case AlgorithmType::NETWORK_SORT: return "Sorting Network (smallest known)";
+        case AlgorithmType::POWER_SORT: return "Powersort";
+        case AlgorithmType::DUAL_PIVOT_QUICK_SORT: return "Dual-Pivot Quicksort";
         default: return "Unknown";
     }
 }
 
 // Initialize algorithms
 void SortingAlgorithm::initQuickSort() {
-    m_auxArray = m_state.array;
+    m_partitions.clear();
 }
 
 void SortingAlgorithm::initMergeSort() {
     m_auxArray.resize(m_state.array.size());
 }
 
+// Merges copy only the shorter run aside, which is at most half the keys
+void SortingAlgorithm::initPowerSort() {
+    m_auxArray.resize(m_state.array.size() / 2);
+    kernels::powerSortBegin(m_power, static_cast<SortIndex>(m_state.array.size()));
+}
+
 void SortingAlgorithm::initBubbleSort() {
-    m_currentIndex = 0;
-    m_compareIndex = 0;
 }
 
+// Floyd's construction sifts the inner nodes from n / 2 - 1 down to 0,
+// with the whole array as the heap
 void SortingAlgorithm::initHeapSort() {
-    m_currentIndex = m_state.array.size() / 2 - 1;
+    m_heapRoot = static_cast<SortIndex>(m_state.array.size() / 2);
+    m_partitionIndex = static_cast<SortIndex>(m_state.array.size());
+    m_heapCarry = 0;
 }
 
-// Step implementations
-bool SortingAlgorithm::stepBubbleSort() {
-    if (m_currentIndex >= m_state.array.size() - 1) {
-        m_finished = true;
-        return false;
+// The buckets are set up front, which for counting sort means finding the
+// key range; a range too wide for it gets 16-bit radix passes, as natively.
+// American flag sort sorts in place and needs no aux buffer.
+void SortingAlgorithm::initRadixSort() {
+    m_radixDigit = 0;
+    m_radixFromAux = false;
+    m_radixMinKey = 0;
+    m_radixRange = kernels::RadixRange{0, 0, 0};
+    m_radixBucket = 0;
+    if (m_currentAlgorithm == AlgorithmType::AMERICAN_FLAG_SORT) {
+        kernels::flagBegin<int>(m_radix, static_cast<SortIndex>(m_state.array.size()));
+        return;
     }
 
-    m_state.highlightIndices = {m_currentIndex, m_currentIndex + 1};
-    
-    if (m_state.array[m_currentIndex] > m_state.array[m_currentIndex + 1]) {
-        std::swap(m_state.array[m_currentIndex], m_state.array[m_currentIndex + 1]);
-        m_state.swaps++;
+    m_auxArray.resize(m_state.array.size());
+
+    if (m_currentAlgorithm == AlgorithmType::COUNTING_SORT) {
+        uint64_t maxKey;
+        kernels::radixKeyRange(m_state.array.data(), m_state.array.size(), m_radixMinKey, maxKey);
+        if (kernels::countingRangeFits(m_radixMinKey, maxKey, m_state.array.size())) {
+            kernels::countingBegin(m_radix, m_radixMinKey, maxKey);
+            return;
+        }
+        kernels::radixBegin<int>(m_radix, 16);
+    } else {
+        kernels::radixBegin<int>(m_radix, m_radixBits);
     }
-    m_state.comparisons++;
-    
-    m_currentIndex++;
-    if (m_currentIndex >= m_state.array.size() - m_compareIndex - 1) {
-        m_currentIndex = 0;
-        m_compareIndex++;
+}
+
+const SortIndex* SortingAlgorithm::getBuckets(size_t& count) const {
+    if (m_playback || m_radix.buckets.empty()) {
+        count = 0;
+        return nullptr;
     }
-    
-    return true;
+    if (m_radix.digitBits == 0) {
+        count = m_radix.buckets.size();
+        return m_radix.buckets.data();
+    }
+    if (m_currentAlgorithm == AlgorithmType::AMERICAN_FLAG_SORT) {
+        count = kernels::kFlagBucketCount;
+        return m_radix.buckets.data();
+    }
+    const unsigned digit = std::min(m_radixDigit, m_radix.digitCount - 1);
+    count = size_t(1) << m_radix.digitBits;
+    return m_radix.buckets.data() + count * digit;
+}
+
+// Step implementations
+bool SortingAlgorithm::stepBubbleSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+    const SortIndex n = a.size();
+
+    CO_BEGIN(m_coroutine);
+    for (m_compareIndex = 0; m_compareIndex < n - 1; ++m_compareIndex) {
+        for (m_currentIndex = 0; m_currentIndex < n - m_compareIndex - 1; ++m_currentIndex) {
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_currentIndex, HighlightRole::COMPARE},
+                    {m_currentIndex + 1, HighlightRole::COMPARE}
+                });
+            }
+
+            if (a.less(m_currentIndex + 1, m_currentIndex)) {
+                a.swap(m_currentIndex, m_currentIndex + 1);
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
 }
 
 bool SortingAlgorithm::stepQuickSort() {
-    if (m_state.array.empty()) return false;
-    
-    // Initialize partition range
-    if (m_auxArray.empty()) {
-        m_auxArray.push_back(0);  // left boundary
-        m_auxArray.push_back(m_state.array.size() - 1);  // right boundary
-        m_currentIndex = m_auxArray[0];  // pivot index
-        m_compareIndex = m_currentIndex + 1;  // scanning index
-        m_partitionIndex = m_currentIndex;  // final pivot position
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    if (a.size() > 1) {
+        m_partitions.push(0, a.size() - 1);
     }
-    
-    // If we've completed the current partition
-    if (m_compareIndex > m_auxArray[1]) {
+
+    while (!m_partitions.empty()) {
+        // Lomuto partition of the next pending range around its first element
+        m_partitionRange = m_partitions.pop();
+        m_currentIndex = m_partitionRange.left;  // pivot index
+        m_partitionIndex = m_currentIndex;  // final pivot position
+        for (m_compareIndex = m_currentIndex + 1; m_compareIndex <= m_partitionRange.right; ++m_compareIndex) {
+            a.scan(m_compareIndex);
+            if (a.less(m_compareIndex, m_currentIndex)) {
+                a.scan(++m_partitionIndex);
+                if (m_partitionIndex != m_compareIndex) {
+                    a.swap(m_partitionIndex, m_compareIndex);
+                }
+            }
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_currentIndex, HighlightRole::PIVOT},
+                    {m_compareIndex, HighlightRole::COMPARE},
+                    {m_partitionIndex, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
         // Swap pivot to its final position
         if (m_currentIndex != m_partitionIndex) {
-            std::swap(m_state.array[m_currentIndex], m_state.array[m_partitionIndex]);
-            m_state.swaps++;
-            
-            // Update visualization state
-            m_state.highlightIndices = {m_currentIndex, m_partitionIndex};
-            return true;
-        }
-        
-        // Push sub-partitions onto stack
-        int pivotPos = m_partitionIndex;
-        if (pivotPos - 1 > m_auxArray[0]) {  // Left partition
-            m_auxArray.push_back(m_auxArray[0]);
-            m_auxArray.push_back(pivotPos - 1);
-        }
-        if (pivotPos + 1 < m_auxArray[1]) {  // Right partition
-            m_auxArray.push_back(pivotPos + 1);
-            m_auxArray.push_back(m_auxArray[1]);
-        }
-        
-        // Pop current partition
-        m_auxArray.erase(m_auxArray.begin());
-        m_auxArray.erase(m_auxArray.begin());
-        
-        // If no more partitions, we're done
-        if (m_auxArray.empty()) {
-            m_finished = true;
-            return false;
+            a.swap(m_currentIndex, m_partitionIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionIndex, HighlightRole::PIVOT},
+                    {m_currentIndex, HighlightRole::WRITE}
+                });
+            }
+            m_currentIndex = m_partitionIndex;
+            CO_YIELD(m_coroutine, true);
         }
-        
-        // Setup next partition
-        m_currentIndex = m_auxArray[0];
-        m_compareIndex = m_currentIndex + 1;
-        m_partitionIndex = m_currentIndex;
-        
-        // Update visualization state
-        m_state.highlightIndices = {m_currentIndex};
-        return true;
+
+        m_partitions.pushChildren(m_partitionRange, m_partitionIndex);
     }
-    
-    // Compare current element with pivot
-    m_state.comparisons++;
-    if (m_state.array[m_compareIndex] < m_state.array[m_currentIndex]) {
-        m_partitionIndex++;
-        if (m_partitionIndex != m_compareIndex) {
-            std::swap(m_state.array[m_partitionIndex], m_state.array[m_compareIndex]);
-            m_state.swaps++;
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// The standard algorithms cannot be suspended, so their first step records
+// the whole run and every step replays it
+bool SortingAlgorithm::stepStdAlgorithm() {
+    if (!m_playback) recordTrace();
+    return stepPlayback();
+}
+
+// Encoded operations at the playback position: the whole in-memory trace, or
+// the current chunk of the trace file, mapped in as playback reaches it
+const uint8_t* SortingAlgorithm::playbackChunk(size_t& size) {
+    if (!m_traceFile.isOpen()) {
+        size = m_trace.byteSize();
+        return m_trace.data();
+    }
+    if (m_playbackChunk >= m_traceFile.chunkCount()) {
+        size = 0;
+        return nullptr;
+    }
+    size = static_cast<size_t>(m_traceFile.chunkInfo(m_playbackChunk).byteSize);
+    return m_traceFile.mapChunk(m_playbackChunk);
+}
+
+uint64_t SortingAlgorithm::getPlaybackLength() const {
+    return m_traceFile.isOpen() ? m_traceFile.header().operationCount : m_trace.size();
+}
+
+// Applies operations until one is visible (if stopAtVisible) or playback
+// reaches operation `until`; returns false once the trace is exhausted
+bool SortingAlgorithm::playTrace(uint64_t until, bool stopAtVisible) {
+    size_t size = 0;
+    for (const uint8_t* data = playbackChunk(size); data; data = playbackChunk(size)) {
+        // The reader decodes straight into the playback state
+        trace::TraceReader reader(data, size, m_playbackState);
+        trace::Operation op;
+        while (m_playbackOperation < until) {
+            if (m_keyframes.due(m_playbackOperation)) captureKeyframe();
+            if (!reader.next(op) && !reader.failed()) break;
+            if (reader.failed() || !traceOpInBounds(op)) {
+                // Stop rather than decode past the chunk or write outside the array
+                m_traceCorrupt = true;
+                m_finished = true;
+                return false;
+            }
+            m_playbackOperation++;
+            if (applyTraceOp(op)) {
+                m_lastVisible = op;
+                if (stopAtVisible) return true;
+            }
         }
+        if (m_playbackOperation >= until) return true;
+
+        // Only file playback has a next chunk, which decodes from scratch
+        if (!m_traceFile.isOpen()) break;
+        m_playbackChunk++;
+        m_playbackState = trace::DecoderState();
     }
-    
-    // Update visualization state
-    m_state.highlightIndices = {m_currentIndex, m_compareIndex, m_partitionIndex};
-    m_compareIndex++;
+
+    m_finished = true;
+    return false;
+}
+
+bool SortingAlgorithm::stepPlayback() {
+    return playTrace(UINT64_MAX, true);
+}
+
+void SortingAlgorithm::captureKeyframe() {
+    m_keyframes.add(trace::Keyframe{
+        m_playbackOperation,
+        trace::TracePosition{m_playbackChunk, m_playbackState},
+        m_state.comparisons,
+        m_state.swaps,
+        m_state.moves,
+        m_lastVisible,
+        m_state.array,
+        m_state.mispredictions,
+        m_predictor,
+        m_auxArray,
+        m_state.scans
+    });
+}
+
+bool SortingAlgorithm::seek(uint64_t operation) {
+    if (!m_playback) return false;
+    operation = std::min(operation, getPlaybackLength());
+
+    // Seeking moves playback itself, so undone steps are put back first
+    redoAll();
+    m_undo.clear();
+
+    // Keep replaying forward from the current position unless a keyframe
+    // lies between it and the target
+    const trace::Keyframe* keyframe = m_keyframes.find(operation);
+    if (operation < m_playbackOperation || (keyframe && keyframe->operation > m_playbackOperation)) {
+        if (!keyframe) return false;
+        std::copy(keyframe->array.begin(), keyframe->array.end(), m_state.array.begin());
+        m_state.comparisons = keyframe->comparisons;
+        m_state.swaps = keyframe->swaps;
+        m_state.moves = keyframe->moves;
+        m_state.mispredictions = keyframe->mispredictions;
+        m_state.scans = keyframe->scans;
+        m_predictor = keyframe->predictor;
+        m_auxArray = keyframe->aux;
+        m_playbackChunk = static_cast<size_t>(keyframe->position.chunk);
+        m_playbackState = keyframe->position.state;
+        m_playbackOperation = keyframe->operation;
+        m_lastVisible = keyframe->lastVisible;
+    }
+
+    const bool trackHighlights = m_trackHighlights;
+    m_trackHighlights = false;
+    playTrace(operation, false);
+    m_trackHighlights = trackHighlights;
+
+    m_finished = m_traceCorrupt || m_playbackOperation >= getPlaybackLength();
+    highlightTraceOp(m_lastVisible);
+    return true;
+}
+
+// Trace files come from outside, so their indices are checked before any is
+// used. Compares of aux elements report -1 for them; aux writes past the aux
+// buffer are skipped as before.
+bool SortingAlgorithm::traceOpInBounds(const trace::Operation& op) const {
+    const int64_t n = static_cast<int64_t>(m_state.array.size());
+    switch (op.code) {
+        case trace::OpCode::COMPARE:
+            return op.a >= -1 && op.a < n && op.b >= -1 && op.b < n;
+        case trace::OpCode::SWAP:
+            return op.a >= 0 && op.a < n && op.b >= 0 && op.b < n;
+        case trace::OpCode::READ:
+        case trace::OpCode::WRITE:
+            return op.a >= 0 && op.a < n;
+        default:
+            return op.a >= 0;
+    }
+}
+
+// Returns false for operations that change nothing visible, which playback
+// applies without spending a step on them. Traces do not say which compares
+// were branched on, so playback runs all of them through the predictor.
+bool SortingAlgorithm::applyTraceOp(const trace::Operation& op) {
+    auto& a = m_state.array;
+    switch (op.code) {
+        case trace::OpCode::COMPARE:
+            m_state.comparisons++;
+            m_state.mispredictions += m_predictor.mispredicts(op.result);
+            break;
+        case trace::OpCode::SWAP:
+            m_undo.recordSwap(op.a, op.b);
+            std::swap(a[op.a], a[op.b]);
+            m_state.swaps++;
+            break;
+        case trace::OpCode::WRITE:
+            m_undo.recordWrite(op.a, a[op.a], static_cast<int>(op.b));
+            a[op.a] = static_cast<int>(op.b);
+            m_state.moves++;
+            break;
+        case trace::OpCode::AUX_WRITE:
+            // Kept up to date for display, but not a step of its own
+            if (op.a < static_cast<SortIndex>(m_auxArray.size())) {
+                m_undo.recordAuxWrite(op.a, m_auxArray[op.a], static_cast<int>(op.b));
+                m_auxArray[op.a] = static_cast<int>(op.b);
+            }
+            m_state.moves++;
+            return false;
+        default:
+            return false;
+    }
+
+    if (m_trackHighlights) highlightTraceOp(op);
     return true;
 }
 
-// Placeholder implementations for other algorithms
+void SortingAlgorithm::highlightTraceOp(const trace::Operation& op) {
+    switch (op.code) {
+        case trace::OpCode::COMPARE:
+            m_state.highlights.clear();
+            if (op.a >= 0) m_state.highlights.add(op.a, HighlightRole::COMPARE);
+            if (op.b >= 0) m_state.highlights.add(op.b, HighlightRole::COMPARE);
+            break;
+        case trace::OpCode::SWAP:
+            m_state.highlights.assign({
+                {op.a, HighlightRole::WRITE},
+                {op.b, HighlightRole::WRITE}
+            });
+            break;
+        case trace::OpCode::WRITE:
+            m_state.highlights.assign({{op.a, HighlightRole::WRITE}});
+            break;
+        default:
+            m_state.highlights.clear();
+            break;
+    }
+}
+
+// Bottom-up merge sort, one element moved per step; mirrors
+// kernels::mergeSort. currentIndex and compareIndex are the heads of the two
+// runs being merged and partitionIndex is where the next element goes.
 bool SortingAlgorithm::stepMergeSort() {
-    // TODO: Implement merge sort step
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+    const SortIndex n = a.size();
+
+    CO_BEGIN(m_coroutine);
+    m_mergeWidth = 1;
+    if (kernels::mergePassCount(n) % 2 == 1) {
+        for (m_currentIndex = 0; m_currentIndex + 1 < n; m_currentIndex += 2) {
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_currentIndex, HighlightRole::COMPARE},
+                    {m_currentIndex + 1, HighlightRole::COMPARE}
+                });
+            }
+
+            if (a.less(m_currentIndex + 1, m_currentIndex)) {
+                a.swap(m_currentIndex, m_currentIndex + 1);
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        m_mergeWidth = 2;
+    }
+
+    while (stepMergePasses()) {
+        CO_YIELD(m_coroutine, true);
+    }
+    CO_END(m_coroutine);
+
     m_finished = true;
     return false;
 }
 
+// The merge passes of a bottom-up merge sort from runs of mergeWidth up, one
+// element merged per step; mirrors kernels::mergePasses. Like
+// stepHeapSortRange it runs inside its caller's coroutine.
+bool SortingAlgorithm::stepMergePasses() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+    const SortIndex n = a.size();
+
+    CO_BEGIN(m_rangeCoroutine);
+    for (m_mergeToAux = true; m_mergeWidth < n; m_mergeWidth *= 2, m_mergeToAux = !m_mergeToAux) {
+        for (m_mergeBegin = 0; m_mergeBegin < n; m_mergeBegin += 2 * m_mergeWidth) {
+            m_mergeMid = std::min(m_mergeBegin + m_mergeWidth, n);
+            m_mergeEnd = std::min(m_mergeBegin + 2 * m_mergeWidth, n);
+            m_currentIndex = m_mergeBegin;
+            m_compareIndex = m_mergeMid;
+            for (m_partitionIndex = m_mergeBegin; m_partitionIndex < m_mergeEnd; ++m_partitionIndex) {
+                if (kernels::mergeTakesRight(a, !m_mergeToAux, m_currentIndex, m_mergeMid, m_compareIndex, m_mergeEnd)) {
+                    kernels::mergeMove(a, m_mergeToAux, m_partitionIndex, m_compareIndex++);
+                } else {
+                    kernels::mergeMove(a, m_mergeToAux, m_partitionIndex, m_currentIndex++);
+                }
+
+                // Positions in the array: the run heads while merging out of
+                // it, the element just written while merging back into it
+                if (m_trackHighlights) {
+                    m_state.highlights.clear();
+                    if (m_mergeToAux) {
+                        if (m_currentIndex < m_mergeMid) m_state.highlights.add(m_currentIndex, HighlightRole::COMPARE);
+                        if (m_compareIndex < m_mergeEnd) m_state.highlights.add(m_compareIndex, HighlightRole::COMPARE);
+                    } else {
+                        m_state.highlights.add(m_partitionIndex, HighlightRole::WRITE);
+                    }
+                    if (m_mergeMid < m_mergeEnd) m_state.highlights.add(m_mergeMid, HighlightRole::BOUNDARY);
+                }
+                CO_YIELD(m_rangeCoroutine, true);
+            }
+        }
+    }
+    CO_END(m_rangeCoroutine);
+
+    m_rangeCoroutine.reset();
+    return false;
+}
+
+// Heap sort, one sift-down level per step; mirrors kernels::heapSort.
+// heapRoot counts down through Floyd's construction, then each round moves
+// the maximum behind the heap, whose end is partitionIndex.
 bool SortingAlgorithm::stepHeapSort() {
-    // TODO: Implement heap sort step
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    while (true) {
+        if (m_heapRoot > 0) {
+            m_heapRoot--;
+        } else {
+            if (m_partitionIndex <= 1) break;
+            m_partitionIndex--;
+            a.swap(0, m_partitionIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {0, HighlightRole::WRITE},
+                    {m_partitionIndex, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        for (m_currentIndex = m_heapRoot; m_currentIndex >= 0 && 2 * m_currentIndex + 1 < m_partitionIndex;
+             m_currentIndex = m_compareIndex) {
+            m_compareIndex = kernels::siftDownStep(a, m_currentIndex, m_partitionIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.clear();
+                m_state.highlights.add(m_currentIndex, HighlightRole::COMPARE);
+                if (m_compareIndex >= 0) m_state.highlights.add(m_compareIndex, HighlightRole::COMPARE);
+                m_state.highlights.add(m_heapRoot, HighlightRole::PIVOT);
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// Heap sort with Wegener's bottom-up sift-down; mirrors
+// kernels::bottomUpHeapSort. A sift takes a step per level on the way down
+// to a leaf, one per level climbed back up, and one per element shifted.
+bool SortingAlgorithm::stepBottomUpHeapSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    while (true) {
+        if (m_heapRoot > 0) {
+            m_heapRoot--;
+        } else {
+            if (m_partitionIndex <= 1) break;
+            m_partitionIndex--;
+            a.swap(0, m_partitionIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {0, HighlightRole::WRITE},
+                    {m_partitionIndex, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        for (m_currentIndex = m_heapRoot;
+             (m_compareIndex = kernels::heapLargerChild(a, m_currentIndex, m_partitionIndex)) >= 0;
+             m_currentIndex = m_compareIndex) {
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_compareIndex, HighlightRole::COMPARE},
+                    {m_heapRoot, HighlightRole::PIVOT}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        while (m_currentIndex > m_heapRoot && a.less(m_currentIndex, m_heapRoot)) {
+            m_currentIndex = (m_currentIndex - 1) / 2;
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_currentIndex, HighlightRole::COMPARE},
+                    {m_heapRoot, HighlightRole::PIVOT}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        if (m_currentIndex == m_heapRoot) continue;
+
+        m_heapCarry = a.read(m_heapRoot);
+        for (; m_currentIndex != m_heapRoot; m_currentIndex = (m_currentIndex - 1) / 2) {
+            {
+                const int displaced = a.read(m_currentIndex);
+                a.write(m_currentIndex, m_heapCarry);
+                m_heapCarry = displaced;
+            }
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({{m_currentIndex, HighlightRole::WRITE}});
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        a.write(m_heapRoot, m_heapCarry);
+
+        if (m_trackHighlights) {
+            m_state.highlights.assign({{m_heapRoot, HighlightRole::WRITE}});
+        }
+        CO_YIELD(m_coroutine, true);
+    }
+    CO_END(m_coroutine);
+
     m_finished = true;
     return false;
 }
+
+// Counting sort, one element per step; mirrors kernels::countingSort. The
+// first pass counts each key while copying it aside, the second scatters
+// the copies to their slots.
+bool SortingAlgorithm::stepCountingSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+    const SortIndex n = a.size();
+
+    CO_BEGIN(m_coroutine);
+    m_radix.passBytes.push_back(2 * n * sizeof(int));
+    for (m_currentIndex = 0; m_currentIndex < n; ++m_currentIndex) {
+        kernels::countingCount(a, m_radix, m_radixMinKey, m_currentIndex);
+
+        if (m_trackHighlights) {
+            m_state.highlights.assign({{m_currentIndex, HighlightRole::COMPARE}});
+        }
+        CO_YIELD(m_coroutine, true);
+    }
+    kernels::countingPrefixSums(m_radix);
+
+    m_radix.passBytes.push_back(2 * n * sizeof(int));
+    for (m_currentIndex = 0; m_currentIndex < n; ++m_currentIndex) {
+        m_compareIndex = kernels::countingScatter(a, m_radix, m_radixMinKey, m_currentIndex);
+
+        if (m_trackHighlights) {
+            m_state.highlights.assign({{m_compareIndex, HighlightRole::WRITE}});
+        }
+        CO_YIELD(m_coroutine, true);
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// LSD radix sort, one element per step; mirrors kernels::radixSort.
+// radixDigit is the digit being scattered and radixFromAux says which
+// buffer it is read from.
+bool SortingAlgorithm::stepRadixSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+    const SortIndex n = a.size();
+
+    CO_BEGIN(m_coroutine);
+    m_radix.passBytes.push_back(n * sizeof(int));
+    for (m_currentIndex = 0; m_currentIndex < n; ++m_currentIndex) {
+        kernels::radixCount(a, m_radix, m_currentIndex);
+
+        if (m_trackHighlights) {
+            m_state.highlights.assign({{m_currentIndex, HighlightRole::COMPARE}});
+        }
+        CO_YIELD(m_coroutine, true);
+    }
+    kernels::radixPrefixSums(m_radix, n);
+
+    for (m_radixDigit = 0; m_radixDigit < m_radix.digitCount; ++m_radixDigit) {
+        if (m_radix.skipDigit[m_radixDigit]) continue;
+        m_radix.passBytes.push_back(2 * n * sizeof(int));
+        for (m_currentIndex = 0; m_currentIndex < n; ++m_currentIndex) {
+            m_compareIndex = kernels::radixScatter(a, m_radix, m_radixDigit, m_radixFromAux, m_currentIndex);
+
+            // The element read while scattering out of the array, the slot
+            // written while scattering back into it
+            if (m_trackHighlights) {
+                if (m_radixFromAux) {
+                    m_state.highlights.assign({{m_compareIndex, HighlightRole::WRITE}});
+                } else {
+                    m_state.highlights.assign({{m_currentIndex, HighlightRole::COMPARE}});
+                }
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        m_radixFromAux = !m_radixFromAux;
+    }
+
+    if (m_radixFromAux) {
+        m_radix.passBytes.push_back(2 * n * sizeof(int));
+        for (m_currentIndex = 0; m_currentIndex < n; ++m_currentIndex) {
+            a.write(m_currentIndex, a.auxRead(m_currentIndex));
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({{m_currentIndex, HighlightRole::WRITE}});
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// American flag sort, one element per step; mirrors
+// kernels::americanFlagSort. The bucket being sorted is marked by its
+// boundaries while its digit is counted and it is permuted or, when small,
+// insertion sorted.
+bool SortingAlgorithm::stepAmericanFlagSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    while (!m_radix.pending.empty()) {
+        m_radixRange = m_radix.pending.back();
+        m_radix.pending.pop_back();
+
+        if (m_radixRange.end - m_radixRange.begin < kernels::kFlagInsertionThreshold) {
+            for (m_currentIndex = m_radixRange.begin + 1; m_currentIndex < m_radixRange.end; ++m_currentIndex) {
+                for (m_compareIndex = m_currentIndex; m_compareIndex > m_radixRange.begin; --m_compareIndex) {
+                    m_partitionIndex = kernels::flagInsertionStep(a, m_radix, m_radixRange, m_compareIndex) ? 1 : 0;
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_compareIndex, HighlightRole::COMPARE},
+                            {m_compareIndex - 1, HighlightRole::COMPARE}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                    if (m_partitionIndex == 0) break;
+                }
+            }
+            continue;
+        }
+
+        kernels::flagClearCounts(m_radix);
+        for (m_currentIndex = m_radixRange.begin; m_currentIndex < m_radixRange.end; ++m_currentIndex) {
+            kernels::flagCount(a, m_radix, m_radixRange, m_currentIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_currentIndex, HighlightRole::COMPARE},
+                    {m_radixRange.begin, HighlightRole::BOUNDARY},
+                    {m_radixRange.end - 1, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        if (kernels::flagPrefixSums(m_radix, m_radixRange)) {
+            for (m_radixBucket = 0; m_radixBucket < kernels::kFlagBucketCount; ++m_radixBucket) {
+                while (kernels::flagHeads(m_radix)[m_radixBucket] < kernels::flagEnds(m_radix)[m_radixBucket]) {
+                    m_currentIndex = kernels::flagHeads(m_radix)[m_radixBucket];
+                    m_compareIndex = kernels::flagPlace(a, m_radix, m_radixRange.digit, m_radixBucket);
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_compareIndex, HighlightRole::WRITE},
+                            {m_currentIndex, HighlightRole::COMPARE},
+                            {m_radixRange.begin, HighlightRole::BOUNDARY},
+                            {m_radixRange.end - 1, HighlightRole::BOUNDARY}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                }
+            }
+            kernels::flagPushBuckets(m_radix, m_radixRange, true);
+        } else {
+            kernels::flagPushBuckets(m_radix, m_radixRange, false);
+        }
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// Pattern-defeating quicksort, one compare per step; mirrors
+// kernels::pdqSort. partitionRange is the range being sorted with its pivot
+// at its left end; currentIndex and compareIndex are the partition's scans,
+// or the insertion sort's element and its neighbour.
+bool SortingAlgorithm::stepPdqSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    if (a.size() > 1) {
+        m_partitions.push(0, a.size() - 1, kernels::pdqBadPartitionBudget(a.size()));
+    }
+
+    while (!m_partitions.empty()) {
+        m_partitionRange = m_partitions.pop();
+
+        if (m_partitionRange.right - m_partitionRange.left + 1 < kernels::kPdqInsertionThreshold) {
+            // One insertion sort pass over the whole range
+            m_partitionIndex = m_partitionRange.right + 1;
+            m_pdqPasses = 1;
+        } else {
+            for (m_pdqStep = 0; m_pdqStep < kernels::pdqPivotPairCount(m_partitionRange.right - m_partitionRange.left + 1);
+                 ++m_pdqStep) {
+                {
+                    const auto pair = kernels::pdqPivotPair(m_partitionRange.left, m_partitionRange.right + 1, m_pdqStep);
+                    kernels::pdqSort2(a, pair.first, pair.second);
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {pair.first, HighlightRole::COMPARE},
+                            {pair.second, HighlightRole::COMPARE}
+                        });
+                    }
+                }
+                CO_YIELD(m_coroutine, true);
+            }
+            if (m_partitionRange.right - m_partitionRange.left + 1 > kernels::kPdqNintherThreshold) {
+                a.swap(m_partitionRange.left, m_partitionRange.left + (m_partitionRange.right - m_partitionRange.left + 1) / 2);
+            }
+
+            // Partition right around the pivot at left
+            m_currentIndex = m_partitionRange.left;
+            m_compareIndex = m_partitionRange.right + 1;
+            do {
+                m_pdqScanning = a.less(++m_currentIndex, m_partitionRange.left);
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {m_partitionRange.left, HighlightRole::PIVOT},
+                        {m_currentIndex, HighlightRole::COMPARE}
+                    });
+                }
+                CO_YIELD(m_coroutine, true);
+            } while (m_pdqScanning);
+            m_pdqScanning = true;
+            while (m_pdqScanning && (m_currentIndex - 1 != m_partitionRange.left || m_currentIndex < m_compareIndex)) {
+                m_pdqScanning = !a.less(--m_compareIndex, m_partitionRange.left);
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {m_partitionRange.left, HighlightRole::PIVOT},
+                        {m_compareIndex, HighlightRole::COMPARE}
+                    });
+                }
+                CO_YIELD(m_coroutine, true);
+            }
+
+            // Nothing to swap means the range may already be sorted
+            m_pdqPasses = m_currentIndex >= m_compareIndex ? 2 : 0;
+            while (m_currentIndex < m_compareIndex) {
+                a.swap(m_currentIndex, m_compareIndex);
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {m_partitionRange.left, HighlightRole::PIVOT},
+                        {m_currentIndex, HighlightRole::WRITE},
+                        {m_compareIndex, HighlightRole::WRITE}
+                    });
+                }
+                CO_YIELD(m_coroutine, true);
+
+                do {
+                    m_pdqScanning = a.less(++m_currentIndex, m_partitionRange.left);
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_partitionRange.left, HighlightRole::PIVOT},
+                            {m_currentIndex, HighlightRole::COMPARE},
+                            {m_compareIndex, HighlightRole::BOUNDARY}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                } while (m_pdqScanning);
+                do {
+                    m_pdqScanning = !a.less(--m_compareIndex, m_partitionRange.left);
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_partitionRange.left, HighlightRole::PIVOT},
+                            {m_currentIndex, HighlightRole::BOUNDARY},
+                            {m_compareIndex, HighlightRole::COMPARE}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                } while (m_pdqScanning);
+            }
+
+            m_partitionIndex = m_currentIndex - 1;
+            if (m_partitionIndex != m_partitionRange.left) {
+                a.swap(m_partitionRange.left, m_partitionIndex);
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {m_partitionIndex, HighlightRole::PIVOT},
+                        {m_partitionRange.left, HighlightRole::WRITE}
+                    });
+                }
+                CO_YIELD(m_coroutine, true);
+            }
+
+            if (kernels::pdqIsBadPartition(m_partitionRange.left, m_partitionIndex, m_partitionRange.right + 1)) {
+                m_pdqPasses = 0;
+                if (--m_partitionRange.budget == 0) {
+                    while (stepHeapSortRange()) {
+                        CO_YIELD(m_coroutine, true);
+                    }
+                    continue;
+                }
+
+                kernels::pdqBreakPatterns(a, m_partitionRange.left, m_partitionIndex, m_partitionRange.right + 1);
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({{m_partitionIndex, HighlightRole::PIVOT}});
+                }
+                CO_YIELD(m_coroutine, true);
+            }
+        }
+
+        // Insertion sort of the small range, or partial insertion sorts of
+        // both sides of a partition that swapped nothing, which give up
+        // after a few moves
+        for (m_pdqStep = 0; m_pdqStep < m_pdqPasses; ++m_pdqStep) {
+            m_pdqMoves = 0;
+            for (m_currentIndex = (m_pdqStep == 0 ? m_partitionRange.left : m_partitionIndex + 1) + 1;
+                 m_currentIndex < (m_pdqStep == 0 ? m_partitionIndex : m_partitionRange.right + 1) &&
+                 (m_pdqPasses == 1 || m_pdqMoves <= kernels::kPdqPartialInsertionLimit);
+                 ++m_currentIndex) {
+                for (m_compareIndex = m_currentIndex;
+                     m_compareIndex > (m_pdqStep == 0 ? m_partitionRange.left : m_partitionIndex + 1);
+                     --m_compareIndex) {
+                    m_pdqScanning = kernels::insertionStep(a, m_compareIndex);
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_compareIndex, HighlightRole::COMPARE},
+                            {m_compareIndex - 1, HighlightRole::COMPARE}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                    if (!m_pdqScanning) break;
+                    m_pdqMoves++;
+                }
+            }
+            if (m_pdqPasses == 2 && m_pdqMoves > kernels::kPdqPartialInsertionLimit) break;
+        }
+        if (m_pdqPasses > 0 && m_pdqStep == m_pdqPasses) continue;
+
+        m_partitions.pushChildren(m_partitionRange, m_partitionIndex);
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// BlockQuicksort, one compare or swap per step; mirrors
+// kernels::blockQuickSort. The two blocks being scanned are marked by their
+// ends while their compares fill the offset buffers, and the misplaced
+// elements then swap in pairs. currentIndex and compareIndex are the
+// elements compared, and in the final Lomuto pass the boundary and the
+// element being moved.
+bool SortingAlgorithm::stepBlockQuickSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    if (a.size() > 1) {
+        m_partitions.push(0, a.size() - 1, kernels::blockDepthBudget(a.size()));
+    }
+
+    while (!m_partitions.empty()) {
+        m_partitionRange = m_partitions.pop();
+
+        if (m_partitionRange.right - m_partitionRange.left + 1 < kernels::kPdqInsertionThreshold) {
+            for (m_currentIndex = m_partitionRange.left + 1; m_currentIndex <= m_partitionRange.right; ++m_currentIndex) {
+                for (m_compareIndex = m_currentIndex; m_compareIndex > m_partitionRange.left; --m_compareIndex) {
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_compareIndex, HighlightRole::COMPARE},
+                            {m_compareIndex - 1, HighlightRole::COMPARE}
+                        });
+                    }
+                    if (!kernels::insertionStep(a, m_compareIndex)) {
+                        CO_YIELD(m_coroutine, true);
+                        break;
+                    }
+                    CO_YIELD(m_coroutine, true);
+                }
+            }
+            continue;
+        }
+        if (m_partitionRange.budget-- == 0) {
+            while (stepHeapSortRange()) {
+                CO_YIELD(m_coroutine, true);
+            }
+            continue;
+        }
+
+        for (m_blockStep = 0; m_blockStep < kernels::pdqPivotPairCount(m_partitionRange.right - m_partitionRange.left + 1);
+             ++m_blockStep) {
+            {
+                const auto pair = kernels::pdqPivotPair(m_partitionRange.left, m_partitionRange.right + 1,
+                                                        static_cast<int>(m_blockStep));
+                kernels::pdqSort2(a, pair.first, pair.second);
+
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {pair.first, HighlightRole::COMPARE},
+                        {pair.second, HighlightRole::COMPARE}
+                    });
+                }
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        if (m_partitionRange.right - m_partitionRange.left + 1 > kernels::kPdqNintherThreshold) {
+            a.swap(m_partitionRange.left, m_partitionRange.left + (m_partitionRange.right - m_partitionRange.left + 1) / 2);
+        }
+
+        // Block partition around the pivot at left
+        m_block = kernels::BlockPartition();
+        m_block.left = m_partitionRange.left + 1;
+        m_block.right = m_partitionRange.right;
+        while (kernels::blockHasTwoBlocks(m_block)) {
+            if (m_block.leftCount == 0) {
+                for (m_blockStep = 0; m_blockStep < kernels::kBlockSize; ++m_blockStep) {
+                    kernels::blockScanLeft(a, m_block, m_partitionRange.left, m_blockStep);
+                    m_currentIndex = m_block.left + m_blockStep;
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_partitionRange.left, HighlightRole::PIVOT},
+                            {m_currentIndex, HighlightRole::COMPARE},
+                            {m_block.left, HighlightRole::BOUNDARY},
+                            {m_block.left + kernels::kBlockSize - 1, HighlightRole::BOUNDARY}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                }
+            }
+            if (m_block.rightCount == 0) {
+                for (m_blockStep = 0; m_blockStep < kernels::kBlockSize; ++m_blockStep) {
+                    kernels::blockScanRight(a, m_block, m_partitionRange.left, m_blockStep);
+                    m_compareIndex = m_block.right - m_blockStep;
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_partitionRange.left, HighlightRole::PIVOT},
+                            {m_compareIndex, HighlightRole::COMPARE},
+                            {m_block.right, HighlightRole::BOUNDARY},
+                            {m_block.right - kernels::kBlockSize + 1, HighlightRole::BOUNDARY}
+                        });
+                    }
+                    CO_YIELD(m_coroutine, true);
+                }
+            }
+
+            for (m_blockStep = 0;
+                 m_blockStep < static_cast<SortIndex>(std::min(m_block.leftCount, m_block.rightCount));
+                 ++m_blockStep) {
+                {
+                    const auto pair = kernels::blockSwapPair(m_block, static_cast<size_t>(m_blockStep));
+                    a.swap(pair.first, pair.second);
+
+                    if (m_trackHighlights) {
+                        m_state.highlights.assign({
+                            {m_partitionRange.left, HighlightRole::PIVOT},
+                            {pair.first, HighlightRole::WRITE},
+                            {pair.second, HighlightRole::WRITE}
+                        });
+                    }
+                }
+                CO_YIELD(m_coroutine, true);
+            }
+            kernels::blockAdvance(m_block, std::min(m_block.leftCount, m_block.rightCount));
+        }
+
+        // Branch-free Lomuto pass over what is left in the middle
+        m_currentIndex = m_block.left;
+        for (m_compareIndex = m_block.left; m_compareIndex <= m_block.right; ++m_compareIndex) {
+            m_currentIndex += kernels::blockLomutoStep(a, m_partitionRange.left, m_currentIndex, m_compareIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionRange.left, HighlightRole::PIVOT},
+                    {m_compareIndex, HighlightRole::COMPARE},
+                    {m_currentIndex, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        m_partitionIndex = m_currentIndex - 1;
+        if (m_partitionIndex != m_partitionRange.left) {
+            a.swap(m_partitionRange.left, m_partitionIndex);
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionIndex, HighlightRole::PIVOT},
+                    {m_partitionRange.left, HighlightRole::WRITE}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        m_partitions.pushChildren(m_partitionRange, m_partitionIndex);
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// Vector quicksort, one vector of lanes keys per step; mirrors
+// kernels::vectorQuickSort. The partition model's write ends, writeLeft
+// and writeRight - 1, are highlighted as boundaries next to the vector just
+// compared. Small ranges take a step per layer of their bitonic network,
+// marked by the range's ends, with the layer in getNetworkProgress().
+// partitionIndex is where the last partition put its pivot.
+bool SortingAlgorithm::stepVectorQuickSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    if (a.size() > 1) {
+        m_partitions.push(0, a.size() - 1, kernels::blockDepthBudget(a.size()));
+    }
+
+    while (!m_partitions.empty()) {
+        m_partitionRange = m_partitions.pop();
+
+        // Small ranges go through a sorting network a layer per step, as
+        // the vector code runs a layer per min and max
+        if (m_partitionRange.right - m_partitionRange.left + 1 <= kernels::kNetworkMaxSize) {
+            m_network.size = m_partitionRange.right - m_partitionRange.left + 1;
+            m_network.begin = m_partitionRange.left;
+            m_network.network = &kernels::bitonicSortNetwork(kernels::networkSizeFor(m_network.size));
+            for (m_network.layer = 0; m_network.layer < m_network.network->layerCount(); ++m_network.layer) {
+                if (kernels::networkLayer(a, m_network.begin, m_network.size, *m_network.network, m_network.layer) == 0) {
+                    continue;
+                }
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {m_partitionRange.left, HighlightRole::BOUNDARY},
+                        {m_partitionRange.right, HighlightRole::BOUNDARY}
+                    });
+                }
+                CO_YIELD(m_coroutine, true);
+            }
+            continue;
+        }
+        if (m_partitionRange.budget-- == 0) {
+            while (stepHeapSortRange()) {
+                CO_YIELD(m_coroutine, true);
+            }
+            continue;
+        }
+
+        for (m_vectorStep = 0; m_vectorStep < kernels::pdqPivotPairCount(m_partitionRange.right - m_partitionRange.left + 1);
+             ++m_vectorStep) {
+            {
+                const auto pair = kernels::pdqPivotPair(m_partitionRange.left, m_partitionRange.right + 1,
+                                                        static_cast<int>(m_vectorStep));
+                kernels::pdqSort2(a, pair.first, pair.second);
+
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {pair.first, HighlightRole::COMPARE},
+                        {pair.second, HighlightRole::COMPARE}
+                    });
+                }
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        if (m_partitionRange.right - m_partitionRange.left + 1 > kernels::kPdqNintherThreshold) {
+            a.swap(m_partitionRange.left, m_partitionRange.left + (m_partitionRange.right - m_partitionRange.left + 1) / 2);
+        }
+
+        // Vector partition around the pivot at left, a whole vector per step;
+        // the write ends are highlighted as boundaries
+        kernels::vectorPartitionBegin(a, m_vector, m_partitionRange.left + 1, m_partitionRange.right + 1,
+                                      m_partitionRange.left, m_vectorLanes);
+        if (m_vector.hasEnds) {
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionRange.left, HighlightRole::PIVOT},
+                    {m_partitionRange.left + 1, HighlightRole::COMPARE},
+                    {m_vector.readLeft - 1, HighlightRole::COMPARE},
+                    {m_vector.readRight, HighlightRole::COMPARE},
+                    {m_partitionRange.right, HighlightRole::COMPARE}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        while (kernels::vectorHasWholeVector(m_vector)) {
+            m_currentIndex = kernels::vectorReadsLeft(m_vector) ? m_vector.readLeft : m_vector.readRight - m_vectorLanes;
+            kernels::vectorPartitionStep(a, m_vector);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionRange.left, HighlightRole::PIVOT},
+                    {m_currentIndex, HighlightRole::COMPARE},
+                    {m_currentIndex + m_vectorLanes - 1, HighlightRole::COMPARE},
+                    {m_vector.writeLeft, HighlightRole::BOUNDARY},
+                    {m_vector.writeRight - 1, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        // The leftovers one key at a time, then the two end vectors
+        kernels::vectorLoadRest(a, m_vector);
+        for (m_vectorStep = 0; m_vectorStep < m_vector.restSize; ++m_vectorStep) {
+            kernels::vectorPlaceRest(a, m_vector, m_vectorStep);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionRange.left, HighlightRole::PIVOT},
+                    {(m_vector.restMask >> m_vectorStep & 1) ? m_vector.writeLeft - 1 : m_vector.writeRight,
+                     HighlightRole::WRITE}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+        for (m_vectorStep = 0; m_vector.hasEnds && m_vectorStep < 2; ++m_vectorStep) {
+            {
+                const SortIndex left = m_vector.writeLeft;
+                const SortIndex right = m_vector.writeRight;
+                kernels::vectorStore(a, m_vector, m_vector.ends[m_vectorStep], m_vector.endMasks[m_vectorStep]);
+
+                if (m_trackHighlights) {
+                    m_state.highlights.assign({
+                        {m_partitionRange.left, HighlightRole::PIVOT},
+                        {left, HighlightRole::WRITE},
+                        {right - 1, HighlightRole::WRITE}
+                    });
+                }
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        m_partitionIndex = m_vector.writeLeft - 1;
+        if (m_partitionIndex != m_partitionRange.left) {
+            a.swap(m_partitionRange.left, m_partitionIndex);
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionIndex, HighlightRole::PIVOT},
+                    {m_partitionRange.left, HighlightRole::WRITE}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        m_partitions.pushChildren(m_partitionRange, m_partitionIndex);
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// Network merge sort, one network layer per step on each block of up to 32
+// keys, then the merge passes; mirrors kernels::networkMergeSort. The
+// kernel runs each network's comparators as one unrolled list, which
+// applies the same compare-exchanges.
+bool SortingAlgorithm::stepNetworkSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+    const SortIndex n = a.size();
+
+    CO_BEGIN(m_coroutine);
+    m_mergeWidth = kernels::networkMergeLeaf(n, kernels::kNetworkMaxSize);
+    for (m_mergeBegin = 0; m_mergeBegin < n; m_mergeBegin += m_mergeWidth) {
+        m_network.begin = m_mergeBegin;
+        m_network.size = std::min(m_mergeWidth, n - m_network.begin);
+        m_network.network = &kernels::smallestNetwork(m_network.size);
+        for (m_network.layer = 0; m_network.layer < m_network.network->layerCount(); ++m_network.layer) {
+            kernels::networkLayer(a, m_network.begin, m_network.size, *m_network.network, m_network.layer);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_network.begin, HighlightRole::BOUNDARY},
+                    {m_network.begin + m_network.size - 1, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+    }
+
+    while (stepMergePasses()) {
+        CO_YIELD(m_coroutine, true);
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+const kernels::DualPartition* SortingAlgorithm::getDualPartition() const {
+    return m_dualPartitioning && !m_playback ? &m_dual : nullptr;
+}
+
+// Yaroslavskiy's partition one key at a time, the pivots ordered in a step
+// of their own and swapped into place in another
+bool SortingAlgorithm::stepDualPivotQuickSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_coroutine);
+    if (a.size() > 1) {
+        m_partitions.push(0, a.size() - 1);
+    }
+
+    while (!m_partitions.empty()) {
+        m_partitionRange = m_partitions.pop();
+        kernels::dualPivotBegin(a, m_dual, m_partitionRange.left, m_partitionRange.right);
+        m_dualPartitioning = true;
+        m_currentIndex = m_dual.left;
+        m_partitionIndex = m_dual.less;
+        if (m_trackHighlights) {
+            m_state.highlights.assign({
+                {m_dual.left, HighlightRole::PIVOT},
+                {m_dual.right, HighlightRole::PIVOT}
+            });
+        }
+        CO_YIELD(m_coroutine, true);
+
+        while (kernels::dualPivotScanning(m_dual)) {
+            m_compareIndex = m_dual.scan;
+            kernels::dualPivotStep(a, m_dual);
+            m_partitionIndex = m_dual.less;
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_dual.left, HighlightRole::PIVOT},
+                    {m_dual.right, HighlightRole::PIVOT},
+                    {m_compareIndex, HighlightRole::COMPARE},
+                    {m_dual.less, HighlightRole::BOUNDARY},
+                    {m_dual.greater, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_coroutine, true);
+        }
+
+        kernels::dualPivotFinish(a, m_dual);
+        m_dualPartitioning = false;
+        m_currentIndex = m_dual.less;
+        m_partitionIndex = m_dual.greater;
+        if (m_trackHighlights) {
+            m_state.highlights.assign({
+                {m_dual.less, HighlightRole::PIVOT},
+                {m_dual.greater, HighlightRole::PIVOT},
+                {m_dual.left, HighlightRole::WRITE},
+                {m_dual.right, HighlightRole::WRITE}
+            });
+        }
+        CO_YIELD(m_coroutine, true);
+
+        m_partitions.pushChildren(m_partitionRange, m_dual.less, m_dual.greater);
+    }
+    CO_END(m_coroutine);
+
+    m_finished = true;
+    return false;
+}
+
+// The kernel's own step, which already stops at every compare, move or
+// gallop search, so there is no coroutine here; the highlights mark the
+// run being found, or the merge's bounds and its next keys
+bool SortingAlgorithm::stepPowerSort() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    if (!kernels::powerSortStep(a, m_power)) {
+        m_finished = true;
+        return false;
+    }
+
+    if (m_trackHighlights) {
+        using Phase = kernels::PowerSort::Phase;
+        const kernels::PowerSort& s = m_power;
+        switch (s.phase) {
+            case Phase::FIND_RUN:
+            case Phase::EXTEND_RUN:
+            case Phase::INSERT:
+                m_state.highlights.assign({
+                    {s.runBegin, HighlightRole::BOUNDARY},
+                    {s.runEnd - 1, HighlightRole::COMPARE}
+                });
+                break;
+            case Phase::REVERSE_RUN:
+                m_state.highlights.assign({
+                    {s.reverseLow - 1, HighlightRole::WRITE},
+                    {s.reverseHigh + 1, HighlightRole::WRITE},
+                    {s.runBegin, HighlightRole::BOUNDARY}
+                });
+                break;
+            case Phase::MERGE:
+            case Phase::GALLOP_AUX:
+            case Phase::MOVE_AUX:
+            case Phase::GALLOP_ARRAY:
+            case Phase::MOVE_ARRAY:
+                m_state.highlights.assign({
+                    {s.high ? s.out + 1 : s.out - 1, HighlightRole::WRITE},
+                    {s.array, HighlightRole::COMPARE},
+                    {s.mergeBegin, HighlightRole::BOUNDARY},
+                    {s.mergeMid, HighlightRole::BOUNDARY},
+                    {s.mergeEnd - 1, HighlightRole::BOUNDARY}
+                });
+                break;
+            default:
+                m_state.highlights.assign({
+                    {s.mergeBegin, HighlightRole::BOUNDARY},
+                    {s.mergeMid, HighlightRole::BOUNDARY},
+                    {s.mergeEnd - 1, HighlightRole::BOUNDARY}
+                });
+                break;
+        }
+    }
+    return true;
+}
+
+// Heap sort of partitionRange, laid out from its left end, one sift-down
+// level per step; how the quicksorts finish a range that ran out of budget.
+// Its own coroutine runs inside theirs, returning false without a step once
+// the range is sorted.
+bool SortingAlgorithm::stepHeapSortRange() {
+    StepInstrument instrument{m_state, m_auxArray, m_undo, m_predictor};
+    StepView a = makeStepView(instrument);
+
+    CO_BEGIN(m_rangeCoroutine);
+    m_heapRoot = (m_partitionRange.right - m_partitionRange.left + 1) / 2;
+    m_partitionIndex = m_partitionRange.right - m_partitionRange.left + 1;
+    while (true) {
+        if (m_heapRoot > 0) {
+            m_heapRoot--;
+        } else {
+            if (m_partitionIndex <= 1) break;
+            m_partitionIndex--;
+            a.swap(m_partitionRange.left, m_partitionRange.left + m_partitionIndex);
+
+            if (m_trackHighlights) {
+                m_state.highlights.assign({
+                    {m_partitionRange.left, HighlightRole::WRITE},
+                    {m_partitionRange.left + m_partitionIndex, HighlightRole::BOUNDARY}
+                });
+            }
+            CO_YIELD(m_rangeCoroutine, true);
+        }
+
+        for (m_currentIndex = m_heapRoot; m_currentIndex >= 0 && 2 * m_currentIndex + 1 < m_partitionIndex;
+             m_currentIndex = m_compareIndex) {
+            m_compareIndex = kernels::siftDownStep(a, m_currentIndex, m_partitionIndex, m_partitionRange.left);
+
+            if (m_trackHighlights) {
+                m_state.highlights.clear();
+                m_state.highlights.add(m_partitionRange.left + m_currentIndex, HighlightRole::COMPARE);
+                if (m_compareIndex >= 0) {
+                    m_state.highlights.add(m_partitionRange.left + m_compareIndex, HighlightRole::COMPARE);
+                }
+            }
+            CO_YIELD(m_rangeCoroutine, true);
+        }
+    }
+    CO_END(m_rangeCoroutine);
+
+    m_rangeCoroutine.reset();
+    return false;
+}
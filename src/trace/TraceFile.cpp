@@ -0,0 +1,277 @@
+#include "trace/TraceFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace trace {
+
+namespace {
+
+// Mapping offsets must be multiples of this
+uint64_t mappingGranularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+}
+
+// Writer
+
+TraceFileWriter::TraceFileWriter(TraceFileWriter&& other) noexcept {
+    *this = std::move(other);
+}
+
+TraceFileWriter& TraceFileWriter::operator=(TraceFileWriter&& other) noexcept {
+    if (this != &other) {
+        if (m_file) finish();
+        m_file = std::exchange(other.m_file, nullptr);
+        m_header = other.m_header;
+        m_chunk = std::move(other.m_chunk);
+        m_index = std::move(other.m_index);
+        m_offset = other.m_offset;
+        m_chunkBytes = other.m_chunkBytes;
+        m_failed = other.m_failed;
+    }
+    return *this;
+}
+
+TraceFileWriter::~TraceFileWriter() {
+    if (m_file) finish();
+}
+
+bool TraceFileWriter::open(const std::string& path, const std::vector<int>& initialArray, uint32_t algorithm,
+                           size_t chunkBytes) {
+    if (m_file) finish();
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) return false;
+
+    m_header = TraceFileHeader{};
+    std::memcpy(m_header.magic, kTraceFileMagic, sizeof(m_header.magic));
+    m_header.version = kTraceFileVersion;
+    m_header.algorithm = algorithm;
+    m_header.elementCount = initialArray.size();
+    m_header.arrayOffset = sizeof(TraceFileHeader);
+    m_chunk.clear();
+    m_index.clear();
+    m_offset = 0;
+    m_chunkBytes = std::max<size_t>(chunkBytes, 1);
+    m_failed = false;
+
+    // Placeholder until finish() knows where the index is
+    write(&m_header, sizeof(m_header));
+    write(initialArray.data(), initialArray.size() * sizeof(int));
+    return !m_failed;
+}
+
+bool TraceFileWriter::finish() {
+    if (!m_file) return false;
+
+    flushChunk();
+    m_header.chunkCount = m_index.size();
+    m_header.indexOffset = m_offset;
+    write(m_index.data(), m_index.size() * sizeof(TraceChunkInfo));
+
+    if (std::fseek(m_file, 0, SEEK_SET) != 0) m_failed = true;
+    write(&m_header, sizeof(m_header));
+    if (std::fclose(m_file) != 0) m_failed = true;
+    m_file = nullptr;
+    return !m_failed;
+}
+
+void TraceFileWriter::flushChunk() {
+    if (m_chunk.empty()) return;
+
+    m_chunk.flush();
+    m_index.push_back(TraceChunkInfo{m_offset, m_chunk.byteSize(), m_header.operationCount, m_chunk.size()});
+    m_header.operationCount += m_chunk.size();
+    write(m_chunk.data(), m_chunk.byteSize());
+    m_chunk.clear();
+}
+
+void TraceFileWriter::write(const void* data, size_t bytes) {
+    if (bytes == 0) return;
+    if (std::fwrite(data, 1, bytes, m_file) != bytes) m_failed = true;
+    m_offset += bytes;
+}
+
+// Reader
+
+TraceFile& TraceFile::operator=(const TraceFile& other) {
+    if (this != &other) {
+        close();
+        if (other.m_open) open(other.m_path, other.m_windowBytes);
+    }
+    return *this;
+}
+
+bool TraceFile::open(const std::string& path, size_t windowBytes) {
+    close();
+    m_path = path;
+    m_windowBytes = windowBytes;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_fileSize = static_cast<uint64_t>(size.QuadPart);
+#else
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) return false;
+    struct stat info;
+    if (fstat(m_fd, &info) != 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_fileSize = static_cast<uint64_t>(info.st_size);
+#endif
+    m_open = true;
+
+    // Validate the header and index bounds; the operations are never scanned.
+    // Sizes are compared against what is left past an offset, since a sum of
+    // crafted fields could wrap around.
+    const bool valid =
+        readRange(&m_header, 0, sizeof(m_header)) &&
+        std::memcmp(m_header.magic, kTraceFileMagic, sizeof(m_header.magic)) == 0 &&
+        m_header.version == kTraceFileVersion &&
+        m_header.indexOffset != 0 &&
+        m_header.indexOffset <= m_fileSize &&
+        m_header.arrayOffset <= m_header.indexOffset &&
+        m_header.elementCount <= (m_header.indexOffset - m_header.arrayOffset) / sizeof(int) &&
+        m_header.chunkCount <= (m_fileSize - m_header.indexOffset) / sizeof(TraceChunkInfo);
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    m_index.resize(static_cast<size_t>(m_header.chunkCount));
+    if (!readRange(m_index.data(), m_header.indexOffset, m_index.size() * sizeof(TraceChunkInfo))) {
+        close();
+        return false;
+    }
+    for (const auto& chunk : m_index) {
+        if (chunk.offset > m_header.indexOffset || chunk.byteSize > m_header.indexOffset - chunk.offset) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void TraceFile::close() {
+    unmapRegion(m_window);
+#ifdef _WIN32
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+#endif
+    m_open = false;
+    m_path.clear();
+    m_fileSize = 0;
+    m_header = TraceFileHeader{};
+    m_index.clear();
+}
+
+bool TraceFile::readInitialArray(std::vector<int>& array) {
+    if (!m_open) return false;
+    array.resize(static_cast<size_t>(m_header.elementCount));
+    return readRange(array.data(), m_header.arrayOffset, array.size() * sizeof(int));
+}
+
+const uint8_t* TraceFile::mapChunk(size_t chunk) {
+    const TraceChunkInfo& info = m_index[chunk];
+    const uint64_t windowEnd = m_window.offset + m_window.length;
+    if (!m_window.base || info.offset < m_window.offset || info.offset + info.byteSize > windowEnd) {
+        // Slide the window forward over as many whole chunks as fit
+        uint64_t end = info.offset + info.byteSize;
+        for (size_t next = chunk + 1; next < m_index.size(); ++next) {
+            const uint64_t nextEnd = m_index[next].offset + m_index[next].byteSize;
+            if (nextEnd - info.offset > m_windowBytes) break;
+            end = nextEnd;
+        }
+
+        unmapRegion(m_window);
+        if (!mapRegion(m_window, info.offset, static_cast<size_t>(end - info.offset))) return nullptr;
+    }
+    return static_cast<const uint8_t*>(m_window.base) + (info.offset - m_window.offset);
+}
+
+bool TraceFile::mapRegion(Region& region, uint64_t offset, size_t length) {
+    const uint64_t aligned = offset - offset % mappingGranularity();
+    const size_t mappedLength = static_cast<size_t>(length + (offset - aligned));
+
+#ifdef _WIN32
+    void* base = MapViewOfFile(m_mapping, FILE_MAP_READ, static_cast<DWORD>(aligned >> 32),
+                               static_cast<DWORD>(aligned & 0xffffffff), mappedLength);
+    if (!base) return false;
+#else
+    void* base = mmap(nullptr, mappedLength, PROT_READ, MAP_SHARED, m_fd, static_cast<off_t>(aligned));
+    if (base == MAP_FAILED) return false;
+    madvise(base, mappedLength, MADV_SEQUENTIAL);
+#endif
+
+    region.base = base;
+    region.length = mappedLength;
+    region.offset = aligned;
+    return true;
+}
+
+void TraceFile::unmapRegion(Region& region) {
+    if (!region.base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(region.base);
+#else
+    munmap(region.base, region.length);
+#endif
+    region = Region{};
+}
+
+bool TraceFile::readRange(void* out, uint64_t offset, size_t length) {
+    if (length == 0) return true;
+    if (offset + length > m_fileSize) return false;
+
+    Region region;
+    if (!mapRegion(region, offset, length)) return false;
+    std::memcpy(out, static_cast<const uint8_t*>(region.base) + (offset - region.offset), length);
+    unmapRegion(region);
+    return true;
+}
+
+}
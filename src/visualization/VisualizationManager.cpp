@@ -1,23 +1,106 @@
 #include "visualization/VisualizationManager.hpp"
 #include "imgui.h"
 #include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+namespace {
+    // Share of a 60 Hz frame the algorithm may spend stepping
+    constexpr double kStepBudgetSeconds = 0.010;
+
+    ImU32 roleColor(HighlightRole role) {
+        switch (role) {
+            case HighlightRole::PIVOT: return IM_COL32(255, 100, 100, 255);    // red
+            case HighlightRole::COMPARE: return IM_COL32(100, 255, 100, 255);  // green
+            case HighlightRole::WRITE: return IM_COL32(255, 255, 120, 255);    // yellow
+            case HighlightRole::BOUNDARY: return IM_COL32(255, 200, 100, 255); // orange
+            default: return IM_COL32(100, 150, 255, 255);                      // blue
+        }
+    }
+
+    // Tints the background behind the elements [begin, end) of count drawn
+    // across width
+    void drawRegion(ImDrawList* drawList, ImVec2 topLeft, float width, float height,
+                    SortIndex begin, SortIndex end, size_t count, ImU32 color) {
+        if (end <= begin || count == 0) return;
+        const float left = topLeft.x + width * static_cast<float>(begin) / count;
+        const float right = topLeft.x + width * static_cast<float>(end) / count;
+        drawList->AddRectFilled(ImVec2(left, topLeft.y), ImVec2(std::max(right, left + 1.0f), topLeft.y + height), color);
+    }
+
+    // Strip of bars above the array, sampled down to one bar per pixel column
+    // like the array. A maxValue of 0 scales to the tallest bar shown.
+    template <typename Value>
+    void drawStrip(ImDrawList* drawList, ImVec2 topLeft, float width, float height,
+                   const Value* values, size_t count, float maxValue, ImU32 background, ImU32 color) {
+        const float bottom = topLeft.y + height;
+        drawList->AddRectFilled(topLeft, ImVec2(topLeft.x + width, bottom), background);
+
+        const size_t bars = std::min(count, static_cast<size_t>(std::max(width, 1.0f)));
+        const float barWidth = width / bars;
+        const float barGap = barWidth > 2.0f ? 1.0f : 0.0f;
+        if (maxValue <= 0.0f) {
+            for (size_t bar = 0; bar < bars; ++bar) {
+                maxValue = std::max(maxValue, static_cast<float>(values[bar * count / bars]));
+            }
+            maxValue = std::max(maxValue, 1.0f);
+        }
+        for (size_t bar = 0; bar < bars; ++bar) {
+            const float value = static_cast<float>(values[bar * count / bars]);
+            const float x = topLeft.x + bar * barWidth;
+            drawList->AddRectFilled(
+                ImVec2(x, bottom),
+                ImVec2(x + barWidth - barGap, bottom - (value / maxValue) * height),
+                color
+            );
+        }
+    }
+}
 
 VisualizationManager::VisualizationManager()
-    : m_speed(1.0f)
+    : m_comparisonAlgorithm(-1)
+    , m_speed(60.0f)
+    , m_arraySize(100)
+    , m_keyframeBudgetMB(256.0f)
+    , m_tracePath("sort.avtrace")
+    , m_traceFileFailed(false)
+    , m_simdBenchmark{}
+    , m_hasSimdBenchmark(false)
+    , m_uninstrumentedTime(0)
+    , m_hasUninstrumentedTime(false)
     , m_isPaused(true)
+    , m_playReverse(false)
     , m_stepMode(false)
 {
-    m_sortingAlgorithm = std::make_unique<SortingAlgorithm>(100);
+    m_sortingAlgorithm = std::make_unique<SortingAlgorithm>(m_arraySize);
 }
 
 void VisualizationManager::update() {
-    if (!m_isPaused && !m_stepMode) {
-        m_sortingAlgorithm->step();
+    if (m_isPaused || m_stepMode) return;
+
+    if (m_playReverse) {
+        // Rewinding stops at the start of the undo history
+        if (m_comparison) m_comparison->rewind(ImGui::GetIO().DeltaTime);
+        if (m_sortingAlgorithm->rewind(ImGui::GetIO().DeltaTime) == 0 && !m_sortingAlgorithm->canStepBack()) {
+            m_isPaused = true;
+        }
+    } else {
+        // Side by side runs split the frame's budget
+        const double budget = m_comparison ? kStepBudgetSeconds / 2 : kStepBudgetSeconds;
+        m_sortingAlgorithm->advance(ImGui::GetIO().DeltaTime, budget);
+        if (m_comparison) m_comparison->advance(ImGui::GetIO().DeltaTime, budget);
     }
 }
 
 void VisualizationManager::render() {
-    renderSortingAlgorithm();
+    renderSortingAlgorithm(*m_sortingAlgorithm, "Algorithm Visualization");
+    if (m_comparison) renderSortingAlgorithm(*m_comparison, "Comparison Visualization");
+    renderSortingNetwork(*m_sortingAlgorithm);
+}
+
+void VisualizationManager::syncComparison() {
+    if (!m_comparison) return;
+    m_comparison->setArray(m_sortingAlgorithm->getState().array);
 }
 
 void VisualizationManager::renderImGui() {
@@ -25,10 +108,10 @@ void VisualizationManager::renderImGui() {
     renderMetrics();
 }
 
-void VisualizationManager::renderSortingAlgorithm() {
-    const auto& state = m_sortingAlgorithm->getState();
+void VisualizationManager::renderSortingAlgorithm(const SortingAlgorithm& sorter, const char* title) {
+    const auto& state = sorter.getState();
     
-    ImGui::Begin("Algorithm Visualization");
+    ImGui::Begin(title);
     
     // Calculate dimensions
     const float padding = 10.0f;
@@ -59,116 +142,354 @@ void VisualizationManager::renderSortingAlgorithm() {
         );
     }
     
-    // Draw bars
-    const float barWidth = width / state.array.size();
-    const float maxHeight = height - 20.0f;
-    const float maxValue = static_cast<float>(*std::max_element(state.array.begin(), state.array.end()));
+    // Draw bars. Arrays wider than the window get one bar per pixel column
+    // showing the first element it covers, so a frame costs O(width) even
+    // for 100M+ elements.
+    const size_t count = state.array.size();
+    const size_t barCount = std::min(count, static_cast<size_t>(std::max(width, 1.0f)));
+    const float barWidth = barCount > 0 ? width / barCount : 0.0f;
+    const float barGap = barWidth > 2.0f ? 1.0f : 0.0f;
+    const float maxValue = static_cast<float>(std::max(sorter.getMaxValue(), 1));
     
-    for (size_t i = 0; i < state.array.size(); ++i) {
-        const float value = static_cast<float>(state.array[i]);
+    // Merge and radix passes into the aux buffer leave the array untouched,
+    // so the buffer gets a strip of its own above the array, and the
+    // counting sorts' buckets one above that
+    const auto& aux = sorter.getAuxArray();
+    size_t bucketCount = 0;
+    const SortIndex* buckets = sorter.getBuckets(bucketCount);
+    const int strips = (aux.empty() ? 0 : 1) + (bucketCount > 0 ? 1 : 0);
+    const float stripHeight = (height - 20.0f) * (strips > 1 ? 0.2f : 0.25f);
+    const float maxHeight = height - 20.0f - strips * (stripHeight + 10.0f);
+    
+    // Scatter the step's highlights into a per-bar role table so each bar
+    // looks up its color directly. Earlier highlights win, so apply them last.
+    m_barRoles.resize(barCount, HighlightRole::NONE);
+    for (size_t h = state.highlights.size(); h-- > 0;) {
+        const auto& highlight = state.highlights[h];
+        if (highlight.index >= 0 && static_cast<size_t>(highlight.index) < count) {
+            m_barRoles[static_cast<size_t>(highlight.index) * barCount / count] = highlight.role;
+        }
+    }
+    
+    // A dual-pivot partition shows its three regions behind the bars: keys
+    // smaller than the small pivot, keys between the pivots, and keys no
+    // smaller than the large one, with the unscanned middle left plain
+    if (const kernels::DualPartition* dual = sorter.getDualPartition()) {
+        const ImVec2 regionTop(pos.x + padding, pos.y + padding + height - maxHeight);
+        drawRegion(drawList, regionTop, width, maxHeight, dual->left + 1, dual->less, count, IM_COL32(70, 110, 200, 70));
+        drawRegion(drawList, regionTop, width, maxHeight, dual->less, kernels::dualPivotMiddleEnd(*dual), count, IM_COL32(80, 180, 100, 70));
+        drawRegion(drawList, regionTop, width, maxHeight, dual->greater + 1, dual->right, count, IM_COL32(200, 90, 80, 70));
+    }
+
+    for (size_t bar = 0; bar < barCount; ++bar) {
+        const float value = static_cast<float>(state.array[bar * count / barCount]);
         const float barHeight = (value / maxValue) * maxHeight;
-        const float x = pos.x + padding + i * barWidth;
+        const float x = pos.x + padding + bar * barWidth;
         const float y = pos.y + height + padding;
         
-        // Determine bar color based on its role
-        ImU32 color;
-        if (std::find(state.highlightIndices.begin(), state.highlightIndices.end(), i) != state.highlightIndices.end()) {
-            if (i == m_sortingAlgorithm->getCurrentIndex()) {
-                color = IM_COL32(255, 100, 100, 255); // Pivot/Current element (red)
-            } else if (i == m_sortingAlgorithm->getCompareIndex()) {
-                color = IM_COL32(100, 255, 100, 255); // Compare element (green)
-            } else {
-                color = IM_COL32(255, 200, 100, 255); // Other highlighted elements (orange)
-            }
-        } else {
-            color = IM_COL32(100, 150, 255, 255); // Normal elements (blue)
-        }
-        
         // Draw bar
         drawList->AddRectFilled(
             ImVec2(x, y),
-            ImVec2(x + barWidth - 1, y - barHeight),
-            color
+            ImVec2(x + barWidth - barGap, y - barHeight),
+            roleColor(m_barRoles[bar])
         );
     }
     
+    for (const auto& highlight : state.highlights) {
+        if (highlight.index >= 0 && static_cast<size_t>(highlight.index) < count) {
+            m_barRoles[static_cast<size_t>(highlight.index) * barCount / count] = HighlightRole::NONE;
+        }
+    }
+    
+    float stripTop = pos.y + padding;
+    if (bucketCount > 0) {
+        drawStrip(drawList, ImVec2(pos.x + padding, stripTop), width, stripHeight, buckets, bucketCount, 0.0f,
+                  IM_COL32(35, 50, 45, 255), IM_COL32(110, 210, 170, 255));
+        stripTop += stripHeight + 10.0f;
+    }
+    if (!aux.empty()) {
+        drawStrip(drawList, ImVec2(pos.x + padding, stripTop), width, stripHeight, aux.data(), aux.size(), maxValue,
+                  IM_COL32(45, 40, 55, 255), IM_COL32(170, 130, 220, 255));
+    }
+    
     // Draw legend
     const float legendY = pos.y + height + padding + 10.0f;
     const float legendX = pos.x + padding;
     const float legendSpacing = 150.0f;
     
-    // Pivot element
-    drawList->AddRectFilled(
-        ImVec2(legendX, legendY),
-        ImVec2(legendX + 20, legendY + 20),
-        IM_COL32(255, 100, 100, 255)
-    );
-    drawList->AddText(
-        ImVec2(legendX + 25, legendY),
-        IM_COL32(255, 255, 255, 255),
-        "Pivot/Current"
-    );
-    
-    // Compare element
-    drawList->AddRectFilled(
-        ImVec2(legendX + legendSpacing, legendY),
-        ImVec2(legendX + legendSpacing + 20, legendY + 20),
-        IM_COL32(100, 255, 100, 255)
-    );
-    drawList->AddText(
-        ImVec2(legendX + legendSpacing + 25, legendY),
-        IM_COL32(255, 255, 255, 255),
-        "Compare"
-    );
+    const struct {
+        HighlightRole role;
+        const char* label;
+    } legend[] = {
+        {HighlightRole::PIVOT, "Pivot"},
+        {HighlightRole::COMPARE, "Compare"},
+        {HighlightRole::WRITE, "Write"},
+        {HighlightRole::BOUNDARY, "Partition"}
+    };
     
-    // Other highlighted
-    drawList->AddRectFilled(
-        ImVec2(legendX + legendSpacing * 2, legendY),
-        ImVec2(legendX + legendSpacing * 2 + 20, legendY + 20),
-        IM_COL32(255, 200, 100, 255)
-    );
-    drawList->AddText(
-        ImVec2(legendX + legendSpacing * 2 + 25, legendY),
-        IM_COL32(255, 255, 255, 255),
-        "Partition"
-    );
+    for (size_t i = 0; i < IM_ARRAYSIZE(legend); ++i) {
+        const float x = legendX + legendSpacing * i;
+        drawList->AddRectFilled(
+            ImVec2(x, legendY),
+            ImVec2(x + 20, legendY + 20),
+            roleColor(legend[i].role)
+        );
+        drawList->AddText(
+            ImVec2(x + 25, legendY),
+            IM_COL32(255, 255, 255, 255),
+            legend[i].label
+        );
+    }
     
     ImGui::End();
 }
 
+void VisualizationManager::renderSortingNetwork(const SortingAlgorithm& sorter) {
+    const auto& progress = sorter.getNetworkProgress();
+    if (!progress.network) return;
+    const kernels::SortingNetwork& network = *progress.network;
+    const auto& array = sorter.getState().array;
+
+    ImGui::Begin("Sorting Network");
+    ImGui::Text("%s on keys %lld to %lld: %lld wires, %d layers, %zu comparators", network.name(),
+        static_cast<long long>(progress.begin), static_cast<long long>(progress.begin + progress.size - 1),
+        static_cast<long long>(network.size()), network.layerCount(), network.comparatorCount());
+
+    // Comparators of a layer touch disjoint wires but their spans can
+    // overlap, so those are drawn side by side in columns of their own
+    m_networkColumns.assign(network.comparatorCount(), 0);
+    std::vector<int> layerColumns(network.layerCount(), 0);
+    int totalColumns = 0;
+    for (int layer = 0; layer < network.layerCount(); ++layer) {
+        std::vector<int> columnEnds;
+        for (const auto* c = network.layerBegin(layer); c != network.layerEnd(layer); ++c) {
+            size_t column = 0;
+            while (column < columnEnds.size() && columnEnds[column] >= c->low) ++column;
+            if (column == columnEnds.size()) columnEnds.push_back(0);
+            columnEnds[column] = c->high;
+            m_networkColumns[c - network.layerBegin(0)] = static_cast<int>(column);
+        }
+        layerColumns[layer] = static_cast<int>(columnEnds.size());
+        totalColumns += layerColumns[layer] + 1;
+    }
+
+    const float labelWidth = 60.0f;
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    const ImVec2 availSize = ImGui::GetContentRegionAvail();
+    const float rowHeight = availSize.y / std::max<float>(static_cast<float>(network.size()), 1.0f);
+    const float columnWidth = (availSize.x - labelWidth) / std::max(totalColumns, 1);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    const auto wireY = [&](int wire) { return pos.y + (wire + 0.5f) * rowHeight; };
+
+    // Wires past the range carry padding larger than any key
+    for (int wire = 0; wire < network.size(); ++wire) {
+        const bool padding = wire >= progress.size;
+        char label[32];
+        if (padding) {
+            snprintf(label, sizeof(label), "-");
+        } else {
+            snprintf(label, sizeof(label), "%d", array[static_cast<size_t>(progress.begin + wire)]);
+        }
+        drawList->AddText(ImVec2(pos.x, wireY(wire) - 7.0f), IM_COL32(200, 200, 200, padding ? 80 : 255), label);
+        drawList->AddLine(ImVec2(pos.x + labelWidth, wireY(wire)), ImVec2(pos.x + availSize.x, wireY(wire)),
+                          IM_COL32(90, 90, 90, padding ? 80 : 255));
+    }
+
+    // Applied layers dim, the one being applied in the write color
+    float layerX = pos.x + labelWidth + columnWidth / 2;
+    for (int layer = 0; layer < network.layerCount(); ++layer) {
+        const ImU32 color = layer < progress.layer ? IM_COL32(110, 110, 110, 255)
+                          : layer == progress.layer ? roleColor(HighlightRole::WRITE)
+                          : IM_COL32(220, 220, 220, 255);
+        for (const auto* c = network.layerBegin(layer); c != network.layerEnd(layer); ++c) {
+            const float x = layerX + m_networkColumns[c - network.layerBegin(0)] * columnWidth;
+            const ImU32 comparatorColor = c->high >= progress.size ? (color & ~IM_COL32_A_MASK) | IM_COL32(0, 0, 0, 60) : color;
+            drawList->AddLine(ImVec2(x, wireY(c->low)), ImVec2(x, wireY(c->high)), comparatorColor, 2.0f);
+            drawList->AddCircleFilled(ImVec2(x, wireY(c->low)), 3.0f, comparatorColor);
+            drawList->AddCircleFilled(ImVec2(x, wireY(c->high)), 3.0f, comparatorColor);
+        }
+        layerX += (layerColumns[layer] + 1) * columnWidth;
+    }
+
+    ImGui::End();
+}
+
 void VisualizationManager::renderControls() {
     ImGui::Begin("Controls");
     
-    if (ImGui::Button(m_isPaused ? "Play" : "Pause")) {
-        m_isPaused = !m_isPaused;
+    if (ImGui::Button(m_isPaused || m_playReverse ? "Play" : "Pause")) {
+        m_isPaused = !m_isPaused && !m_playReverse;
+        m_playReverse = false;
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button(m_isPaused || !m_playReverse ? "Play Reverse" : "Pause##Reverse")) {
+        m_isPaused = !m_isPaused && m_playReverse;
+        m_playReverse = true;
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button("Step Back") && m_isPaused) {
+        m_sortingAlgorithm->stepBack();
+        if (m_comparison) m_comparison->stepBack();
     }
     
     ImGui::SameLine();
     if (ImGui::Button("Step") && m_isPaused) {
         m_sortingAlgorithm->step();
+        if (m_comparison) m_comparison->step();
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button("Run Native")) {
+        m_sortingAlgorithm->runToCompletion();
+        if (m_comparison) m_comparison->runToCompletion();
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button("Record")) {
+        m_sortingAlgorithm->recordRun();
+        syncComparison();
+        m_isPaused = true;
     }
     
     ImGui::SameLine();
     if (ImGui::Button("Reset")) {
         m_sortingAlgorithm->reset();
+        syncComparison();
         m_isPaused = true;
     }
     
+    // Sorts copies of the array, so the run on screen carries on as it was
+    ImGui::SameLine();
+    if (ImGui::Button("SIMD Benchmark")) {
+        m_simdBenchmark = m_sortingAlgorithm->benchmarkSimd();
+        m_hasSimdBenchmark = true;
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::Button("Time Uninstrumented")) {
+        m_uninstrumentedTime = m_sortingAlgorithm->timeUninstrumented();
+        m_hasUninstrumentedTime = true;
+    }
+    
     ImGui::Separator();
     
-    const char* algorithms[] = {
-        "Quick Sort", "Merge Sort", "Bubble Sort", "Heap Sort"
+    const auto algorithmName = [](void*, int index, const char** name) {
+        *name = SortingAlgorithm::getAlgorithmName(static_cast<SortingAlgorithm::AlgorithmType>(index));
+        return true;
     };
     static int currentAlgo = 0;
     
-    if (ImGui::Combo("Algorithm", &currentAlgo, algorithms, IM_ARRAYSIZE(algorithms))) {
+    if (ImGui::Combo("Algorithm", &currentAlgo, algorithmName, nullptr, SortingAlgorithm::kAlgorithmCount)) {
         m_sortingAlgorithm->setAlgorithm(static_cast<SortingAlgorithm::AlgorithmType>(currentAlgo));
         m_sortingAlgorithm->reset();
+        syncComparison();
+        m_isPaused = true;
+    }
+    
+    const auto patternName = [](void*, int index, const char** name) {
+        *name = SortingAlgorithm::getInputPatternName(static_cast<SortingAlgorithm::InputPattern>(index));
+        return true;
+    };
+    int pattern = static_cast<int>(m_sortingAlgorithm->getInputPattern());
+    if (ImGui::Combo("Input", &pattern, patternName, nullptr, SortingAlgorithm::kInputPatternCount)) {
+        m_sortingAlgorithm->setInputPattern(static_cast<SortingAlgorithm::InputPattern>(pattern));
+        syncComparison();
         m_isPaused = true;
     }
     
-    ImGui::SliderFloat("Speed", &m_speed, 0.1f, 5.0f);
+    // Index 0 is "None", the algorithms follow
+    const auto comparisonName = [](void*, int index, const char** name) {
+        *name = index == 0 ? "None" : SortingAlgorithm::getAlgorithmName(static_cast<SortingAlgorithm::AlgorithmType>(index - 1));
+        return true;
+    };
+    int comparisonItem = m_comparisonAlgorithm + 1;
+    if (ImGui::Combo("Compare With", &comparisonItem, comparisonName, nullptr, SortingAlgorithm::kAlgorithmCount + 1)) {
+        m_comparisonAlgorithm = comparisonItem - 1;
+        if (m_comparisonAlgorithm < 0) {
+            m_comparison.reset();
+        } else {
+            if (!m_comparison) {
+                m_comparison = std::make_unique<SortingAlgorithm>(0);
+                m_comparison->setRadixBits(m_sortingAlgorithm->getRadixBits());
+            }
+            m_comparison->setAlgorithm(static_cast<SortingAlgorithm::AlgorithmType>(m_comparisonAlgorithm));
+            m_sortingAlgorithm->reset();
+            syncComparison();
+        }
+        m_isPaused = true;
+    }
+    
+    // Wider radix digits take fewer passes over more buckets
+    const auto isRadix = [](const SortingAlgorithm& sorter) {
+        return sorter.getAlgorithmType() == SortingAlgorithm::AlgorithmType::RADIX_SORT;
+    };
+    if (isRadix(*m_sortingAlgorithm) || (m_comparison && isRadix(*m_comparison))) {
+        const unsigned digitBits[] = {8, 11, 16};
+        const char* digitNames[] = {"8 bits", "11 bits", "16 bits"};
+        int digitItem = static_cast<int>(std::find(std::begin(digitBits), std::end(digitBits),
+                                                   m_sortingAlgorithm->getRadixBits()) - std::begin(digitBits));
+        if (ImGui::Combo("Digit Width", &digitItem, digitNames, IM_ARRAYSIZE(digitNames))) {
+            m_sortingAlgorithm->setRadixBits(digitBits[digitItem]);
+            if (m_comparison) m_comparison->setRadixBits(digitBits[digitItem]);
+            m_sortingAlgorithm->reset();
+            syncComparison();
+            m_isPaused = true;
+        }
+    }
+    
+    ImGui::SliderFloat("Speed", &m_speed, 1.0f, 1.0e9f, "%.0f ops/s", ImGuiSliderFlags_Logarithmic);
     m_sortingAlgorithm->setSpeed(m_speed);
+    if (m_comparison) m_comparison->setSpeed(m_speed);
+    
+    // Applied on release, dragging through large sizes would reallocate every frame
+    const ImU64 minSize = 2;
+    const ImU64 maxSize = SortingAlgorithm::kMaxSize;
+    ImGui::SliderScalar("Array Size", ImGuiDataType_U64, &m_arraySize, &minSize, &maxSize, "%llu", ImGuiSliderFlags_Logarithmic);
+    if (ImGui::IsItemDeactivatedAfterEdit()) {
+        m_sortingAlgorithm->resize(static_cast<size_t>(m_arraySize));
+        syncComparison();
+        m_isPaused = true;
+    }
+    
+    // Trace files stream from disk, for runs too large to record in memory
+    ImGui::Separator();
+    ImGui::InputText("Trace File", m_tracePath, sizeof(m_tracePath));
+    if (ImGui::Button("Record to File")) {
+        m_traceFileFailed = !m_sortingAlgorithm->recordRunToFile(m_tracePath);
+        syncComparison();
+        m_isPaused = true;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Open Trace")) {
+        m_traceFileFailed = !m_sortingAlgorithm->openTrace(m_tracePath);
+        currentAlgo = static_cast<int>(m_sortingAlgorithm->getAlgorithmType());
+        m_arraySize = m_sortingAlgorithm->getState().array.size();
+        syncComparison();
+        m_isPaused = true;
+    }
+    if (m_traceFileFailed) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Could not write or read %s", m_tracePath);
+    }
+    if (m_sortingAlgorithm->isTraceCorrupt()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Corrupt trace, playback stopped at op %llu",
+            static_cast<unsigned long long>(m_sortingAlgorithm->getPlaybackOperation()));
+    }
+    
+    // Scrubbing restores the nearest keyframe and replays from there
+    if (m_sortingAlgorithm->isPlayingBack()) {
+        ImU64 operation = m_sortingAlgorithm->getPlaybackOperation();
+        const ImU64 firstOperation = 0;
+        const ImU64 lastOperation = m_sortingAlgorithm->getPlaybackLength();
+        if (ImGui::SliderScalar("Timeline", ImGuiDataType_U64, &operation, &firstOperation, &lastOperation, "op %llu")) {
+            m_sortingAlgorithm->seek(operation);
+            m_isPaused = true;
+        }
+    }
+    if (ImGui::SliderFloat("Keyframe Budget", &m_keyframeBudgetMB, 16.0f, 4096.0f, "%.0f MB", ImGuiSliderFlags_Logarithmic)) {
+        m_sortingAlgorithm->setKeyframeBudget(static_cast<size_t>(m_keyframeBudgetMB * 1024.0f * 1024.0f));
+    }
     
     ImGui::End();
 }
@@ -184,9 +505,98 @@ void VisualizationManager::renderMetrics() {
     
     // Performance Metrics
     ImGui::TextColored(ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "Performance Metrics:");
-    ImGui::Text("Comparisons: %d", state.comparisons);
-    ImGui::Text("Swaps: %d", state.swaps);
+    ImGui::Text("Comparisons: %llu", static_cast<unsigned long long>(state.comparisons));
+    ImGui::Text("Swaps: %llu", static_cast<unsigned long long>(state.swaps));
+    ImGui::Text("Moves: %llu", static_cast<unsigned long long>(state.moves));
+    ImGui::Text("Branch Mispredictions: %llu (%.1f%% of compares, simulated)",
+        static_cast<unsigned long long>(state.mispredictions),
+        state.comparisons == 0 ? 0.0 : 100.0 * state.mispredictions / state.comparisons);
+    // Only the quicksorts count scans, which trace playback does not replay
+    if (state.scans > 0) {
+        ImGui::Text("Scanned Elements: %llu (%.2f MB streamed, %.2f per key)",
+            static_cast<unsigned long long>(state.scans), state.scans * sizeof(int) / (1024.0 * 1024.0),
+            state.array.empty() ? 0.0 : static_cast<double>(state.scans) / state.array.size());
+    }
+    if (m_sortingAlgorithm->getAuxBytes() > 0) {
+        ImGui::Text("Aux Memory: %.2f MB", m_sortingAlgorithm->getAuxBytes() / (1024.0 * 1024.0));
+    }
+    
+    // The counting sorts are bound by memory traffic rather than compares
+    const auto& passBytes = m_sortingAlgorithm->getPassBytes();
+    for (size_t pass = 0; pass < passBytes.size(); ++pass) {
+        ImGui::Text("Pass %zu: %.2f MB moved", pass + 1, passBytes[pass] / (1024.0 * 1024.0));
+    }
+    if (m_sortingAlgorithm->getAlgorithmType() == SortingAlgorithm::AlgorithmType::AMERICAN_FLAG_SORT) {
+        ImGui::Text("Pending Buckets: %zu", m_sortingAlgorithm->getPendingBuckets());
+    }
+    // Powersort's claim is n compares on input that is nearly sorted already
+    if (m_sortingAlgorithm->getAlgorithmType() == SortingAlgorithm::AlgorithmType::POWER_SORT &&
+        !m_sortingAlgorithm->isPlayingBack()) {
+        const auto& power = m_sortingAlgorithm->getPowerSort();
+        ImGui::Text("Runs Found: %lld, Pending: %zu, Gallop After: %lld",
+            static_cast<long long>(power.runsFound), power.runCount, static_cast<long long>(power.minGallop));
+        ImGui::Text("Comparisons per Key: %.2f",
+            state.array.empty() ? 0.0 : static_cast<double>(state.comparisons) / state.array.size());
+    }
     ImGui::Text("Time: %.3f s", state.timeElapsed);
+    ImGui::Text("Native Time: %.6f s", state.nativeTime);
+    // Of the array as it was when timed, without the counters and predictor
+    if (m_hasUninstrumentedTime) {
+        ImGui::Text("Uninstrumented Time: %.6f s", m_uninstrumentedTime);
+    }
+    
+    // Recorded trace being played back
+    const auto& traceFile = m_sortingAlgorithm->getTraceFile();
+    if (traceFile.isOpen()) {
+        ImGui::Text("Trace File: %llu ops, %.2f MB in %zu chunks",
+            static_cast<unsigned long long>(traceFile.header().operationCount),
+            traceFile.fileSize() / (1024.0 * 1024.0),
+            traceFile.chunkCount());
+        ImGui::Text("Mapped Window: %.2f MB", traceFile.residentBytes() / (1024.0 * 1024.0));
+    } else if (m_sortingAlgorithm->isPlayingBack()) {
+        const auto& trace = m_sortingAlgorithm->getTrace();
+        ImGui::Text("Trace: %zu ops, %.2f MB (%.2f B/op)",
+            trace.size(),
+            trace.byteSize() / (1024.0 * 1024.0),
+            trace.empty() ? 0.0 : static_cast<double>(trace.byteSize()) / trace.size());
+    }
+    
+    if (m_sortingAlgorithm->isPlayingBack()) {
+        const auto& keyframes = m_sortingAlgorithm->getKeyframes();
+        ImGui::Text("Keyframes: %zu every %llu ops, %.2f MB",
+            keyframes.size(),
+            static_cast<unsigned long long>(keyframes.spacing()),
+            keyframes.memoryBytes() / (1024.0 * 1024.0));
+    }
+    
+    // Side by side run on the same input
+    if (m_comparison) {
+        const auto& other = m_comparison->getState();
+        ImGui::Separator();
+        ImGui::TextColored(ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "Compared With: %s", m_comparison->getAlgorithmName().c_str());
+        ImGui::Text("Comparisons: %llu (%.2fx)", static_cast<unsigned long long>(other.comparisons),
+            state.comparisons == 0 ? 0.0 : static_cast<double>(other.comparisons) / state.comparisons);
+        ImGui::Text("Swaps: %llu", static_cast<unsigned long long>(other.swaps));
+        ImGui::Text("Moves: %llu", static_cast<unsigned long long>(other.moves));
+        ImGui::Text("Branch Mispredictions: %llu (%.2fx)", static_cast<unsigned long long>(other.mispredictions),
+            state.mispredictions == 0 ? 0.0 : static_cast<double>(other.mispredictions) / state.mispredictions);
+        ImGui::Text("Native Time: %.6f s", other.nativeTime);
+    }
+    
+    // Native quicksorts against the vectorized one, on the array as it was
+    // when the benchmark ran
+    if (m_hasSimdBenchmark) {
+        ImGui::Separator();
+        ImGui::TextColored(ImVec4(0.5f, 1.0f, 0.5f, 1.0f), "SIMD Benchmark (%s):", simd::getIsaName(m_simdBenchmark.isa));
+        const auto showTimes = [](const char* keys, const SortingAlgorithm::SortTimes& times) {
+            const double vector = std::max(times.vectorQuickSort, 1e-9);
+            ImGui::Text("%s keys: quicksort %.6f s, std::sort %.6f s", keys, times.quickSort, times.stdSort);
+            ImGui::Text("  vector quicksort %.6f s (%.2fx, %.2fx)", times.vectorQuickSort,
+                times.quickSort / vector, times.stdSort / vector);
+        };
+        showTimes("32-bit", m_simdBenchmark.keys32);
+        showTimes("64-bit", m_simdBenchmark.keys64);
+    }
     
     // Array Info
     ImGui::Separator();
@@ -196,9 +606,16 @@ void VisualizationManager::renderMetrics() {
     // Current State
     ImGui::Separator();
     ImGui::TextColored(ImVec4(1.0f, 0.5f, 0.5f, 1.0f), "Current State:");
-    ImGui::Text("Current Index: %d", m_sortingAlgorithm->getCurrentIndex());
-    ImGui::Text("Compare Index: %d", m_sortingAlgorithm->getCompareIndex());
-    ImGui::Text("Partition Index: %d", m_sortingAlgorithm->getPartitionIndex());
+    ImGui::Text("Current Index: %lld", static_cast<long long>(m_sortingAlgorithm->getCurrentIndex()));
+    ImGui::Text("Compare Index: %lld", static_cast<long long>(m_sortingAlgorithm->getCompareIndex()));
+    if (const kernels::DualPartition* dual = m_sortingAlgorithm->getDualPartition()) {
+        ImGui::Text("Below Small Pivot: %lld to %lld", static_cast<long long>(dual->left + 1), static_cast<long long>(dual->less - 1));
+        ImGui::Text("Between Pivots: %lld to %lld", static_cast<long long>(dual->less),
+            static_cast<long long>(kernels::dualPivotMiddleEnd(*dual) - 1));
+        ImGui::Text("Above Large Pivot: %lld to %lld", static_cast<long long>(dual->greater + 1), static_cast<long long>(dual->right - 1));
+    } else {
+        ImGui::Text("Partition Index: %lld", static_cast<long long>(m_sortingAlgorithm->getPartitionIndex()));
+    }
     
     // Status
     ImGui::Separator();
@@ -218,6 +635,32 @@ void VisualizationManager::renderMetrics() {
             ImGui::Text("Average: O(n log n)");
             ImGui::Text("Worst: O(n²)");
             break;
+        case SortingAlgorithm::AlgorithmType::PDQ_SORT:
+            ImGui::Text("Average: O(n log n), O(n) on sorted runs");
+            ImGui::Text("Worst: O(n log n) (heap sort fallback)");
+            break;
+        case SortingAlgorithm::AlgorithmType::BLOCK_QUICK_SORT:
+            ImGui::Text("Average: O(n log n), few mispredicted branches");
+            ImGui::Text("Worst: O(n log n) (heap sort fallback)");
+            break;
+        case SortingAlgorithm::AlgorithmType::VECTOR_QUICK_SORT:
+            ImGui::Text("Average: O(n log n), %lld keys per compare instruction",
+                static_cast<long long>(simd::vectorLanes<int>(simd::detectIsa())));
+            ImGui::Text("Worst: O(n log n) (heap sort fallback)");
+            break;
+        case SortingAlgorithm::AlgorithmType::NETWORK_SORT:
+            ImGui::Text("Average: O(n log n), %zu compare-exchanges per %lld keys",
+                kernels::networkTable(kernels::kNetworkMaxSize).count, static_cast<long long>(kernels::kNetworkMaxSize));
+            ImGui::Text("Worst: O(n log n), the network's work is fixed");
+            break;
+        case SortingAlgorithm::AlgorithmType::DUAL_PIVOT_QUICK_SORT:
+            ImGui::Text("Average: O(n log n), 1.9 n ln n compares, 1.6 n ln n scans");
+            ImGui::Text("Worst: O(n²)");
+            break;
+        case SortingAlgorithm::AlgorithmType::POWER_SORT:
+            ImGui::Text("Average: O(n log n), O(n + n log k) on k runs");
+            ImGui::Text("Best: O(n), on sorted or reversed input");
+            break;
         case SortingAlgorithm::AlgorithmType::MERGE_SORT:
             ImGui::Text("Average: O(n log n)");
             ImGui::Text("Worst: O(n log n)");
@@ -227,9 +670,42 @@ void VisualizationManager::renderMetrics() {
             ImGui::Text("Worst: O(n²)");
             break;
         case SortingAlgorithm::AlgorithmType::HEAP_SORT:
+        case SortingAlgorithm::AlgorithmType::BOTTOM_UP_HEAP_SORT:
             ImGui::Text("Average: O(n log n)");
             ImGui::Text("Worst: O(n log n)");
             break;
+        case SortingAlgorithm::AlgorithmType::STD_SORT:
+            ImGui::Text("Average: O(n log n)");
+            ImGui::Text("Worst: O(n log n) (introsort)");
+            break;
+        case SortingAlgorithm::AlgorithmType::STD_STABLE_SORT:
+            ImGui::Text("Average: O(n log n)");
+            ImGui::Text("Worst: O(n log² n) without buffer");
+            break;
+        case SortingAlgorithm::AlgorithmType::STD_PARTIAL_SORT:
+            ImGui::Text("Average: O(n log k)");
+            ImGui::Text("Worst: O(n log k)");
+            break;
+        case SortingAlgorithm::AlgorithmType::STD_NTH_ELEMENT:
+            ImGui::Text("Average: O(n)");
+            ImGui::Text("Worst: O(n log n) (introselect)");
+            break;
+        case SortingAlgorithm::AlgorithmType::STD_HEAP_SORT:
+            ImGui::Text("Average: O(n log n)");
+            ImGui::Text("Worst: O(n log n)");
+            break;
+        case SortingAlgorithm::AlgorithmType::COUNTING_SORT:
+            ImGui::Text("Average: O(n + k)");
+            ImGui::Text("Worst: O(n + k), k = key range");
+            break;
+        case SortingAlgorithm::AlgorithmType::RADIX_SORT:
+            ImGui::Text("Average: O(n w / d)");
+            ImGui::Text("Worst: O(n w / d), %u-bit digits", m_sortingAlgorithm->getRadixBits());
+            break;
+        case SortingAlgorithm::AlgorithmType::AMERICAN_FLAG_SORT:
+            ImGui::Text("Average: O(n w / 8), in place");
+            ImGui::Text("Worst: O(n w / 8), in place");
+            break;
     }
     
     ImGui::End();
@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 #include "algorithms/SortingAlgorithm.hpp"
+#include "algorithms/SimdSort.hpp"
+#include "algorithms/SortEngine.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
 
 class SortingAlgorithmTest : public ::testing::Test {
 protected:
@@ -39,3 +44,1284 @@ TEST_F(SortingAlgorithmTest, MetricsAreTracked) {
     const auto& stateAfterStep = sorter->getState();
     EXPECT_GT(stateAfterStep.comparisons, 0);
 }
+
+TEST_F(SortingAlgorithmTest, StepNRunsBatches) {
+    sorter->setAlgorithm(SortingAlgorithm::AlgorithmType::BUBBLE_SORT);
+
+    EXPECT_EQ(sorter->stepN(5), 5u);
+    EXPECT_EQ(sorter->getState().comparisons, 5);
+
+    sorter->stepN(SIZE_MAX);
+    EXPECT_TRUE(sorter->isFinished());
+    EXPECT_TRUE(isSorted(sorter->getState().array));
+}
+
+TEST_F(SortingAlgorithmTest, AdvanceFollowsSpeed) {
+    sorter->setAlgorithm(SortingAlgorithm::AlgorithmType::BUBBLE_SORT);
+    sorter->setSpeed(100.0f);
+
+    EXPECT_EQ(sorter->advance(0.005, 1.0), 0u);
+    EXPECT_EQ(sorter->advance(0.005, 1.0), 1u);
+    EXPECT_EQ(sorter->advance(0.03, 1.0), 3u);
+}
+
+TEST_F(SortingAlgorithmTest, QuickSortCompletes) {
+    sorter->setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+
+    sorter->stepN(SIZE_MAX);
+
+    EXPECT_TRUE(sorter->isFinished());
+    EXPECT_TRUE(isSorted(sorter->getState().array));
+}
+
+TEST_F(SortingAlgorithmTest, NativeRunMatchesStepping) {
+    for (int i = 0; i < SortingAlgorithm::kAlgorithmCount; ++i) {
+        const auto type = static_cast<SortingAlgorithm::AlgorithmType>(i);
+        SortingAlgorithm stepped(200);
+        stepped.setAlgorithm(type);
+        SortingAlgorithm native = stepped;
+        SCOPED_TRACE(SortingAlgorithm::getAlgorithmName(type));
+
+        // Timing the uninstrumented loop sorts a copy and leaves the run alone
+        const std::vector<int> input = native.getState().array;
+        EXPECT_GE(native.timeUninstrumented(), 0.0);
+        EXPECT_EQ(native.getState().array, input);
+
+        stepped.stepN(SIZE_MAX);
+        native.runToCompletion();
+
+        EXPECT_TRUE(native.isFinished());
+        EXPECT_EQ(native.getState().array, stepped.getState().array);
+        EXPECT_EQ(native.getState().comparisons, stepped.getState().comparisons);
+        EXPECT_EQ(native.getState().swaps, stepped.getState().swaps);
+        EXPECT_EQ(native.getState().moves, stepped.getState().moves);
+        EXPECT_EQ(native.getState().mispredictions, stepped.getState().mispredictions);
+        EXPECT_EQ(native.getState().scans, stepped.getState().scans);
+    }
+}
+
+namespace {
+    struct CountUp {
+        Coroutine co;
+        int i = 0;
+
+        int next() {
+            CO_BEGIN(co);
+            for (i = 0; i < 3; ++i) {
+                CO_YIELD(co, i);
+            }
+            CO_END(co);
+            return -1;
+        }
+    };
+}
+
+TEST_F(SortingAlgorithmTest, MergeSortPingPongsThroughTheAuxBuffer) {
+    // 1024 elements take an even number of passes, 1500 an odd one that
+    // starts by sorting pairs in place
+    for (size_t size : {1024u, 1500u}) {
+        SortingAlgorithm sorter(size);
+        sorter.setAlgorithm(SortingAlgorithm::AlgorithmType::MERGE_SORT);
+        EXPECT_EQ(sorter.getAuxBytes(), size * sizeof(int));
+
+        // Stepping back through the pass into the aux buffer restores it
+        sorter.stepN(size + 10);
+        const std::vector<int> aux = sorter.getAuxArray();
+        const std::vector<int> array = sorter.getState().array;
+        sorter.stepN(20);
+        EXPECT_EQ(sorter.stepBack(20), 20u);
+        EXPECT_EQ(sorter.getAuxArray(), aux);
+        EXPECT_EQ(sorter.getState().array, array);
+
+        sorter.stepN(SIZE_MAX);
+        SCOPED_TRACE(size);
+        EXPECT_TRUE(sorter.isFinished());
+        EXPECT_TRUE(isSorted(sorter.getState().array));
+
+        // Every pass moves each element once; an in-place pair pass swaps instead
+        const OpCount passes = static_cast<OpCount>(kernels::mergePassCount(static_cast<SortIndex>(size)));
+        const OpCount mergePasses = passes % 2 == 0 ? passes : passes - 1;
+        EXPECT_EQ(sorter.getState().moves, mergePasses * size);
+        EXPECT_LE(sorter.getState().comparisons, passes * size);
+    }
+}
+
+TEST_F(SortingAlgorithmTest, HeapSortsHandleTinyArrays) {
+    const SortingAlgorithm::AlgorithmType types[] = {
+        SortingAlgorithm::AlgorithmType::HEAP_SORT,
+        SortingAlgorithm::AlgorithmType::BOTTOM_UP_HEAP_SORT
+    };
+    for (auto type : types) {
+        for (size_t size = 0; size < 6; ++size) {
+            SortingAlgorithm sorter(size);
+            sorter.setAlgorithm(type);
+            sorter.stepN(SIZE_MAX);
+            EXPECT_TRUE(sorter.isFinished());
+            EXPECT_TRUE(isSorted(sorter.getState().array));
+        }
+    }
+}
+
+TEST_F(SortingAlgorithmTest, CountingSortMovesEachElementTwice) {
+    SortingAlgorithm sorter(1000);
+    sorter.setAlgorithm(SortingAlgorithm::AlgorithmType::COUNTING_SORT);
+    size_t bucketCount = 0;
+    EXPECT_NE(sorter.getBuckets(bucketCount), nullptr);
+    EXPECT_EQ(bucketCount, 1000u);
+
+    sorter.stepN(SIZE_MAX);
+    EXPECT_TRUE(isSorted(sorter.getState().array));
+    EXPECT_EQ(sorter.getState().comparisons, 0u);
+    EXPECT_EQ(sorter.getState().moves, 2000u);
+    EXPECT_EQ(sorter.getPassBytes(), std::vector<uint64_t>(2, 2000 * sizeof(int)));
+}
+
+TEST_F(SortingAlgorithmTest, RadixSortSkipsDigitsEveryKeyShares) {
+    // Keys below 1024 vary in two 8-bit digits but only the lowest 11- or
+    // 16-bit one, which then ends in the aux buffer and is copied back
+    const size_t n = 1000;
+    const uint64_t countBytes = n * sizeof(int);
+    const uint64_t scatterBytes = 2 * n * sizeof(int);
+    const std::pair<unsigned, std::vector<uint64_t>> expected[] = {
+        {8u, {countBytes, scatterBytes, scatterBytes}},
+        {11u, {countBytes, scatterBytes, scatterBytes}},
+        {16u, {countBytes, scatterBytes, scatterBytes}}
+    };
+    for (const auto& widthAndPasses : expected) {
+        SortingAlgorithm sorter(n);
+        sorter.setAlgorithm(SortingAlgorithm::AlgorithmType::RADIX_SORT);
+        sorter.setRadixBits(widthAndPasses.first);
+        SortingAlgorithm native = sorter;
+
+        sorter.stepN(SIZE_MAX);
+        native.runToCompletion();
+        SCOPED_TRACE(widthAndPasses.first);
+        EXPECT_TRUE(isSorted(sorter.getState().array));
+        EXPECT_EQ(sorter.getPassBytes(), widthAndPasses.second);
+        EXPECT_EQ(native.getPassBytes(), widthAndPasses.second);
+        EXPECT_EQ(sorter.getState().moves, 2 * n);
+        EXPECT_EQ(native.getState().moves, 2 * n);
+
+        size_t bucketCount = 0;
+        sorter.getBuckets(bucketCount);
+        EXPECT_EQ(bucketCount, size_t(1) << widthAndPasses.first);
+    }
+}
+
+TEST_F(SortingAlgorithmTest, AmericanFlagSortSortsInPlace) {
+    for (size_t size : {0u, 1u, 31u, 32u, 5000u}) {
+        SortingAlgorithm sorter(size);
+        sorter.setAlgorithm(SortingAlgorithm::AlgorithmType::AMERICAN_FLAG_SORT);
+        sorter.stepN(SIZE_MAX);
+
+        SCOPED_TRACE(size);
+        EXPECT_TRUE(sorter.isFinished());
+        EXPECT_TRUE(isSorted(sorter.getState().array));
+        EXPECT_EQ(sorter.getAuxBytes(), 0u);
+        EXPECT_EQ(sorter.getState().moves, 0u);
+        EXPECT_EQ(sorter.getPendingBuckets(), 0u);
+        EXPECT_EQ(sorter.getPassBytes().size(), 4u);
+    }
+
+    // Keys below 5000 share their top two bytes, so only the lower two
+    // digits take any traffic beyond the counting
+    SortingAlgorithm sorter(5000);
+    sorter.setAlgorithm(SortingAlgorithm::AlgorithmType::AMERICAN_FLAG_SORT);
+    sorter.runToCompletion();
+    const auto& passBytes = sorter.getPassBytes();
+    EXPECT_EQ(passBytes[0], 5000 * sizeof(int));
+    EXPECT_EQ(passBytes[1], 5000 * sizeof(int));
+    EXPECT_GT(passBytes[2], 5000 * sizeof(int));
+    EXPECT_GT(passBytes[3], 0u);
+}
+
+TEST_F(SortingAlgorithmTest, PdqSortDefeatsOrderedInputs) {
+    const size_t n = 3000;
+    OpCount logN = 0;
+    for (size_t i = n; i > 1; i /= 2) logN++;
+
+    for (int p = 0; p < SortingAlgorithm::kInputPatternCount; ++p) {
+        const auto pattern = static_cast<SortingAlgorithm::InputPattern>(p);
+        SortingAlgorithm pdq(n);
+        pdq.setAlgorithm(SortingAlgorithm::AlgorithmType::PDQ_SORT);
+        pdq.setInputPattern(pattern);
+        SortingAlgorithm native = pdq;
+        SortingAlgorithm classic = pdq;
+        classic.setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+
+        pdq.stepN(SIZE_MAX);
+        native.runToCompletion();
+        classic.runToCompletion();
+
+        SCOPED_TRACE(SortingAlgorithm::getInputPatternName(pattern));
+        EXPECT_TRUE(isSorted(pdq.getState().array));
+        EXPECT_EQ(native.getState().array, pdq.getState().array);
+        EXPECT_EQ(native.getState().comparisons, pdq.getState().comparisons);
+        EXPECT_EQ(native.getState().swaps, pdq.getState().swaps);
+        EXPECT_LT(pdq.getState().comparisons, 2 * n * logN);
+        if (pattern != SortingAlgorithm::InputPattern::SHUFFLED) {
+            EXPECT_LT(pdq.getState().comparisons * 5, classic.getState().comparisons);
+        }
+    }
+
+    // Sorted input is finished by the partial insertion sorts in linear time
+    SortingAlgorithm sorted(n);
+    sorted.setInputPattern(SortingAlgorithm::InputPattern::SORTED);
+    sorted.setAlgorithm(SortingAlgorithm::AlgorithmType::PDQ_SORT);
+    sorted.runToCompletion();
+    EXPECT_LT(sorted.getState().comparisons, 3 * n);
+}
+
+TEST_F(SortingAlgorithmTest, DualPivotQuickSortScansFewerElements) {
+    SortingAlgorithm dual(5000);
+    dual.setAlgorithm(SortingAlgorithm::AlgorithmType::DUAL_PIVOT_QUICK_SORT);
+    SortingAlgorithm classic = dual;
+    classic.setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+
+    auto checkRegions = [&dual]() {
+        const kernels::DualPartition* p = dual.getDualPartition();
+        const std::vector<int>& a = dual.getState().array;
+        ASSERT_LE(a[p->left], a[p->right]);
+        for (SortIndex i = p->left + 1; i < p->less; ++i) ASSERT_LT(a[i], a[p->left]);
+        for (SortIndex i = p->less; i < kernels::dualPivotMiddleEnd(*p); ++i) {
+            ASSERT_GE(a[i], a[p->left]);
+            ASSERT_LT(a[i], a[p->right]);
+        }
+        for (SortIndex i = p->greater + 1; i < p->right; ++i) ASSERT_GE(a[i], a[p->right]);
+    };
+
+    // Every step leaves the regions of the partition in progress in order
+    std::vector<kernels::DualPartition> partitions;
+    std::vector<bool> partitioning;
+    for (int step = 0; step < 20000 && dual.step(); ++step) {
+        const kernels::DualPartition* p = dual.getDualPartition();
+        partitions.push_back(p ? *p : kernels::DualPartition{});
+        partitioning.push_back(p != nullptr);
+        if (p && step % 97 == 0) checkRegions();
+    }
+
+    // Stepping back brings back the partition as it was then, or none if the
+    // step then was sorting a small range instead
+    ASSERT_EQ(dual.stepBack(200), 200u);
+    const kernels::DualPartition& before = partitions[partitions.size() - 201];
+    const kernels::DualPartition* p = dual.getDualPartition();
+    ASSERT_EQ(p != nullptr, partitioning[partitions.size() - 201]);
+    if (p) {
+        EXPECT_EQ(p->left, before.left);
+        EXPECT_EQ(p->right, before.right);
+        EXPECT_EQ(p->less, before.less);
+        EXPECT_EQ(p->scan, before.scan);
+        EXPECT_EQ(p->greater, before.greater);
+        checkRegions();
+    }
+
+    dual.runToCompletion();
+    classic.runToCompletion();
+
+    EXPECT_TRUE(isSorted(dual.getState().array));
+    EXPECT_EQ(dual.getDualPartition(), nullptr);
+    EXPECT_LT(dual.getState().comparisons, classic.getState().comparisons * 11 / 10);
+    EXPECT_LT(dual.getState().scans * 3, classic.getState().scans * 2);
+}
+
+TEST_F(SortingAlgorithmTest, PowerSortIsLinearOnNearlySortedInput) {
+    const size_t n = 3000;
+    for (int p = 0; p < SortingAlgorithm::kInputPatternCount; ++p) {
+        const auto pattern = static_cast<SortingAlgorithm::InputPattern>(p);
+        SortingAlgorithm power(n);
+        power.setAlgorithm(SortingAlgorithm::AlgorithmType::POWER_SORT);
+        power.setInputPattern(pattern);
+        if (pattern == SortingAlgorithm::InputPattern::APPENDED) {
+            // The pattern appends random keys, so its bound gets fixed ones
+            std::vector<int> keys(n);
+            std::iota(keys.begin(), keys.end(), 0);
+            std::shuffle(keys.begin(), keys.end(), std::mt19937_64(24));
+            std::sort(keys.begin(), keys.end() - n / 32);
+            power.setArray(keys);
+        }
+        SortingAlgorithm native = power;
+        SortingAlgorithm merge = power;
+        merge.setAlgorithm(SortingAlgorithm::AlgorithmType::MERGE_SORT);
+
+        power.stepN(SIZE_MAX);
+        native.runToCompletion();
+        merge.runToCompletion();
+
+        SCOPED_TRACE(SortingAlgorithm::getInputPatternName(pattern));
+        EXPECT_TRUE(isSorted(power.getState().array));
+        EXPECT_EQ(native.getState().array, power.getState().array);
+        EXPECT_EQ(native.getState().comparisons, power.getState().comparisons);
+        EXPECT_EQ(native.getState().moves, power.getState().moves);
+        EXPECT_LE(power.getState().comparisons, merge.getState().comparisons);
+        EXPECT_LE(power.getAuxArray().size(), n / 2);
+        switch (pattern) {
+            case SortingAlgorithm::InputPattern::SORTED:
+            case SortingAlgorithm::InputPattern::REVERSED:
+                // One run, found with n - 1 compares and nothing else
+                EXPECT_EQ(power.getState().comparisons, n - 1);
+                break;
+            case SortingAlgorithm::InputPattern::ORGAN_PIPE:
+                // Two runs, then one merge that interleaves them
+                EXPECT_LE(power.getState().comparisons, 2 * n);
+                break;
+            case SortingAlgorithm::InputPattern::APPENDED:
+                // The late keys are sorted on their own and galloped into
+                // place; a plain merge of them would take it past 2n
+                EXPECT_LT(power.getState().comparisons, 3 * n / 2);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+TEST_F(SortingAlgorithmTest, BlockQuickSortAvoidsMispredictions) {
+    const size_t n = 5000;
+    for (int p = 0; p < SortingAlgorithm::kInputPatternCount; ++p) {
+        const auto pattern = static_cast<SortingAlgorithm::InputPattern>(p);
+        SortingAlgorithm block(n);
+        block.setAlgorithm(SortingAlgorithm::AlgorithmType::BLOCK_QUICK_SORT);
+        block.setInputPattern(pattern);
+        SortingAlgorithm native = block;
+
+        block.stepN(SIZE_MAX);
+        native.runToCompletion();
+
+        SCOPED_TRACE(SortingAlgorithm::getInputPatternName(pattern));
+        EXPECT_TRUE(isSorted(block.getState().array));
+        EXPECT_EQ(native.getState().array, block.getState().array);
+        EXPECT_EQ(native.getState().comparisons, block.getState().comparisons);
+        EXPECT_EQ(native.getState().swaps, block.getState().swaps);
+        EXPECT_EQ(native.getState().mispredictions, block.getState().mispredictions);
+    }
+
+    // On shuffled input about half of a branchy partition's compares go the
+    // unexpected way; the block partition branches on none of its own
+    SortingAlgorithm block(n);
+    block.setAlgorithm(SortingAlgorithm::AlgorithmType::BLOCK_QUICK_SORT);
+    SortingAlgorithm classic = block;
+    SortingAlgorithm pdq = block;
+    classic.setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+    pdq.setAlgorithm(SortingAlgorithm::AlgorithmType::PDQ_SORT);
+    block.runToCompletion();
+    classic.runToCompletion();
+    pdq.runToCompletion();
+    EXPECT_GT(classic.getState().mispredictions * 4, classic.getState().comparisons);
+    EXPECT_LT(block.getState().mispredictions * 3, classic.getState().mispredictions);
+    EXPECT_LT(block.getState().mispredictions * 3, pdq.getState().mispredictions);
+
+    // All-equal keys partition as badly as possible until heap sort takes over
+    std::vector<int> keys(5000, 7);
+    keys[1234] = 3;
+    SortEngine<int> engine;
+    engine.blockQuickSort(keys.data(), keys.size());
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    EXPECT_LT(engine.getPolicy().comparisons, 5000u * 13 * 6);
+}
+
+namespace {
+    // Instruction sets this CPU runs, the scalar fallback included
+    std::vector<simd::Isa> supportedIsas() {
+        std::vector<simd::Isa> isas;
+        for (simd::Isa isa : {simd::Isa::SCALAR, simd::Isa::AVX2, simd::Isa::AVX512}) {
+            if (isa <= simd::detectIsa()) isas.push_back(isa);
+        }
+        return isas;
+    }
+}
+
+TEST(SimdSortTest, PartitionLeavesKeysWhereTheModelDoes) {
+    std::mt19937_64 random(42);
+    for (simd::Isa isa : supportedIsas()) {
+        SCOPED_TRACE(simd::getIsaName(isa));
+        for (SortIndex n : {2, 9, 17, 32, 33, 40, 64, 100, 1000, 4099}) {
+            std::vector<int32_t> keys32(static_cast<size_t>(n));
+            std::vector<int64_t> keys64(static_cast<size_t>(n));
+            for (SortIndex i = 0; i < n; ++i) {
+                keys32[i] = static_cast<int32_t>(random() % 50) - 25;
+                keys64[i] = static_cast<int64_t>(random() % 50) - 25;
+            }
+            keys32[0] = 0;
+            keys64[0] = 0;
+
+            std::vector<int32_t> model32 = keys32;
+            std::vector<int64_t> model64 = keys64;
+            NoInstrument policy;
+            ArrayView<int32_t, std::less<int32_t>, NoInstrument> view32(model32.data(), n, std::less<int32_t>(), policy);
+            ArrayView<int64_t, std::less<int64_t>, NoInstrument> view64(model64.data(), n, std::less<int64_t>(), policy);
+            const SortIndex boundary32 = kernels::vectorPartition(view32, 1, n, 0, simd::vectorLanes<int32_t>(isa));
+            const SortIndex boundary64 = kernels::vectorPartition(view64, 1, n, 0, simd::vectorLanes<int64_t>(isa));
+
+            EXPECT_EQ(simd::partition(keys32.data(), 1, n, 0, isa), boundary32);
+            EXPECT_EQ(simd::partition(keys64.data(), 1, n, 0, isa), boundary64);
+            EXPECT_EQ(keys32, model32);
+            EXPECT_EQ(keys64, model64);
+            EXPECT_TRUE(std::all_of(keys32.begin() + 1, keys32.begin() + boundary32, [](int32_t k) { return k < 0; }));
+            EXPECT_TRUE(std::all_of(keys32.begin() + boundary32, keys32.end(), [](int32_t k) { return k >= 0; }));
+        }
+    }
+}
+
+TEST(SimdSortTest, SortsKeysOnEverySupportedIsa) {
+    std::mt19937_64 random(7);
+    for (simd::Isa isa : supportedIsas()) {
+        SCOPED_TRACE(simd::getIsaName(isa));
+        for (size_t n : {0, 1, 5, 31, 32, 33, 100, 1000, 100000}) {
+            std::vector<int32_t> keys32(n);
+            std::vector<int64_t> keys64(n);
+            for (size_t i = 0; i < n; ++i) {
+                keys32[i] = static_cast<int32_t>(random());
+                keys64[i] = i % 3 == 0 ? static_cast<int64_t>(random() % 8) : static_cast<int64_t>(random());
+            }
+            if (n > 2) {
+                keys32[0] = INT32_MAX;
+                keys32[n - 1] = INT32_MIN;
+                keys64[1] = INT64_MIN;
+                keys64[n / 2] = INT64_MAX;
+            }
+            std::vector<int32_t> expected32 = keys32;
+            std::vector<int64_t> expected64 = keys64;
+            std::sort(expected32.begin(), expected32.end());
+            std::sort(expected64.begin(), expected64.end());
+
+            simd::quickSort(keys32.data(), n, isa);
+            simd::quickSort(keys64.data(), n, isa);
+            EXPECT_EQ(keys32, expected32);
+            EXPECT_EQ(keys64, expected64);
+        }
+
+        // Equal keys all go right, so every partition is as bad as can be
+        // until the heap sort fallback takes over
+        std::vector<int32_t> equal(20000, 5);
+        simd::quickSort(equal.data(), equal.size(), isa);
+        EXPECT_TRUE(std::all_of(equal.begin(), equal.end(), [](int32_t k) { return k == 5; }));
+    }
+}
+
+TEST(SortingNetworkTest, BitonicNetworksSortEveryInput) {
+    const struct {
+        SortIndex size;
+        int layers;
+        size_t comparators;
+    } expected[] = {{2, 1, 1}, {4, 3, 6}, {8, 6, 24}, {16, 10, 80}, {32, 15, 240}};
+    for (const auto& e : expected) {
+        const kernels::SortingNetwork& network = kernels::bitonicSortNetwork(e.size);
+        EXPECT_EQ(network.size(), e.size);
+        EXPECT_EQ(network.layerCount(), e.layers);
+        EXPECT_EQ(network.comparatorCount(), e.comparators);
+
+        // A layer never touches a wire twice
+        for (int layer = 0; layer < network.layerCount(); ++layer) {
+            std::vector<bool> touched(static_cast<size_t>(e.size), false);
+            for (const auto* c = network.layerBegin(layer); c != network.layerEnd(layer); ++c) {
+                EXPECT_LT(c->low, c->high);
+                EXPECT_FALSE(touched[c->low] || touched[c->high]);
+                touched[c->low] = touched[c->high] = true;
+            }
+        }
+    }
+
+    // By the 0-1 principle, sorting every input of zeros and ones proves a
+    // network sorts everything
+    for (SortIndex size : {2, 4, 8, 16}) {
+        for (uint32_t bits = 0; bits < (1u << size); ++bits) {
+            std::vector<int> keys(static_cast<size_t>(size));
+            for (SortIndex i = 0; i < size; ++i) keys[i] = bits >> i & 1;
+            NoInstrument policy;
+            ArrayView<int, std::less<int>, NoInstrument> view(keys.data(), size, std::less<int>(), policy);
+            kernels::networkSort(view, 0, size);
+            ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end())) << size << " wires, input " << bits;
+        }
+    }
+
+    // Ranges between the sizes run the next network up with its padded
+    // wires left out
+    std::mt19937_64 random(3);
+    for (SortIndex n = 0; n <= kernels::kNetworkMaxSize; ++n) {
+        for (int trial = 0; trial < 100; ++trial) {
+            std::vector<int> keys(static_cast<size_t>(n) + 2, -1);
+            for (SortIndex i = 1; i <= n; ++i) keys[i] = static_cast<int>(random() % 20);
+            SortEngine<int> engine;
+            ArrayView<int, std::less<int>, CountOps> view(keys.data(), n + 2, std::less<int>(), engine.getPolicy());
+            kernels::networkSort(view, 1, n + 1);
+            ASSERT_TRUE(std::is_sorted(keys.begin() + 1, keys.begin() + 1 + n));
+            EXPECT_EQ(keys.front(), -1);
+            EXPECT_EQ(keys.back(), -1);
+        }
+    }
+}
+
+TEST(SortingNetworkTest, SmallestNetworksSortEveryInput) {
+    // The sizes proven or best known up to 16 keys, and 185 at 32
+    const size_t known[] = {0, 0, 1, 3, 5, 9, 12, 16, 19, 25, 29, 35, 39, 45, 51, 56, 60};
+    for (SortIndex size = 0; size <= 16; ++size) EXPECT_EQ(kernels::networkTable(size).count, known[size]);
+    EXPECT_EQ(kernels::networkTable(32).count, 185u);
+
+    for (SortIndex size = 0; size <= kernels::kNetworkMaxSize; ++size) {
+        const kernels::NetworkTable& table = kernels::networkTable(size);
+        const kernels::SortingNetwork& network = kernels::smallestNetwork(size);
+        EXPECT_EQ(network.size(), size);
+        EXPECT_EQ(network.comparatorCount(), table.count);
+        EXPECT_LE(network.layerCount(), kernels::bitonicSortNetwork(kernels::networkSizeFor(size)).layerCount());
+        for (int layer = 0; layer < network.layerCount(); ++layer) {
+            std::vector<bool> touched(static_cast<size_t>(size), false);
+            for (const auto* c = network.layerBegin(layer); c != network.layerEnd(layer); ++c) {
+                EXPECT_LT(c->low, c->high);
+                EXPECT_FALSE(touched[c->low] || touched[c->high]);
+                touched[c->low] = touched[c->high] = true;
+            }
+        }
+
+        // Every input of zeros and ones up to 20 keys, 64 at a time as the
+        // bits of a word per wire; random ones past that
+        const bool exhaustive = size <= 20;
+        const uint64_t batches = !exhaustive ? 4096 : size <= 6 ? 1 : uint64_t(1) << (size - 6);
+        std::mt19937_64 random(static_cast<uint64_t>(size));
+        for (uint64_t batch = 0; batch < batches; ++batch) {
+            const uint64_t lowBits[] = {
+                0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+                0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull
+            };
+            uint64_t wires[kernels::kNetworkMaxSize];
+            for (SortIndex wire = 0; wire < size; ++wire) {
+                if (!exhaustive) {
+                    wires[wire] = random();
+                } else {
+                    wires[wire] = wire < 6 ? lowBits[wire] : (batch >> (wire - 6) & 1 ? ~uint64_t(0) : 0);
+                }
+            }
+            for (size_t c = 0; c < table.count; ++c) {
+                const auto comparator = table.comparators[c];
+                const uint64_t low = wires[comparator.low] & wires[comparator.high];
+                wires[comparator.high] |= wires[comparator.low];
+                wires[comparator.low] = low;
+            }
+            for (SortIndex wire = 0; wire + 1 < size; ++wire) {
+                ASSERT_EQ(wires[wire] & ~wires[wire + 1], 0u) << size << " keys, batch " << batch;
+            }
+        }
+
+        // Natively the kernel is the table unrolled; counted, a loop over
+        // it making exactly its compares
+        for (int trial = 0; trial < 20; ++trial) {
+            std::vector<int> keys(static_cast<size_t>(size) + 2, -1);
+            for (SortIndex i = 1; i <= size; ++i) keys[i] = static_cast<int>(random() % 20);
+            std::vector<int> unrolled = keys;
+            NoInstrument policy;
+            ArrayView<int, std::less<int>, NoInstrument> native(unrolled.data(), size + 2, std::less<int>(), policy);
+            kernels::smallestNetworkSort(native, 1, size + 1);
+
+            SortEngine<int> engine;
+            ArrayView<int, std::less<int>, CountOps> view(keys.data(), size + 2, std::less<int>(), engine.getPolicy());
+            kernels::smallestNetworkSort(view, 1, size + 1);
+            ASSERT_TRUE(std::is_sorted(keys.begin() + 1, keys.begin() + 1 + size));
+            EXPECT_EQ(keys.front(), -1);
+            EXPECT_EQ(keys.back(), -1);
+            EXPECT_EQ(engine.getPolicy().comparisons, table.count);
+            EXPECT_EQ(keys, unrolled);
+        }
+    }
+}
+
+TEST_F(SortingAlgorithmTest, NetworkSortStepsALayerAtATime) {
+    // Up to 32 keys are one network
+    SortingAlgorithm small(20);
+    small.setAlgorithm(SortingAlgorithm::AlgorithmType::NETWORK_SORT);
+    size_t steps = 0;
+    while (small.step()) ++steps;
+    EXPECT_TRUE(isSorted(small.getState().array));
+    const auto& progress = small.getNetworkProgress();
+    ASSERT_NE(progress.network, nullptr);
+    EXPECT_EQ(progress.network, &kernels::smallestNetwork(20));
+    EXPECT_EQ(steps, static_cast<size_t>(progress.network->layerCount()));
+    EXPECT_EQ(small.getState().comparisons, kernels::networkTable(20).count);
+
+    // Past that, 32-key blocks are merged; 200 keys make 7 blocks and 3
+    // passes, so the blocks shrink to 16 keys for 4 passes
+    SortingAlgorithm large(200);
+    large.setAlgorithm(SortingAlgorithm::AlgorithmType::NETWORK_SORT);
+    large.stepN(SIZE_MAX);
+    EXPECT_TRUE(isSorted(large.getState().array));
+    EXPECT_EQ(large.getNetworkProgress().begin, 192);
+    EXPECT_EQ(large.getNetworkProgress().size, 8);
+}
+
+TEST(SimdSortTest, NetworksSortInRegisters) {
+    std::mt19937_64 random(11);
+    for (simd::Isa isa : supportedIsas()) {
+        SCOPED_TRACE(simd::getIsaName(isa));
+        for (size_t n = 0; n <= static_cast<size_t>(simd::kSortSmallMax); ++n) {
+            for (int trial = 0; trial < 20; ++trial) {
+                std::vector<int32_t> keys32(n);
+                std::vector<int64_t> keys64(n);
+                for (size_t i = 0; i < n; ++i) {
+                    keys32[i] = trial % 2 ? static_cast<int32_t>(random() % 4) : static_cast<int32_t>(random());
+                    keys64[i] = trial % 2 ? static_cast<int64_t>(random() % 4) : static_cast<int64_t>(random());
+                }
+                if (n > 0 && trial == 0) {
+                    keys32[0] = INT32_MAX;
+                    keys64[0] = INT64_MAX;
+                }
+                std::vector<int32_t> expected32 = keys32;
+                std::vector<int64_t> expected64 = keys64;
+                std::sort(expected32.begin(), expected32.end());
+                std::sort(expected64.begin(), expected64.end());
+
+                simd::sortSmall(keys32.data(), n, isa);
+                simd::sortSmall(keys64.data(), n, isa);
+                ASSERT_EQ(keys32, expected32) << n << " keys";
+                ASSERT_EQ(keys64, expected64) << n << " keys";
+            }
+        }
+
+        // Two sorted vectors merge into one sorted run
+        for (int trial = 0; trial < 100; ++trial) {
+            const size_t lanes32 = static_cast<size_t>(simd::vectorLanes<int32_t>(isa));
+            const size_t lanes64 = static_cast<size_t>(simd::vectorLanes<int64_t>(isa));
+            std::vector<int32_t> keys32(2 * lanes32);
+            std::vector<int64_t> keys64(2 * lanes64);
+            for (auto& key : keys32) key = static_cast<int32_t>(random() % 100);
+            for (auto& key : keys64) key = static_cast<int64_t>(random() % 100) - 50;
+            std::sort(keys32.begin(), keys32.begin() + lanes32);
+            std::sort(keys32.begin() + lanes32, keys32.end());
+            std::sort(keys64.begin(), keys64.begin() + lanes64);
+            std::sort(keys64.begin() + lanes64, keys64.end());
+            std::vector<int32_t> expected32 = keys32;
+            std::vector<int64_t> expected64 = keys64;
+            std::sort(expected32.begin(), expected32.end());
+            std::sort(expected64.begin(), expected64.end());
+
+            simd::mergeVectors(keys32.data(), isa);
+            simd::mergeVectors(keys64.data(), isa);
+            ASSERT_EQ(keys32, expected32);
+            ASSERT_EQ(keys64, expected64);
+        }
+    }
+}
+
+TEST_F(SortingAlgorithmTest, VectorQuickSortStepsThroughNetworkLayers) {
+    SortingAlgorithm vector(20);
+    vector.setAlgorithm(SortingAlgorithm::AlgorithmType::VECTOR_QUICK_SORT);
+    EXPECT_EQ(vector.getNetworkProgress().network, nullptr);
+
+    // 20 keys are one range for the 32-wire network, 12 of its wires padding
+    vector.step();
+    const auto& progress = vector.getNetworkProgress();
+    ASSERT_NE(progress.network, nullptr);
+    EXPECT_EQ(progress.network->size(), 32);
+    EXPECT_EQ(progress.begin, 0);
+    EXPECT_EQ(progress.size, 20);
+    EXPECT_EQ(progress.layer, 0);
+
+    const OpCount comparisons = vector.getState().comparisons;
+    EXPECT_EQ(comparisons, 10u);
+    size_t steps = 1;
+    while (!vector.isFinished()) {
+        vector.step();
+        ++steps;
+    }
+    EXPECT_TRUE(isSorted(vector.getState().array));
+    EXPECT_EQ(progress.layer, progress.network->layerCount());
+    EXPECT_LE(steps, static_cast<size_t>(progress.network->layerCount()) + 1);
+}
+
+TEST(SortEngineRecordTest, PdqSortFallsBackToHeapSortOnBadPartitions) {
+    // All-equal keys put every element right of the pivot, a bad partition
+    // each time, until the heap sort fallback takes over
+    std::vector<int> keys(5000, 7);
+    keys[1234] = 3;
+    SortEngine<int> engine;
+    engine.pdqSort(keys.data(), keys.size());
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    EXPECT_LT(engine.getPolicy().comparisons, 5000u * 13 * 4);
+
+    std::vector<int> range = {9, 8, 7, 6, 5, 4, 3, 2, 1, 0};
+    SortEngine<int> heapEngine;
+    auto view = ArrayView<int, std::less<int>, CountOps>(range.data(), 10, std::less<int>(), heapEngine.getPolicy());
+    kernels::heapSortRange(view, 2, 8);
+    EXPECT_EQ(range, (std::vector<int>{9, 8, 2, 3, 4, 5, 6, 7, 1, 0}));
+}
+
+TEST_F(SortingAlgorithmTest, BottomUpHeapSortSavesComparisons) {
+    SortingAlgorithm classic(20000);
+    classic.setAlgorithm(SortingAlgorithm::AlgorithmType::HEAP_SORT);
+    SortingAlgorithm bottomUp = classic;
+    bottomUp.setAlgorithm(SortingAlgorithm::AlgorithmType::BOTTOM_UP_HEAP_SORT);
+
+    classic.stepN(SIZE_MAX);
+    bottomUp.stepN(SIZE_MAX);
+
+    EXPECT_EQ(bottomUp.getState().array, classic.getState().array);
+    EXPECT_TRUE(isSorted(bottomUp.getState().array));
+    EXPECT_LT(bottomUp.getState().comparisons, classic.getState().comparisons * 6 / 10);
+}
+
+TEST(CoroutineTest, ResumesAfterEachYield) {
+    CountUp gen;
+
+    EXPECT_EQ(gen.next(), 0);
+    EXPECT_EQ(gen.next(), 1);
+    EXPECT_EQ(gen.next(), 2);
+    EXPECT_FALSE(gen.co.isDone());
+    EXPECT_EQ(gen.next(), -1);
+    EXPECT_TRUE(gen.co.isDone());
+    EXPECT_EQ(gen.next(), -1);
+}
+
+TEST(PartitionStackTest, PopsSmallerSideFirst) {
+    PartitionStack stack;
+    stack.pushChildren({0, 99}, 10);
+
+    ASSERT_EQ(stack.size(), 2u);
+    PartitionStack::Range next = stack.pop();
+    EXPECT_EQ(next.left, 0);
+    EXPECT_EQ(next.right, 9);
+    next = stack.pop();
+    EXPECT_EQ(next.left, 11);
+    EXPECT_EQ(next.right, 99);
+
+    stack.pushChildren({0, 2}, 1);
+    EXPECT_TRUE(stack.empty());
+
+    // Three sides pop smallest first
+    stack.pushChildren({0, 99}, 60, 90);
+    ASSERT_EQ(stack.size(), 3u);
+    next = stack.pop();
+    EXPECT_EQ(next.left, 91);
+    EXPECT_EQ(next.right, 99);
+    next = stack.pop();
+    EXPECT_EQ(next.left, 61);
+    EXPECT_EQ(next.right, 89);
+    next = stack.pop();
+    EXPECT_EQ(next.left, 0);
+    EXPECT_EQ(next.right, 59);
+
+    stack.pushChildren({0, 9}, 4, 5);
+    EXPECT_EQ(stack.size(), 2u);
+}
+
+TEST_F(SortingAlgorithmTest, LargeQuickSortCompletes) {
+    SortingAlgorithm large(100000);
+    large.setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+
+    large.stepN(SIZE_MAX);
+
+    EXPECT_TRUE(large.isFinished());
+    EXPECT_TRUE(isSorted(large.getState().array));
+}
+
+TEST_F(SortingAlgorithmTest, QuickSortHighlightsCarryRoles) {
+    sorter->setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+    sorter->step();
+
+    const auto& highlights = sorter->getState().highlights;
+    ASSERT_EQ(highlights.size(), 3u);
+    EXPECT_EQ(highlights[0].index, 0);
+    EXPECT_EQ(highlights[0].role, HighlightRole::PIVOT);
+    EXPECT_EQ(highlights[1].index, 1);
+    EXPECT_EQ(highlights[1].role, HighlightRole::COMPARE);
+    EXPECT_EQ(highlights[2].role, HighlightRole::BOUNDARY);
+}
+
+TEST_F(SortingAlgorithmTest, CountersAndIndicesAre64Bit) {
+    static_assert(sizeof(SortingAlgorithm::AlgorithmState::comparisons) == 8, "64-bit comparisons");
+    static_assert(sizeof(SortingAlgorithm::AlgorithmState::swaps) == 8, "64-bit swaps");
+    static_assert(sizeof(SortIndex) == 8, "64-bit indices");
+
+    SortingAlgorithm bubble(1000);
+    bubble.setAlgorithm(SortingAlgorithm::AlgorithmType::BUBBLE_SORT);
+    bubble.runToCompletion();
+
+    EXPECT_EQ(bubble.getState().comparisons, 1000u * 999u / 2u);
+    EXPECT_TRUE(isSorted(bubble.getState().array));
+}
+
+TEST_F(SortingAlgorithmTest, ResizeRestartsWithNewSize) {
+    sorter->resize(5000);
+
+    EXPECT_EQ(sorter->getState().array.size(), 5000u);
+    EXPECT_EQ(sorter->getMaxValue(), 4999);
+    EXPECT_EQ(sorter->getState().comparisons, 0u);
+    EXPECT_FALSE(sorter->isFinished());
+}
+
+template <typename Key>
+class SortEngineTest : public ::testing::Test {};
+
+using EngineKeyTypes = ::testing::Types<int32_t, int64_t, uint64_t, float, double>;
+TYPED_TEST_SUITE(SortEngineTest, EngineKeyTypes);
+
+TYPED_TEST(SortEngineTest, SortsKeys) {
+    std::vector<TypeParam> keys(257);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<TypeParam>((i * 7919) % keys.size());
+    }
+    std::vector<TypeParam> bubbleKeys = keys;
+    std::vector<TypeParam> pdqKeys = keys;
+
+    std::vector<TypeParam> mergeKeys = keys;
+    std::vector<TypeParam> heapKeys = keys;
+    std::vector<TypeParam> bottomUpHeapKeys = keys;
+    std::vector<TypeParam> countingKeys = keys;
+    std::vector<TypeParam> radixKeys = keys;
+    std::vector<TypeParam> flagKeys = keys;
+    std::vector<TypeParam> blockKeys = keys;
+    std::vector<TypeParam> vectorKeys = keys;
+    std::vector<TypeParam> networkMergeKeys = keys;
+    std::vector<TypeParam> powerKeys = keys;
+    std::vector<TypeParam> dualPivotKeys = keys;
+
+    SortEngine<TypeParam> engine;
+    engine.quickSort(keys.data(), keys.size());
+    engine.pdqSort(pdqKeys.data(), pdqKeys.size());
+    engine.bubbleSort(bubbleKeys.data(), bubbleKeys.size());
+    engine.mergeSort(mergeKeys.data(), mergeKeys.size());
+    engine.heapSort(heapKeys.data(), heapKeys.size());
+    engine.bottomUpHeapSort(bottomUpHeapKeys.data(), bottomUpHeapKeys.size());
+    engine.countingSort(countingKeys.data(), countingKeys.size());
+    engine.radixSort(radixKeys.data(), radixKeys.size(), 11);
+    engine.americanFlagSort(flagKeys.data(), flagKeys.size());
+    engine.blockQuickSort(blockKeys.data(), blockKeys.size());
+    engine.vectorQuickSort(vectorKeys.data(), vectorKeys.size(), 8);
+    engine.networkMergeSort(networkMergeKeys.data(), networkMergeKeys.size());
+    engine.powerSort(powerKeys.data(), powerKeys.size());
+    engine.dualPivotQuickSort(dualPivotKeys.data(), dualPivotKeys.size());
+
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    EXPECT_EQ(keys, bubbleKeys);
+    EXPECT_EQ(keys, pdqKeys);
+    EXPECT_EQ(keys, mergeKeys);
+    EXPECT_EQ(keys, heapKeys);
+    EXPECT_EQ(keys, bottomUpHeapKeys);
+    EXPECT_EQ(keys, countingKeys);
+    EXPECT_EQ(keys, radixKeys);
+    EXPECT_EQ(keys, flagKeys);
+    EXPECT_EQ(keys, blockKeys);
+    EXPECT_EQ(keys, vectorKeys);
+    EXPECT_EQ(keys, networkMergeKeys);
+    EXPECT_EQ(keys, powerKeys);
+    EXPECT_EQ(keys, dualPivotKeys);
+}
+
+TYPED_TEST(SortEngineTest, RadixSortsOrderNegativeAndWideKeys) {
+    std::vector<TypeParam> keys;
+    for (int i = 0; i < 1000; ++i) {
+        const int64_t key = (static_cast<int64_t>(i) * 7919 % 1000 - 500) * 1000003;
+        keys.push_back(std::is_unsigned<TypeParam>::value ? static_cast<TypeParam>(key + 500 * 1000003)
+                                                          : static_cast<TypeParam>(key));
+    }
+    if (std::is_floating_point<TypeParam>::value) keys[3] = static_cast<TypeParam>(-0.25);
+    std::vector<TypeParam> expected = keys;
+    std::sort(expected.begin(), expected.end());
+
+    // The range is too wide for counting sort, which falls back to radix passes
+    for (unsigned bits : {8u, 11u, 16u}) {
+        std::vector<TypeParam> radixKeys = keys;
+        SortEngine<TypeParam> engine;
+        engine.radixSort(radixKeys.data(), radixKeys.size(), bits);
+        EXPECT_EQ(radixKeys, expected);
+    }
+    std::vector<TypeParam> countingKeys = keys;
+    SortEngine<TypeParam> engine;
+    engine.countingSort(countingKeys.data(), countingKeys.size());
+    EXPECT_EQ(countingKeys, expected);
+
+    std::vector<TypeParam> flagKeys = keys;
+    engine.americanFlagSort(flagKeys.data(), flagKeys.size());
+    EXPECT_EQ(flagKeys, expected);
+}
+
+TEST(SortEngineRecordTest, SortsRecordsByKeyWithCustomComparator) {
+    using Record = KeyValue<uint64_t, uint64_t>;
+    std::vector<Record> records;
+    for (uint64_t i = 0; i < 100; ++i) {
+        records.push_back(Record{(i * 37) % 100, i});
+    }
+
+    auto descending = [](const Record& a, const Record& b) { return b.key < a.key; };
+    SortEngine<Record, decltype(descending)> engine(descending);
+    engine.quickSort(records.data(), records.size());
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ(records[i].key, 99u - i);
+        EXPECT_EQ((records[i].value * 37) % 100, records[i].key);
+    }
+}
+
+TEST(SortEngineRecordTest, MergeSortKeepsEqualKeysInOrder) {
+    std::vector<KeyValue32> records;
+    for (uint32_t i = 0; i < 1000; ++i) {
+        records.push_back(KeyValue32{(i * 7919) % 10, i});
+    }
+
+    SortEngine<KeyValue32> engine;
+    engine.mergeSort(records.data(), records.size());
+
+    for (size_t i = 1; i < records.size(); ++i) {
+        ASSERT_LE(records[i - 1].key, records[i].key);
+        if (records[i - 1].key == records[i].key) {
+            EXPECT_LT(records[i - 1].value, records[i].value);
+        }
+    }
+    EXPECT_EQ(engine.getPolicy().auxWrites, engine.getPolicy().writes);
+}
+
+// Runs of every kind and length, equal keys across runs and merges long
+// enough to gallop both ways, checked against std::stable_sort
+TEST(SortEngineRecordTest, PowerSortMatchesStableSort) {
+    std::mt19937 gen(42);
+    const auto draw = [&gen](uint32_t bound) { return static_cast<uint32_t>(gen() % bound); };
+    for (uint32_t n : {0u, 1u, 2u, 63u, 64u, 65u, 1000u, 5000u}) {
+        for (int shape = 0; shape < 4; ++shape) {
+            std::vector<KeyValue32> records;
+            uint32_t key = 0;
+            while (records.size() < n) {
+                const uint32_t length = 1 + draw(shape == 0 ? 4 : 400);
+                const bool descending = draw(2) == 0;
+                if (shape == 3) key = draw(50);
+                for (uint32_t i = 0; i < length && records.size() < n; ++i) {
+                    records.push_back(KeyValue32{shape == 1 ? draw(8) : key, static_cast<uint32_t>(records.size())});
+                    if (shape != 2 || draw(4) == 0) key = descending ? key - std::min(key, 1 + draw(3)) : key + draw(3);
+                }
+            }
+            std::vector<KeyValue32> expected = records;
+            std::stable_sort(expected.begin(), expected.end());
+
+            SortEngine<KeyValue32> engine;
+            engine.powerSort(records.data(), records.size());
+
+            SCOPED_TRACE(testing::Message() << n << " keys, shape " << shape);
+            EXPECT_EQ(records, expected);
+        }
+    }
+}
+
+TEST(InstrumentationTest, PoliciesSeeTheSameRun) {
+    std::vector<int> input(500);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<int>((i * 7919) % input.size());
+    }
+
+    std::vector<int> native = input;
+    SortEngine<int, std::less<int>, NoInstrument> plain;
+    plain.quickSort(native.data(), native.size());
+
+    std::vector<int> counted = input;
+    SortEngine<int> counting;
+    counting.quickSort(counted.data(), counted.size());
+
+    std::vector<int> traced = input;
+    SortEngine<int, std::less<int>, RecordTrace> tracing;
+    tracing.quickSort(traced.data(), traced.size());
+
+    std::vector<int> cached = input;
+    SortEngine<int, std::less<int>, SimulateCache> caching(std::less<int>(), SimulateCache(sizeof(int), 256));
+    caching.quickSort(cached.data(), cached.size());
+
+    EXPECT_TRUE(std::is_sorted(native.begin(), native.end()));
+    EXPECT_EQ(counted, native);
+    EXPECT_EQ(traced, native);
+    EXPECT_EQ(cached, native);
+
+    const CountOps& counts = counting.getPolicy();
+    EXPECT_EQ(tracing.getPolicy().comparisons, counts.comparisons);
+    EXPECT_EQ(tracing.getPolicy().trace.size(), counts.comparisons + counts.swaps);
+    EXPECT_EQ(caching.getPolicy().hits + caching.getPolicy().misses,
+              2 * (counts.comparisons + counts.swaps));
+    EXPECT_GT(caching.getPolicy().misses, 0u);
+}
+
+TEST_F(SortingAlgorithmTest, StdAlgorithmsReplayIntoTheArray) {
+    sorter->resize(300);
+    sorter->setAlgorithm(SortingAlgorithm::AlgorithmType::STD_SORT);
+    sorter->stepN(SIZE_MAX);
+    EXPECT_TRUE(isSorted(sorter->getState().array));
+    EXPECT_GT(sorter->getState().comparisons, 0u);
+
+    sorter->setAlgorithm(SortingAlgorithm::AlgorithmType::STD_NTH_ELEMENT);
+    sorter->reset();
+    sorter->stepN(SIZE_MAX);
+    EXPECT_EQ(sorter->getState().array[150], 150);
+}
+
+TEST(StdSortAdapterTest, CountsMatchAPlainCountingComparator) {
+    std::vector<int> keys(1000);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>((i * 7919) % keys.size());
+    }
+    std::vector<int> plain = keys;
+
+    SortEngine<int> engine;
+    engine.stdSort(keys.data(), keys.size());
+
+    OpCount comparisons = 0;
+    std::sort(plain.begin(), plain.end(), [&](int a, int b) {
+        comparisons++;
+        return a < b;
+    });
+
+    EXPECT_EQ(keys, plain);
+    EXPECT_EQ(engine.getPolicy().comparisons, comparisons);
+}
+
+TEST_F(SortingAlgorithmTest, RecordedRunPlaysBackLikeStepping) {
+    SortingAlgorithm stepped(300);
+    stepped.setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+    SortingAlgorithm recorded = stepped;
+
+    recorded.recordRun();
+    EXPECT_TRUE(recorded.isPlayingBack());
+    EXPECT_EQ(recorded.getState().comparisons, 0u);
+    EXPECT_GT(recorded.getTrace().size(), 0u);
+
+    stepped.stepN(SIZE_MAX);
+    recorded.stepN(SIZE_MAX);
+
+    EXPECT_TRUE(recorded.isFinished());
+    EXPECT_EQ(recorded.getState().array, stepped.getState().array);
+    EXPECT_EQ(recorded.getState().comparisons, stepped.getState().comparisons);
+    EXPECT_EQ(recorded.getState().swaps, stepped.getState().swaps);
+    EXPECT_EQ(recorded.getState().mispredictions, stepped.getState().mispredictions);
+}
+
+TEST_F(SortingAlgorithmTest, TraceFilePlaysBackLikeStepping) {
+    const std::string path = ::testing::TempDir() + "sorting_test.avtrace";
+    SortingAlgorithm stepped(2000);
+    stepped.setAlgorithm(SortingAlgorithm::AlgorithmType::QUICK_SORT);
+    SortingAlgorithm recorded = stepped;
+
+    ASSERT_TRUE(recorded.recordRunToFile(path));
+    EXPECT_TRUE(recorded.isPlayingBack());
+    EXPECT_TRUE(recorded.getTraceFile().isOpen());
+    EXPECT_GT(recorded.getTraceFile().header().operationCount, 0u);
+
+    // A fresh instance restores the algorithm and the unsorted array
+    SortingAlgorithm opened(10);
+    ASSERT_TRUE(opened.openTrace(path));
+    EXPECT_EQ(opened.getAlgorithmType(), SortingAlgorithm::AlgorithmType::QUICK_SORT);
+    EXPECT_EQ(opened.getState().array, stepped.getState().array);
+
+    stepped.stepN(SIZE_MAX);
+    recorded.stepN(SIZE_MAX);
+    opened.stepN(SIZE_MAX);
+
+    EXPECT_TRUE(opened.isFinished());
+    EXPECT_EQ(recorded.getState().array, stepped.getState().array);
+    EXPECT_EQ(opened.getState().array, stepped.getState().array);
+    EXPECT_EQ(opened.getState().comparisons, stepped.getState().comparisons);
+    EXPECT_EQ(opened.getState().swaps, stepped.getState().swaps);
+
+    opened.reset();
+    recorded.reset();
+    std::remove(path.c_str());
+}
+
+TEST_F(SortingAlgorithmTest, CorruptTraceStopsPlayback) {
+    const std::string path = ::testing::TempDir() + "corrupt_test.avtrace";
+    const std::vector<int> initial = {3, 1, 2, 0};
+    trace::TraceFileWriter writer;
+    ASSERT_TRUE(writer.open(path, initial, static_cast<uint32_t>(SortingAlgorithm::AlgorithmType::QUICK_SORT)));
+    writer.append(trace::Operation{trace::OpCode::SWAP, false, 0, 3});
+    writer.append(trace::Operation{trace::OpCode::SWAP, false, 1, 1000000});
+    writer.append(trace::Operation{trace::OpCode::WRITE, false, 2, 7});
+    ASSERT_TRUE(writer.finish());
+
+    SortingAlgorithm sorter(10);
+    ASSERT_TRUE(sorter.openTrace(path));
+    EXPECT_FALSE(sorter.isTraceCorrupt());
+    sorter.stepN(SIZE_MAX);
+
+    // The swap that fits is applied, the one past the array and all after it are not
+    EXPECT_TRUE(sorter.isTraceCorrupt());
+    EXPECT_TRUE(sorter.isFinished());
+    EXPECT_EQ(sorter.getPlaybackOperation(), 1u);
+    EXPECT_EQ(sorter.getState().array, std::vector<int>({0, 1, 2, 3}));
+    EXPECT_EQ(sorter.getState().moves, 0u);
+
+    sorter.reset();
+    EXPECT_FALSE(sorter.isTraceCorrupt());
+    std::remove(path.c_str());
+}
+
+TEST_F(SortingAlgorithmTest, SeekRestoresThePlayedBackState) {
+    const std::string path = ::testing::TempDir() + "seek_test.avtrace";
+    // Merge sort also plays back through the aux buffer
+    for (int run = 0; run < 4; ++run) {
+        const int fromFile = run % 2;
+        SortingAlgorithm sorter(3000);
+        sorter.setAlgorithm(run < 2 ? SortingAlgorithm::AlgorithmType::QUICK_SORT
+                                    : SortingAlgorithm::AlgorithmType::MERGE_SORT);
+        SCOPED_TRACE(run);
+        sorter.setKeyframeBudget(64 * 1024);
+        if (fromFile) {
+            ASSERT_TRUE(sorter.recordRunToFile(path));
+        } else {
+            sorter.recordRun();
+        }
+        EXPECT_GT(sorter.getKeyframes().size(), 1u);
+        EXPECT_LE(sorter.getKeyframes().memoryBytes(), 64u * 1024u);
+
+        // Remember the state at a few points, then jump back to each
+        struct Snapshot {
+            uint64_t operation;
+            std::vector<int> array;
+            std::vector<int> aux;
+            OpCount comparisons;
+            OpCount swaps;
+            OpCount mispredictions;
+            OpCount scans;
+        };
+        std::vector<Snapshot> snapshots;
+        while (sorter.stepN(7919) > 0) {
+            const auto& state = sorter.getState();
+            snapshots.push_back({sorter.getPlaybackOperation(), state.array, sorter.getAuxArray(),
+                                 state.comparisons, state.swaps, state.mispredictions, state.scans});
+        }
+        ASSERT_GT(snapshots.size(), 4u);
+
+        for (size_t i = snapshots.size(); i-- > 0;) {
+            const Snapshot& snapshot = snapshots[i];
+            ASSERT_TRUE(sorter.seek(snapshot.operation));
+            EXPECT_EQ(sorter.getPlaybackOperation(), snapshot.operation);
+            EXPECT_EQ(sorter.getState().array, snapshot.array);
+            EXPECT_EQ(sorter.getAuxArray(), snapshot.aux);
+            EXPECT_EQ(sorter.getState().comparisons, snapshot.comparisons);
+            EXPECT_EQ(sorter.getState().swaps, snapshot.swaps);
+            EXPECT_EQ(sorter.getState().mispredictions, snapshot.mispredictions);
+            EXPECT_EQ(sorter.getState().scans, snapshot.scans);
+        }
+
+        ASSERT_TRUE(sorter.seek(sorter.getPlaybackLength()));
+        EXPECT_TRUE(sorter.isFinished());
+        EXPECT_TRUE(isSorted(sorter.getState().array));
+    }
+    std::remove(path.c_str());
+}
+
+TEST_F(SortingAlgorithmTest, StepBackRetracesSteps) {
+    const SortingAlgorithm::AlgorithmType types[] = {
+        SortingAlgorithm::AlgorithmType::BUBBLE_SORT,
+        SortingAlgorithm::AlgorithmType::QUICK_SORT,
+        SortingAlgorithm::AlgorithmType::DUAL_PIVOT_QUICK_SORT,
+        SortingAlgorithm::AlgorithmType::PDQ_SORT,
+        SortingAlgorithm::AlgorithmType::BLOCK_QUICK_SORT,
+        SortingAlgorithm::AlgorithmType::VECTOR_QUICK_SORT,
+        SortingAlgorithm::AlgorithmType::MERGE_SORT,
+        SortingAlgorithm::AlgorithmType::NETWORK_SORT,
+        SortingAlgorithm::AlgorithmType::POWER_SORT,
+        SortingAlgorithm::AlgorithmType::BOTTOM_UP_HEAP_SORT,
+        SortingAlgorithm::AlgorithmType::COUNTING_SORT,
+        SortingAlgorithm::AlgorithmType::RADIX_SORT,
+        SortingAlgorithm::AlgorithmType::AMERICAN_FLAG_SORT,
+        SortingAlgorithm::AlgorithmType::STD_SORT
+    };
+    for (auto type : types) {
+        SortingAlgorithm sorter(200);
+        sorter.setAlgorithm(type);
+        SortingAlgorithm straight = sorter;
+
+        // Besides the array, the progress each algorithm displays rewinds
+        struct Progress {
+            uint64_t playbackOperation;
+            SortIndex networkBegin;
+            int networkLayer;
+            SortIndex runsFound;
+            size_t runCount;
+            std::vector<uint64_t> passBytes;
+
+            bool operator==(const Progress& other) const {
+                return playbackOperation == other.playbackOperation && networkBegin == other.networkBegin &&
+                       networkLayer == other.networkLayer && runsFound == other.runsFound &&
+                       runCount == other.runCount && passBytes == other.passBytes;
+            }
+        };
+        auto progress = [&sorter]() {
+            return Progress{sorter.getPlaybackOperation(), sorter.getNetworkProgress().begin,
+                            sorter.getNetworkProgress().layer, sorter.getPowerSort().runsFound,
+                            sorter.getPowerSort().runCount, sorter.getPassBytes()};
+        };
+
+        std::vector<std::vector<int>> arrays = {sorter.getState().array};
+        std::vector<OpCount> comparisons = {sorter.getState().comparisons};
+        std::vector<Progress> progresses = {progress()};
+        for (int i = 0; i < 300 && sorter.step(); ++i) {
+            arrays.push_back(sorter.getState().array);
+            comparisons.push_back(sorter.getState().comparisons);
+            progresses.push_back(progress());
+        }
+        // The call that finds a run finished can still move its progress on,
+        // such as a network to its layer count
+        const Progress frontier = progress();
+
+        SCOPED_TRACE(SortingAlgorithm::getAlgorithmName(type));
+        for (size_t i = arrays.size() - 1; i-- > 0;) {
+            ASSERT_EQ(sorter.stepBack(), 1u);
+            EXPECT_EQ(sorter.getState().array, arrays[i]);
+            EXPECT_EQ(sorter.getState().comparisons, comparisons[i]);
+            EXPECT_TRUE(progress() == progresses[i]);
+        }
+        EXPECT_FALSE(sorter.canStepBack());
+
+        // Forward again redoes the undone steps, then the algorithm carries on
+        EXPECT_EQ(sorter.stepN(arrays.size() - 1), arrays.size() - 1);
+        EXPECT_EQ(sorter.getState().array, arrays.back());
+        EXPECT_TRUE(progress() == frontier);
+        while (sorter.stepN(1000) > 0) {}
+        straight.stepN(SIZE_MAX);
+        EXPECT_TRUE(isSorted(sorter.getState().array));
+        EXPECT_EQ(sorter.getState().comparisons, straight.getState().comparisons);
+        EXPECT_EQ(sorter.getState().swaps, straight.getState().swaps);
+
+        // Stepping back out of a finished run resumes it
+        EXPECT_EQ(sorter.stepBack(5), 5u);
+        EXPECT_FALSE(sorter.isFinished());
+        sorter.stepN(SIZE_MAX);
+        EXPECT_TRUE(sorter.isFinished());
+        EXPECT_EQ(sorter.getState().array, straight.getState().array);
+    }
+}
+
+TEST_F(SortingAlgorithmTest, StepBackFromTheEndOfAPlayback) {
+    // A merge sort trace that ends in aux writes after its last visible
+    // operation, which the call that finds the trace exhausted still applies
+    const std::string path = ::testing::TempDir() + "step_back_end_test.avtrace";
+    trace::TraceFileWriter writer;
+    ASSERT_TRUE(writer.open(path, {3, 1, 2, 0}, static_cast<uint32_t>(SortingAlgorithm::AlgorithmType::MERGE_SORT)));
+    writer.append(trace::Operation{trace::OpCode::AUX_WRITE, false, 0, 3});
+    writer.append(trace::Operation{trace::OpCode::SWAP, false, 0, 3});
+    writer.append(trace::Operation{trace::OpCode::AUX_WRITE, false, 1, 1});
+    writer.append(trace::Operation{trace::OpCode::AUX_WRITE, false, 2, 9});
+    ASSERT_TRUE(writer.finish());
+
+    SortingAlgorithm sorter(10);
+    ASSERT_TRUE(sorter.openTrace(path));
+    const std::vector<int> initialAux = sorter.getAuxArray();
+    while (sorter.step()) {}
+    ASSERT_TRUE(sorter.isFinished());
+    EXPECT_EQ(sorter.getAuxArray(), std::vector<int>({3, 1, 9, 0}));
+
+    // Undoing the one step takes back the trailing writes with it
+    EXPECT_EQ(sorter.stepBack(SIZE_MAX), 1u);
+    EXPECT_EQ(sorter.getState().array, std::vector<int>({3, 1, 2, 0}));
+    EXPECT_EQ(sorter.getAuxArray(), initialAux);
+
+    while (sorter.step()) {}
+    EXPECT_TRUE(sorter.isFinished());
+    EXPECT_EQ(sorter.getState().array, std::vector<int>({0, 1, 2, 3}));
+    EXPECT_EQ(sorter.getAuxArray(), std::vector<int>({3, 1, 9, 0}));
+    std::remove(path.c_str());
+}
+
+TEST_F(SortingAlgorithmTest, StepBackKeepsABoundedHistory) {
+    SortingAlgorithm sorter(1000);
+    sorter.setAlgorithm(SortingAlgorithm::AlgorithmType::BUBBLE_SORT);
+    for (int i = 0; i < 100; ++i) {
+        sorter.stepN(1000);
+    }
+    EXPECT_EQ(sorter.stepBack(SIZE_MAX), UndoLog::kStepCapacity);
+    EXPECT_FALSE(sorter.canStepBack());
+
+    // A batch longer than the history only logs its last steps
+    sorter.stepN(UndoLog::kStepCapacity * 3);
+    EXPECT_EQ(sorter.stepBack(SIZE_MAX), UndoLog::kStepCapacity);
+}
@@ -0,0 +1,278 @@
+#include <gtest/gtest.h>
+#include "trace/Keyframes.hpp"
+#include "trace/OperationTrace.hpp"
+#include "trace/TraceFile.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST(OperationTraceTest, RoundTripsEveryOperation) {
+    const std::vector<trace::Operation> ops = {
+        {trace::OpCode::COMPARE, true, 3, 4},
+        {trace::OpCode::COMPARE, false, -1, 70000},
+        {trace::OpCode::SWAP, false, 0, 99},
+        {trace::OpCode::READ, false, 12, 0},
+        {trace::OpCode::WRITE, false, 5, -42},
+        {trace::OpCode::AUX_READ, false, 1, 0},
+        {trace::OpCode::AUX_WRITE, false, 0x7fffffffffLL, 0x100000000LL}
+    };
+
+    trace::OperationTrace recorded;
+    for (const auto& op : ops) {
+        recorded.append(op);
+    }
+    EXPECT_EQ(recorded.size(), ops.size());
+
+    recorded.flush();
+    trace::TraceReader reader(recorded);
+    trace::Operation op;
+    for (const auto& expected : ops) {
+        ASSERT_TRUE(reader.next(op));
+        EXPECT_EQ(op.code, expected.code);
+        EXPECT_EQ(op.result, expected.result);
+        EXPECT_EQ(op.a, expected.a);
+        EXPECT_EQ(op.b, expected.b);
+    }
+    EXPECT_FALSE(reader.next(op));
+    EXPECT_TRUE(reader.atEnd());
+}
+
+TEST(OperationTraceTest, SmallIndicesTakeFewBytes) {
+    trace::OperationTrace recorded;
+    recorded.compare(10, 11, true);
+    recorded.swap(10, 11);
+    recorded.read(7);
+
+    EXPECT_EQ(recorded.byteSize(), 3u + 3u + 2u);
+
+    recorded.compare(1000, 1001, false);
+    EXPECT_EQ(recorded.byteSize(), 8u + 5u);
+}
+
+TEST(OperationTraceTest, ScansCollapseIntoRuns) {
+    trace::OperationTrace recorded;
+    for (int64_t j = 0; j < 100000; ++j) {
+        recorded.compare(j, 99999, (j % 3) == 0);
+    }
+    recorded.swap(5, 99999);
+    recorded.flush();
+
+    EXPECT_EQ(recorded.size(), 100001u);
+    EXPECT_LT(recorded.byteSize(), 100000u / 8 + 200u);
+
+    trace::TraceReader reader(recorded);
+    trace::Operation op;
+    for (int64_t j = 0; j < 100000; ++j) {
+        ASSERT_TRUE(reader.next(op));
+        ASSERT_EQ(op.code, trace::OpCode::COMPARE);
+        ASSERT_EQ(op.a, j);
+        ASSERT_EQ(op.b, 99999);
+        ASSERT_EQ(op.result, (j % 3) == 0);
+    }
+    ASSERT_TRUE(reader.next(op));
+    EXPECT_EQ(op.code, trace::OpCode::SWAP);
+    EXPECT_EQ(op.a, 5);
+    EXPECT_FALSE(reader.next(op));
+}
+
+TEST(OperationTraceTest, DecodingResumesFromACopiedState) {
+    trace::OperationTrace recorded;
+    for (int64_t j = 0; j < 50; ++j) {
+        recorded.compare(j + 1, j, j % 2 == 0);
+    }
+    for (int64_t j = 0; j < 10; ++j) {
+        recorded.write(-1 - j, j * 100);
+    }
+    recorded.flush();
+
+    trace::TraceReader reader(recorded);
+    trace::Operation op;
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(reader.next(op));
+    }
+
+    // A copy taken mid-run decodes the same tail as the original
+    trace::DecoderState saved = reader.state();
+    trace::TraceReader resumed(recorded.data(), recorded.byteSize(), saved);
+    trace::Operation expected;
+    while (reader.next(expected)) {
+        ASSERT_TRUE(resumed.next(op));
+        EXPECT_EQ(op.code, expected.code);
+        EXPECT_EQ(op.result, expected.result);
+        EXPECT_EQ(op.a, expected.a);
+        EXPECT_EQ(op.b, expected.b);
+    }
+    EXPECT_EQ(expected.a, -10);
+    EXPECT_EQ(expected.b, 900);
+    EXPECT_TRUE(resumed.atEnd());
+}
+
+TEST(OperationTraceTest, RejectsDataThatDoesNotDecode) {
+    trace::OperationTrace recorded;
+    recorded.write(123456, 7);
+    for (int64_t j = 0; j < 100; ++j) {
+        recorded.compare(j + 1, j, j % 3 == 0);
+    }
+    recorded.flush();
+    std::vector<uint8_t> bytes(recorded.data(), recorded.data() + recorded.byteSize());
+
+    // Every truncation decodes a prefix, then fails rather than read past it
+    for (size_t size = 0; size < bytes.size(); ++size) {
+        std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(size));
+        trace::TraceReader reader(truncated.data(), truncated.size());
+        trace::Operation op;
+        size_t decoded = 0;
+        while (reader.next(op)) decoded++;
+        SCOPED_TRACE(size);
+        EXPECT_LT(decoded, 101u);
+    }
+    {
+        std::vector<uint8_t> truncated(bytes.begin(), bytes.begin() + 2);
+        trace::TraceReader reader(truncated.data(), truncated.size());
+        trace::Operation op;
+        EXPECT_FALSE(reader.next(op));
+        EXPECT_TRUE(reader.failed());
+    }
+
+    // Opcode 7 is neither an operation nor a run, and varints stop at ten bytes
+    const std::vector<uint8_t> badCode = {0x07, 0x00};
+    const std::vector<uint8_t> longVarint = {0x30, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+    const std::vector<uint8_t> emptyRun = {0x00, 0x06, 0x00};
+    for (const auto& chunk : {badCode, longVarint, emptyRun}) {
+        trace::TraceReader reader(chunk.data(), chunk.size());
+        trace::Operation op;
+        while (reader.next(op)) {}
+        EXPECT_TRUE(reader.failed());
+        EXPECT_FALSE(reader.next(op));
+    }
+
+    // A run of compares whose result bits are cut off
+    trace::OperationTrace run;
+    for (int64_t j = 0; j < 100; ++j) {
+        run.compare(j, 0, true);
+    }
+    run.flush();
+    trace::TraceReader reader(run.data(), run.byteSize() - 1);
+    trace::Operation op;
+    size_t decoded = 0;
+    while (reader.next(op)) decoded++;
+    EXPECT_TRUE(reader.failed());
+    EXPECT_EQ(decoded, 2u);
+}
+
+TEST(TraceFileTest, StreamsChunksThroughABoundedWindow) {
+    const std::string path = ::testing::TempDir() + "trace_file_test.avtrace";
+    const std::vector<int> initial = {3, 1, 2, 0};
+
+    trace::TraceFileWriter writer;
+    ASSERT_TRUE(writer.open(path, initial, 7, 64));
+    // Scattered operands, so runs cannot fold the compares into a few bytes
+    auto operand = [](int64_t i) { return (i * 7919) % 10007; };
+    for (int64_t i = 0; i < 10000; ++i) {
+        writer.append(trace::Operation{trace::OpCode::COMPARE, (i & 1) != 0, operand(i), i});
+    }
+    ASSERT_TRUE(writer.finish());
+
+    trace::TraceFile file;
+    ASSERT_TRUE(file.open(path, 4096));
+    EXPECT_EQ(file.header().algorithm, 7u);
+    EXPECT_EQ(file.header().operationCount, 10000u);
+    EXPECT_GT(file.chunkCount(), 100u);
+
+    std::vector<int> array;
+    ASSERT_TRUE(file.readInitialArray(array));
+    EXPECT_EQ(array, initial);
+
+    int64_t expected = 0;
+    for (size_t chunk = 0; chunk < file.chunkCount(); ++chunk) {
+        EXPECT_EQ(file.chunkInfo(chunk).firstOperation, static_cast<uint64_t>(expected));
+        const uint8_t* data = file.mapChunk(chunk);
+        ASSERT_NE(data, nullptr);
+        EXPECT_LE(file.residentBytes(), 2 * 4096u + 64u);
+
+        trace::TraceReader reader(data, file.chunkInfo(chunk).byteSize);
+        trace::Operation op;
+        while (reader.next(op)) {
+            ASSERT_EQ(op.a, operand(expected));
+            ASSERT_EQ(op.b, expected);
+            ASSERT_EQ(op.result, (expected & 1) != 0);
+            expected++;
+        }
+    }
+    EXPECT_EQ(expected, 10000);
+
+    file.close();
+    std::remove(path.c_str());
+}
+
+TEST(TraceFileTest, RejectsUnfinishedRecordings) {
+    const std::string path = ::testing::TempDir() + "trace_file_unfinished.avtrace";
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(out, nullptr);
+    trace::TraceFileHeader header{};
+    std::fwrite(&header, sizeof(header), 1, out);
+    std::fclose(out);
+
+    trace::TraceFile file;
+    EXPECT_FALSE(file.open(path));
+    EXPECT_FALSE(file.isOpen());
+    std::remove(path.c_str());
+}
+
+TEST(TraceFileTest, RejectsBoundsThatWrapAround) {
+    const std::string path = ::testing::TempDir() + "trace_file_wrapping.avtrace";
+    trace::TraceFileWriter writer;
+    ASSERT_TRUE(writer.open(path, {3, 1, 2, 0}, 0, 64));
+    writer.append(trace::Operation{trace::OpCode::SWAP, false, 0, 3});
+    ASSERT_TRUE(writer.finish());
+
+    trace::TraceFile file;
+    ASSERT_TRUE(file.open(path));
+    const trace::TraceFileHeader header = file.header();
+    file.close();
+
+    // An array so long that its end wraps to where it starts
+    trace::TraceFileHeader wrapping = header;
+    wrapping.elementCount = uint64_t(1) << 62;
+    std::FILE* out = std::fopen(path.c_str(), "r+b");
+    ASSERT_NE(out, nullptr);
+    std::fwrite(&wrapping, sizeof(wrapping), 1, out);
+    std::fclose(out);
+    EXPECT_FALSE(file.open(path));
+
+    // A chunk that ends past the top of the address space
+    trace::TraceChunkInfo chunk{UINT64_MAX - 7, 16, 0, 1};
+    out = std::fopen(path.c_str(), "r+b");
+    ASSERT_NE(out, nullptr);
+    std::fwrite(&header, sizeof(header), 1, out);
+    std::fseek(out, static_cast<long>(header.indexOffset), SEEK_SET);
+    std::fwrite(&chunk, sizeof(chunk), 1, out);
+    std::fclose(out);
+    EXPECT_FALSE(file.open(path));
+    EXPECT_FALSE(file.isOpen());
+    std::remove(path.c_str());
+}
+
+TEST(KeyframeIndexTest, ThinsToStayWithinBudget) {
+    trace::KeyframeIndex keyframes;
+    keyframes.reset(1000);
+    const size_t keyframeBytes = sizeof(trace::Keyframe) + 1000 * sizeof(int);
+    keyframes.setBudget(10 * keyframeBytes);
+
+    for (uint64_t op = 0; op < 1000000; ++op) {
+        if (keyframes.due(op)) {
+            keyframes.add(trace::Keyframe{op, {0, op}, 0, 0, 0, {}, std::vector<int>(1000, 0)});
+        }
+    }
+
+    EXPECT_LE(keyframes.memoryBytes(), 10 * keyframeBytes);
+    EXPECT_GE(keyframes.size(), 5u);
+    EXPECT_GT(keyframes.spacing(), trace::KeyframeIndex::kMinSpacing);
+
+    ASSERT_NE(keyframes.find(0), nullptr);
+    EXPECT_EQ(keyframes.find(0)->operation, 0u);
+    const trace::Keyframe* nearest = keyframes.find(999999);
+    ASSERT_NE(nearest, nullptr);
+    EXPECT_LE(nearest->operation, 999999u);
+    EXPECT_GT(nearest->operation + 2 * keyframes.spacing(), 999999u);
+}